@@ -0,0 +1,1263 @@
+#define _GNU_SOURCE // for memfd_create
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <json.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "constants.h"
+#include "xdg-shell-client-protocol.h"
+
+#define NSEC_PER_MSEC 1000000
+
+struct bench;
+
+struct bench_window {
+	struct bench *bench;
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+
+	// From the last toplevel configure, 0 lets the client decide
+	int32_t width;
+	int32_t height;
+
+	struct wl_callback *frame;
+	uint64_t frame_done_ns;
+};
+
+struct bench {
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+	struct wl_seat *seat;
+	struct wl_pointer *pointer;
+	struct wl_surface *pointer_surface;
+	// Set once a window has asked for an interactive resize
+	bool resize_requested;
+
+	// Requests, answered in order
+	int ipc_fd;
+	FILE *ipc_replies;
+	int next_id;
+
+	// Subscribed to the toplevel events, read without blocking
+	int events_fd;
+	char *events_buffer;
+	size_t events_len;
+	size_t events_size;
+
+	struct bench_window *windows;
+	int num_windows;
+	int num_rounds;
+
+	// Toplevels of this process mapped by the compositor
+	int num_mapped;
+	// The output of the first mapped window, used for the frame counters
+	char *output_name;
+
+	int num_configures;
+	uint64_t last_configure_ns;
+};
+
+static uint64_t now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * NSEC_IN_SECONDS + now.tv_nsec;
+}
+
+static double ns_to_ms(uint64_t ns) {
+	return ns / (double)NSEC_PER_MSEC;
+}
+
+static void print_help(void) {
+	printf("Usage: fx-comp-bench [options]\n");
+	printf("\t-n <count>\tNumber of windows, defaults to %d\n",
+		   BENCH_DEFAULT_WINDOWS);
+	printf("\t-r <count>\tRounds per step, defaults to %d\n",
+		   BENCH_DEFAULT_ROUNDS);
+	printf("\t-o <path>\tWrite the JSON results to <path> instead of "
+		   "stdout\n");
+	printf("\t-x\tExit the compositor when done\n");
+	printf("\t-c <path>\tStart a headless fx-comp from <path> and run inside "
+		   "it. Needs -o, exits with 1 if no results were written.\n");
+	printf("\t-h\tDisplay this help message\n");
+	printf("Runs inside fx-comp, e.g. "
+		   "WLR_BACKENDS=headless fx-comp -s 'fx-comp-bench -x'\n");
+}
+
+/*
+ * IPC
+ */
+
+static int ipc_connect(void) {
+	const char *path = getenv(IPC_SOCKET_ENV);
+	if (!path) {
+		fprintf(stderr, "$%s is not set, is fx-comp running?\n",
+				IPC_SOCKET_ENV);
+		return -1;
+	}
+
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		fprintf(stderr, "Could not connect to %s: %s\n", path,
+				strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool ipc_send(int fd, json_object *request) {
+	const char *message =
+		json_object_to_json_string_ext(request, JSON_C_TO_STRING_PLAIN);
+	bool ok = dprintf(fd, "%s\n", message) > 0;
+	json_object_put(request);
+	if (!ok) {
+		fprintf(stderr, "Could not send the IPC request\n");
+	}
+	return ok;
+}
+
+/** Takes ownership of the request. The result has to be put by the caller. */
+static bool ipc_request(struct bench *bench, json_object *request,
+						json_object **result) {
+	json_object_object_add(request, "id",
+						   json_object_new_int(++bench->next_id));
+	if (!ipc_send(bench->ipc_fd, request)) {
+		return false;
+	}
+
+	char *line = NULL;
+	size_t line_size = 0;
+	if (getline(&line, &line_size, bench->ipc_replies) <= 0) {
+		fprintf(stderr, "The compositor closed the IPC connection\n");
+		free(line);
+		return false;
+	}
+	json_object *reply = json_tokener_parse(line);
+	free(line);
+
+	json_object *success, *value = NULL;
+	if (!reply || !json_object_object_get_ex(reply, "success", &success) ||
+		!json_object_get_boolean(success)) {
+		json_object *error = NULL;
+		json_object_object_get_ex(reply, "error", &error);
+		fprintf(stderr, "IPC request failed: %s\n",
+				error ? json_object_get_string(error) : "invalid reply");
+		json_object_put(reply);
+		return false;
+	}
+	json_object_object_get_ex(reply, "result", &value);
+	if (result) {
+		*result = json_object_get(value);
+	}
+	json_object_put(reply);
+	return true;
+}
+
+static bool run_action(struct bench *bench, const char *action) {
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "command", json_object_new_string("run"));
+	json_object_object_add(request, "action", json_object_new_string(action));
+	return ipc_request(bench, request, NULL);
+}
+
+/** Moves the pointer to x and y, then presses or releases the button */
+static bool pointer_warp(struct bench *bench, double x, double y,
+						 bool pressed) {
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "command",
+						   json_object_new_string("pointer"));
+	json_object_object_add(request, "x", json_object_new_double(x));
+	json_object_object_add(request, "y", json_object_new_double(y));
+	json_object_object_add(request, "pressed",
+						   json_object_new_boolean(pressed));
+	return ipc_request(bench, request, NULL);
+}
+
+static bool pointer_move(struct bench *bench, int dx, int dy) {
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "command",
+						   json_object_new_string("pointer"));
+	json_object_object_add(request, "dx", json_object_new_int(dx));
+	json_object_object_add(request, "dy", json_object_new_int(dy));
+	return ipc_request(bench, request, NULL);
+}
+
+static bool pointer_release(struct bench *bench) {
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "command",
+						   json_object_new_string("pointer"));
+	json_object_object_add(request, "pressed",
+						   json_object_new_boolean(false));
+	return ipc_request(bench, request, NULL);
+}
+
+static int json_get_int(json_object *object, const char *key) {
+	json_object *value = NULL;
+	json_object_object_get_ex(object, key, &value);
+	return json_object_get_int(value);
+}
+
+/** Finds the layout coordinates of the center of a floating window */
+static bool get_floating_center(struct bench *bench, double *x, double *y) {
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "command",
+						   json_object_new_string("get_tree"));
+	json_object *tree;
+	if (!ipc_request(bench, request, &tree)) {
+		return false;
+	}
+
+	bool found = false;
+	json_object *outputs = NULL;
+	json_object_object_get_ex(tree, "outputs", &outputs);
+	for (size_t i = 0; !found && i < json_object_array_length(outputs); i++) {
+		json_object *output = json_object_array_get_idx(outputs, i);
+		json_object *output_geometry = NULL, *workspaces = NULL;
+		json_object_object_get_ex(output, "geometry", &output_geometry);
+		json_object_object_get_ex(output, "workspaces", &workspaces);
+		for (size_t j = 0; !found && j < json_object_array_length(workspaces);
+			 j++) {
+			json_object *ws = json_object_array_get_idx(workspaces, j);
+			json_object *toplevels = NULL, *active = NULL;
+			json_object_object_get_ex(ws, "active", &active);
+			json_object_object_get_ex(ws, "toplevels", &toplevels);
+			if (!json_object_get_boolean(active)) {
+				continue;
+			}
+			for (size_t k = 0; k < json_object_array_length(toplevels); k++) {
+				json_object *toplevel = json_object_array_get_idx(toplevels, k);
+				json_object *floating = NULL, *geometry = NULL;
+				json_object_object_get_ex(toplevel, "floating", &floating);
+				json_object_object_get_ex(toplevel, "geometry", &geometry);
+				if (json_get_int(toplevel, "pid") != getpid() ||
+					!json_object_get_boolean(floating)) {
+					continue;
+				}
+				// The toplevel geometry is relative to its output
+				*x = json_get_int(output_geometry, "x") +
+					 json_get_int(geometry, "x") +
+					 json_get_int(geometry, "width") / 2.0;
+				*y = json_get_int(output_geometry, "y") +
+					 json_get_int(geometry, "y") +
+					 json_get_int(geometry, "height") / 2.0;
+				found = true;
+				break;
+			}
+		}
+	}
+	json_object_put(tree);
+	if (!found) {
+		fprintf(stderr, "No floating window found\n");
+	}
+	return found;
+}
+
+/** Reads the frame counters of the output the windows are on */
+static bool get_output_frames(struct bench *bench, int64_t *frames,
+							  int64_t *last_frame_ns) {
+	if (!bench->output_name) {
+		fprintf(stderr, "The windows haven't been mapped yet\n");
+		return false;
+	}
+
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "command",
+						   json_object_new_string("get_outputs"));
+	json_object *outputs;
+	if (!ipc_request(bench, request, &outputs)) {
+		return false;
+	}
+
+	bool found = false;
+	for (size_t i = 0; i < json_object_array_length(outputs); i++) {
+		json_object *output = json_object_array_get_idx(outputs, i);
+		json_object *name, *value;
+		if (!json_object_object_get_ex(output, "name", &name) ||
+			strcmp(json_object_get_string(name), bench->output_name) != 0) {
+			continue;
+		}
+		json_object_object_get_ex(output, "frames", &value);
+		*frames = json_object_get_int64(value);
+		json_object_object_get_ex(output, "last_frame_ns", &value);
+		*last_frame_ns = json_object_get_int64(value);
+		found = true;
+		break;
+	}
+	json_object_put(outputs);
+	if (!found) {
+		fprintf(stderr, "Output %s not found\n", bench->output_name);
+	}
+	return found;
+}
+
+static void handle_event(struct bench *bench, json_object *event) {
+	json_object *name, *toplevel, *pid, *output;
+	if (!json_object_object_get_ex(event, "event", &name) ||
+		strcmp(json_object_get_string(name), "toplevel_map") != 0 ||
+		!json_object_object_get_ex(event, "toplevel", &toplevel) ||
+		!json_object_object_get_ex(toplevel, "pid", &pid) ||
+		json_object_get_int(pid) != getpid()) {
+		return;
+	}
+
+	bench->num_mapped++;
+	if (!bench->output_name &&
+		json_object_object_get_ex(toplevel, "output", &output)) {
+		bench->output_name = strdup(json_object_get_string(output));
+	}
+}
+
+/** Returns false if the connection has been closed */
+static bool read_events(struct bench *bench) {
+	char chunk[4096];
+	ssize_t len = read(bench->events_fd, chunk, sizeof(chunk));
+	if (len < 0) {
+		return errno == EAGAIN || errno == EINTR;
+	} else if (len == 0) {
+		fprintf(stderr, "The compositor closed the IPC connection\n");
+		return false;
+	}
+
+	if (bench->events_len + len > bench->events_size) {
+		size_t size = (bench->events_len + len) * 2;
+		char *buffer = realloc(bench->events_buffer, size);
+		if (!buffer) {
+			fprintf(stderr, "Could not allocate the IPC buffer\n");
+			return false;
+		}
+		bench->events_buffer = buffer;
+		bench->events_size = size;
+	}
+	memcpy(bench->events_buffer + bench->events_len, chunk, len);
+	bench->events_len += len;
+
+	// Handle every complete line, the first one is the subscribe reply
+	char *start = bench->events_buffer;
+	char *end;
+	while ((end = memchr(start, '\n',
+						 bench->events_len - (start - bench->events_buffer)))) {
+		*end = '\0';
+		json_object *event = json_tokener_parse(start);
+		if (event) {
+			handle_event(bench, event);
+			json_object_put(event);
+		}
+		start = end + 1;
+	}
+	bench->events_len -= start - bench->events_buffer;
+	memmove(bench->events_buffer, start, bench->events_len);
+	return true;
+}
+
+static bool subscribe(struct bench *bench) {
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "command",
+						   json_object_new_string("subscribe"));
+	json_object *events = json_object_new_array();
+	json_object_array_add(events, json_object_new_string("toplevel"));
+	json_object_object_add(request, "events", events);
+	if (!ipc_send(bench->events_fd, request)) {
+		return false;
+	}
+	return fcntl(bench->events_fd, F_SETFL, O_NONBLOCK) == 0;
+}
+
+/*
+ * Wayland
+ */
+
+static void buffer_release(void *data, struct wl_buffer *buffer) {
+	wl_buffer_destroy(buffer);
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_release,
+};
+
+/** The contents don't matter, an unmapped memfd reads as black */
+static struct wl_buffer *create_buffer(struct bench *bench, int width,
+									   int height) {
+	const int stride = width * 4;
+	const int size = stride * height;
+	int fd = memfd_create("fx-comp-bench", MFD_CLOEXEC);
+	if (fd < 0) {
+		perror("memfd_create");
+		return NULL;
+	}
+	if (ftruncate(fd, size) < 0) {
+		perror("ftruncate");
+		close(fd);
+		return NULL;
+	}
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(bench->shm, fd, size);
+	struct wl_buffer *buffer = wl_shm_pool_create_buffer(
+		pool, 0, width, height, stride, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	wl_buffer_add_listener(buffer, &buffer_listener, NULL);
+	return buffer;
+}
+
+static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+								  uint32_t serial) {
+	struct bench_window *window = data;
+	struct bench *bench = window->bench;
+	xdg_surface_ack_configure(xdg_surface, serial);
+
+	int width = window->width > 0 ? window->width : BENCH_WINDOW_WIDTH;
+	int height = window->height > 0 ? window->height : BENCH_WINDOW_HEIGHT;
+	struct wl_buffer *buffer = create_buffer(bench, width, height);
+	if (buffer) {
+		wl_surface_attach(window->surface, buffer, 0, 0);
+		wl_surface_damage_buffer(window->surface, 0, 0, width, height);
+	}
+	wl_surface_commit(window->surface);
+
+	bench->num_configures++;
+	bench->last_configure_ns = now_ns();
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+static void xdg_toplevel_configure(void *data,
+								   struct xdg_toplevel *xdg_toplevel,
+								   int32_t width, int32_t height,
+								   struct wl_array *states) {
+	struct bench_window *window = data;
+	window->width = width;
+	window->height = height;
+}
+
+static void xdg_toplevel_close(void *data, struct xdg_toplevel *xdg_toplevel) {
+	// Ignored, the windows are destroyed when the benchmark is done
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	.configure = xdg_toplevel_configure,
+	.close = xdg_toplevel_close,
+};
+
+static void frame_done(void *data, struct wl_callback *callback,
+					   uint32_t time) {
+	struct bench_window *window = data;
+	wl_callback_destroy(callback);
+	window->frame = NULL;
+	window->frame_done_ns = now_ns();
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_done,
+};
+
+static void request_frame(struct bench_window *window) {
+	if (window->frame) {
+		wl_callback_destroy(window->frame);
+	}
+	window->frame_done_ns = 0;
+	window->frame = wl_surface_frame(window->surface);
+	wl_callback_add_listener(window->frame, &frame_listener, window);
+	wl_surface_commit(window->surface);
+}
+
+static void window_init(struct bench *bench, struct bench_window *window) {
+	window->bench = bench;
+	window->surface = wl_compositor_create_surface(bench->compositor);
+	window->xdg_surface =
+		xdg_wm_base_get_xdg_surface(bench->wm_base, window->surface);
+	xdg_surface_add_listener(window->xdg_surface, &xdg_surface_listener,
+							 window);
+	window->xdg_toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+	xdg_toplevel_add_listener(window->xdg_toplevel, &xdg_toplevel_listener,
+							  window);
+	xdg_toplevel_set_title(window->xdg_toplevel, "fx-comp-bench");
+	xdg_toplevel_set_app_id(window->xdg_toplevel, "fx-comp-bench");
+	// The initial commit without a buffer asks for the first configure
+	wl_surface_commit(window->surface);
+}
+
+static void window_finish(struct bench_window *window) {
+	if (!window->surface) {
+		return;
+	}
+	if (window->frame) {
+		wl_callback_destroy(window->frame);
+	}
+	xdg_toplevel_destroy(window->xdg_toplevel);
+	xdg_surface_destroy(window->xdg_surface);
+	wl_surface_destroy(window->surface);
+}
+
+static void pointer_enter(void *data, struct wl_pointer *pointer,
+						  uint32_t serial, struct wl_surface *surface,
+						  wl_fixed_t sx, wl_fixed_t sy) {
+	// The pointer image doesn't matter
+	struct bench *bench = data;
+	bench->pointer_surface = surface;
+}
+
+static void pointer_leave(void *data, struct wl_pointer *pointer,
+						  uint32_t serial, struct wl_surface *surface) {
+	struct bench *bench = data;
+	if (bench->pointer_surface == surface) {
+		bench->pointer_surface = NULL;
+	}
+}
+
+static void pointer_motion(void *data, struct wl_pointer *pointer,
+						   uint32_t time, wl_fixed_t sx, wl_fixed_t sy) {}
+
+/** Starts an interactive resize, like a client side decoration would */
+static void pointer_button(void *data, struct wl_pointer *pointer,
+						   uint32_t serial, uint32_t time, uint32_t button,
+						   uint32_t state) {
+	struct bench *bench = data;
+	if (state != WL_POINTER_BUTTON_STATE_PRESSED) {
+		return;
+	}
+	for (int i = 0; i < bench->num_windows; i++) {
+		struct bench_window *window = &bench->windows[i];
+		if (window->surface && window->surface == bench->pointer_surface) {
+			xdg_toplevel_resize(window->xdg_toplevel, bench->seat, serial,
+								XDG_TOPLEVEL_RESIZE_EDGE_BOTTOM_RIGHT);
+			bench->resize_requested = true;
+			break;
+		}
+	}
+}
+
+static void pointer_axis(void *data, struct wl_pointer *pointer,
+						 uint32_t time, uint32_t axis, wl_fixed_t value) {}
+
+static const struct wl_pointer_listener pointer_listener = {
+	.enter = pointer_enter,
+	.leave = pointer_leave,
+	.motion = pointer_motion,
+	.button = pointer_button,
+	.axis = pointer_axis,
+};
+
+static void seat_capabilities(void *data, struct wl_seat *seat,
+							  uint32_t capabilities) {
+	struct bench *bench = data;
+	if (!bench->pointer && (capabilities & WL_SEAT_CAPABILITY_POINTER)) {
+		bench->pointer = wl_seat_get_pointer(seat);
+		wl_pointer_add_listener(bench->pointer, &pointer_listener, bench);
+	}
+}
+
+static void seat_name(void *data, struct wl_seat *seat, const char *name) {}
+
+static const struct wl_seat_listener seat_listener = {
+	.capabilities = seat_capabilities,
+	.name = seat_name,
+};
+
+static void wm_base_ping(void *data, struct xdg_wm_base *wm_base,
+						 uint32_t serial) {
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void registry_global(void *data, struct wl_registry *registry,
+							uint32_t name, const char *interface,
+							uint32_t version) {
+	struct bench *bench = data;
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		bench->compositor = wl_registry_bind(registry, name,
+											 &wl_compositor_interface,
+											 version < 4 ? version : 4);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		bench->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		bench->wm_base =
+			wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(bench->wm_base, &wm_base_listener, bench);
+	} else if (strcmp(interface, wl_seat_interface.name) == 0 &&
+			   !bench->seat) {
+		// Version 1 only sends the pointer events handled here
+		bench->seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+		wl_seat_add_listener(bench->seat, &seat_listener, bench);
+	}
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry,
+								   uint32_t name) {
+	// The globals used here are never removed
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+/**
+ * Dispatches the Wayland and IPC events, waiting at most timeout_ms for new
+ * ones. Returns false if either connection has failed.
+ */
+static bool dispatch(struct bench *bench, int timeout_ms) {
+	while (wl_display_prepare_read(bench->display) != 0) {
+		if (wl_display_dispatch_pending(bench->display) < 0) {
+			return false;
+		}
+	}
+	if (wl_display_flush(bench->display) < 0 && errno != EAGAIN) {
+		wl_display_cancel_read(bench->display);
+		return false;
+	}
+
+	struct pollfd fds[] = {
+		{.fd = wl_display_get_fd(bench->display), .events = POLLIN},
+		{.fd = bench->events_fd, .events = POLLIN},
+	};
+	if (poll(fds, 2, timeout_ms) < 0) {
+		wl_display_cancel_read(bench->display);
+		return errno == EINTR;
+	}
+
+	if (fds[0].revents & POLLIN) {
+		if (wl_display_read_events(bench->display) < 0) {
+			return false;
+		}
+	} else {
+		wl_display_cancel_read(bench->display);
+		if (fds[0].revents & (POLLERR | POLLHUP)) {
+			fprintf(stderr, "The Wayland connection has been closed\n");
+			return false;
+		}
+	}
+	if (wl_display_dispatch_pending(bench->display) < 0) {
+		return false;
+	}
+
+	if (fds[1].revents & (POLLIN | POLLHUP)) {
+		return read_events(bench);
+	}
+	return true;
+}
+
+/**
+ * Dispatches until no configure has been received for BENCH_SETTLE_MS.
+ * Returns the time of the last configure after start_ns, or start_ns itself.
+ */
+static bool wait_configures_settled(struct bench *bench, uint64_t start_ns,
+									uint64_t *last_ns) {
+	for (;;) {
+		const uint64_t last = bench->last_configure_ns > start_ns
+								  ? bench->last_configure_ns
+								  : start_ns;
+		const uint64_t now = now_ns();
+		if (now - last >= (uint64_t)BENCH_SETTLE_MS * NSEC_PER_MSEC) {
+			*last_ns = last;
+			return true;
+		}
+		if (now - start_ns >= (uint64_t)BENCH_TIMEOUT_MS * NSEC_PER_MSEC) {
+			fprintf(stderr, "The windows are still being configured\n");
+			return false;
+		}
+
+		int timeout_ms =
+			BENCH_SETTLE_MS - (int)((now - last) / NSEC_PER_MSEC) + 1;
+		if (!dispatch(bench, timeout_ms)) {
+			return false;
+		}
+	}
+}
+
+/**
+ * Polls the frame counters of the output until no frame has been rendered for
+ * BENCH_SETTLE_MS, which means that the animations are done.
+ */
+static bool wait_frames_settled(struct bench *bench, int64_t *frames,
+								int64_t *last_frame_ns) {
+	const uint64_t start_ns = now_ns();
+	uint64_t last_change_ns = start_ns;
+	if (!get_output_frames(bench, frames, last_frame_ns)) {
+		return false;
+	}
+
+	for (;;) {
+		const uint64_t now = now_ns();
+		if (now - last_change_ns >= (uint64_t)BENCH_SETTLE_MS * NSEC_PER_MSEC) {
+			return true;
+		}
+		if (now - start_ns >= (uint64_t)BENCH_TIMEOUT_MS * NSEC_PER_MSEC) {
+			fprintf(stderr, "The output never stopped rendering\n");
+			return false;
+		}
+
+		if (!dispatch(bench, BENCH_POLL_MS)) {
+			return false;
+		}
+		int64_t new_frames;
+		if (!get_output_frames(bench, &new_frames, last_frame_ns)) {
+			return false;
+		}
+		if (new_frames != *frames) {
+			*frames = new_frames;
+			last_change_ns = now_ns();
+		}
+	}
+}
+
+/*
+ * Steps
+ */
+
+static json_object *configure_stats_to_json(int rounds, int configures,
+											uint64_t total_ns) {
+	json_object *object = json_object_new_object();
+	const double total_s = total_ns / (double)NSEC_IN_SECONDS;
+	json_object_object_add(object, "rounds", json_object_new_int(rounds));
+	json_object_object_add(object, "configures",
+						   json_object_new_int(configures));
+	json_object_object_add(object, "total_ms",
+						   json_object_new_double(ns_to_ms(total_ns)));
+	json_object_object_add(
+		object, "rounds_per_s",
+		json_object_new_double(total_s > 0 ? rounds / total_s : 0));
+	json_object_object_add(
+		object, "configures_per_s",
+		json_object_new_double(total_s > 0 ? configures / total_s : 0));
+	return object;
+}
+
+/** Time until the compositor has mapped every window */
+static bool bench_map(struct bench *bench, json_object *results) {
+	const uint64_t start_ns = now_ns();
+	for (int i = 0; i < bench->num_windows; i++) {
+		window_init(bench, &bench->windows[i]);
+	}
+
+	while (bench->num_mapped < bench->num_windows) {
+		if (now_ns() - start_ns >= (uint64_t)BENCH_TIMEOUT_MS * NSEC_PER_MSEC) {
+			fprintf(stderr, "Only %d of %d windows have been mapped\n",
+					bench->num_mapped, bench->num_windows);
+			return false;
+		}
+		if (!dispatch(bench, BENCH_POLL_MS)) {
+			return false;
+		}
+	}
+	const uint64_t total_ns = now_ns() - start_ns;
+
+	// Let the map animations and the initial tiling finish
+	uint64_t last_ns;
+	if (!wait_configures_settled(bench, now_ns(), &last_ns)) {
+		return false;
+	}
+
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "windows",
+						   json_object_new_int(bench->num_windows));
+	json_object_object_add(object, "total_ms",
+						   json_object_new_double(ns_to_ms(total_ns)));
+	json_object_object_add(
+		object, "per_window_ms",
+		json_object_new_double(ns_to_ms(total_ns) / bench->num_windows));
+	json_object_object_add(results, "map", object);
+	return true;
+}
+
+/**
+ * Runs the action for every round and measures until the last configure of
+ * the windows.
+ */
+static bool bench_configure_rounds(struct bench *bench, json_object *results,
+								   const char *key, const char *action,
+								   int actions_per_round) {
+	const int configures = bench->num_configures;
+	uint64_t total_ns = 0;
+	for (int i = 0; i < bench->num_rounds; i++) {
+		for (int j = 0; j < actions_per_round; j++) {
+			const uint64_t start_ns = now_ns();
+			uint64_t last_ns;
+			if (!run_action(bench, action) ||
+				!wait_configures_settled(bench, start_ns, &last_ns)) {
+				return false;
+			}
+			total_ns += last_ns - start_ns;
+		}
+	}
+
+	json_object_object_add(
+		results, key,
+		configure_stats_to_json(bench->num_rounds,
+								bench->num_configures - configures, total_ns));
+	return true;
+}
+
+/**
+ * Switches to an empty workspace and back. Measures the time until a window
+ * on the workspace that is switched to renders, and the frame rate of the
+ * switch animation.
+ */
+static bool bench_workspace_switch(struct bench *bench, json_object *results) {
+	int64_t frames, last_frame_ns;
+	if (!run_action(bench, "workspace-new") ||
+		!wait_frames_settled(bench, &frames, &last_frame_ns)) {
+		return false;
+	}
+
+	uint64_t total_ns = 0, max_ns = 0;
+	int64_t animation_frames = 0;
+	uint64_t animation_ns = 0;
+	for (int i = 0; i < bench->num_rounds; i++) {
+		// Away from the windows
+		if (!run_action(bench, "workspace-next") ||
+			!wait_frames_settled(bench, &frames, &last_frame_ns)) {
+			return false;
+		}
+
+		// Only sent once the hidden windows are shown again
+		for (int j = 0; j < bench->num_windows; j++) {
+			request_frame(&bench->windows[j]);
+		}
+		wl_display_flush(bench->display);
+		const int64_t start_frames = frames;
+		const uint64_t start_ns = now_ns();
+		if (!run_action(bench, "workspace-next")) {
+			return false;
+		}
+
+		uint64_t shown_ns = 0;
+		while (!shown_ns) {
+			if (now_ns() - start_ns >=
+				(uint64_t)BENCH_TIMEOUT_MS * NSEC_PER_MSEC) {
+				fprintf(stderr, "The windows never rendered after switching "
+								"back to their workspace\n");
+				return false;
+			}
+			if (!dispatch(bench, BENCH_POLL_MS)) {
+				return false;
+			}
+			for (int j = 0; j < bench->num_windows; j++) {
+				uint64_t done_ns = bench->windows[j].frame_done_ns;
+				if (done_ns && (!shown_ns || done_ns < shown_ns)) {
+					shown_ns = done_ns;
+				}
+			}
+		}
+		total_ns += shown_ns - start_ns;
+		if (shown_ns - start_ns > max_ns) {
+			max_ns = shown_ns - start_ns;
+		}
+
+		if (!wait_frames_settled(bench, &frames, &last_frame_ns)) {
+			return false;
+		}
+		if (last_frame_ns > (int64_t)start_ns) {
+			animation_frames += frames - start_frames;
+			animation_ns += last_frame_ns - start_ns;
+		}
+	}
+
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "switches",
+						   json_object_new_int(bench->num_rounds));
+	json_object_object_add(
+		object, "mean_ms",
+		json_object_new_double(ns_to_ms(total_ns) / bench->num_rounds));
+	json_object_object_add(object, "max_ms",
+						   json_object_new_double(ns_to_ms(max_ns)));
+	json_object_object_add(results, "workspace_switch", object);
+
+	object = json_object_new_object();
+	const double animation_s = animation_ns / (double)NSEC_IN_SECONDS;
+	json_object_object_add(object, "frames",
+						   json_object_new_int64(animation_frames));
+	json_object_object_add(object, "duration_ms",
+						   json_object_new_double(ns_to_ms(animation_ns)));
+	json_object_object_add(
+		object, "fps",
+		json_object_new_double(animation_s > 0 ? animation_frames / animation_s
+											   : 0));
+	json_object_object_add(results, "animation", object);
+	return true;
+}
+
+/** Dispatches until the requests sent so far have been handled */
+static bool roundtrip(struct bench *bench) {
+	return wl_display_roundtrip(bench->display) >= 0;
+}
+
+/**
+ * Drags the bottom right corner of a floating window with the IPC pointer,
+ * which goes through the same grab and configure pacing as a real pointer.
+ * Measures the configures the window gets until the drag has settled.
+ */
+static bool bench_interactive_resize(struct bench *bench,
+									 json_object *results) {
+	if (!bench->pointer) {
+		fprintf(stderr, "The compositor has no pointer\n");
+		return false;
+	}
+	// Tiled windows can't be resized by the client. The focused window
+	// floats until the end of the step.
+	uint64_t last_ns;
+	if (!run_action(bench, "toggle-tiling") ||
+		!wait_configures_settled(bench, now_ns(), &last_ns)) {
+		return false;
+	}
+
+	const int configures = bench->num_configures;
+	uint64_t total_ns = 0;
+	for (int i = 0; i < bench->num_rounds; i++) {
+		// The press makes the window ask for the resize
+		double x, y;
+		bench->resize_requested = false;
+		if (!get_floating_center(bench, &x, &y) ||
+			!pointer_warp(bench, x, y, true) || !roundtrip(bench) ||
+			!roundtrip(bench)) {
+			return false;
+		}
+		if (!bench->resize_requested) {
+			fprintf(stderr, "The window never got the button press\n");
+			return false;
+		}
+
+		const uint64_t start_ns = now_ns();
+		for (int j = 0; j < BENCH_RESIZE_MOTIONS; j++) {
+			const int delta = j < BENCH_RESIZE_MOTIONS / 2
+								  ? BENCH_RESIZE_MOTION_PX
+								  : -BENCH_RESIZE_MOTION_PX;
+			if (!pointer_move(bench, delta, delta)) {
+				return false;
+			}
+
+			// Keep acking the configures in the meantime
+			const uint64_t next_ns =
+				start_ns +
+				(uint64_t)(j + 1) * BENCH_RESIZE_INTERVAL_MS * NSEC_PER_MSEC;
+			uint64_t now;
+			while ((now = now_ns()) < next_ns) {
+				const int timeout_ms = (next_ns - now) / NSEC_PER_MSEC + 1;
+				if (!dispatch(bench, timeout_ms)) {
+					return false;
+				}
+			}
+		}
+		if (!pointer_release(bench) ||
+			!wait_configures_settled(bench, start_ns, &last_ns)) {
+			return false;
+		}
+		total_ns += last_ns - start_ns;
+	}
+
+	json_object *object = configure_stats_to_json(
+		bench->num_rounds, bench->num_configures - configures, total_ns);
+	json_object_object_add(
+		object, "motions",
+		json_object_new_int(bench->num_rounds * BENCH_RESIZE_MOTIONS));
+	json_object_object_add(results, "interactive_resize", object);
+
+	return run_action(bench, "toggle-tiling") &&
+		   wait_configures_settled(bench, now_ns(), &last_ns);
+}
+
+static bool bench_run(struct bench *bench, json_object *results) {
+	// Tiled by default, every layout change retiles all windows
+	if (!bench_map(bench, results) ||
+		!bench_configure_rounds(bench, results, "retile", "layout-next", 1) ||
+		!bench_interactive_resize(bench, results)) {
+		return false;
+	}
+	return bench_workspace_switch(bench, results);
+}
+
+/*
+ * Main
+ */
+
+static bool bench_connect(struct bench *bench) {
+	bench->display = wl_display_connect(NULL);
+	if (!bench->display) {
+		fprintf(stderr, "Could not connect to the Wayland display\n");
+		return false;
+	}
+	bench->registry = wl_display_get_registry(bench->display);
+	wl_registry_add_listener(bench->registry, &registry_listener, bench);
+	wl_display_roundtrip(bench->display);
+	if (!bench->compositor || !bench->shm || !bench->wm_base) {
+		fprintf(stderr, "The compositor is missing a required global\n");
+		return false;
+	}
+
+	bench->ipc_fd = ipc_connect();
+	if (bench->ipc_fd < 0) {
+		return false;
+	}
+	bench->ipc_replies = fdopen(bench->ipc_fd, "r");
+	if (!bench->ipc_replies) {
+		perror("fdopen");
+		return false;
+	}
+	bench->events_fd = ipc_connect();
+	return bench->events_fd >= 0 && subscribe(bench);
+}
+
+static void bench_finish(struct bench *bench) {
+	for (int i = 0; i < bench->num_windows; i++) {
+		window_finish(&bench->windows[i]);
+	}
+	free(bench->windows);
+	free(bench->events_buffer);
+	free(bench->output_name);
+
+	if (bench->ipc_replies) {
+		// Also closes ipc_fd
+		fclose(bench->ipc_replies);
+	} else if (bench->ipc_fd >= 0) {
+		close(bench->ipc_fd);
+	}
+	if (bench->events_fd >= 0) {
+		close(bench->events_fd);
+	}
+
+	if (bench->pointer) {
+		wl_pointer_destroy(bench->pointer);
+	}
+	if (bench->seat) {
+		wl_seat_destroy(bench->seat);
+	}
+	if (bench->wm_base) {
+		xdg_wm_base_destroy(bench->wm_base);
+	}
+	if (bench->shm) {
+		wl_shm_destroy(bench->shm);
+	}
+	if (bench->compositor) {
+		wl_compositor_destroy(bench->compositor);
+	}
+	if (bench->registry) {
+		wl_registry_destroy(bench->registry);
+	}
+	if (bench->display) {
+		wl_display_disconnect(bench->display);
+	}
+}
+
+/** Single quotes the string for sh -c */
+static char *shell_quote(const char *str) {
+	// Every ' becomes '\'', plus the enclosing quotes
+	size_t len = 3;
+	for (const char *c = str; *c; c++) {
+		len += *c == '\'' ? 4 : 1;
+	}
+	char *quoted = malloc(len);
+	if (!quoted) {
+		return NULL;
+	}
+	char *dest = quoted;
+	*dest++ = '\'';
+	for (const char *c = str; *c; c++) {
+		if (*c == '\'') {
+			memcpy(dest, "'\\''", 4);
+			dest += 4;
+		} else {
+			*dest++ = *c;
+		}
+	}
+	*dest++ = '\'';
+	*dest = '\0';
+	return quoted;
+}
+
+/**
+ * Runs the benchmark inside a new headless fx-comp. fx-comp exits with 0 even
+ * if its startup command failed, so only a freshly written results file
+ * counts as success.
+ */
+static int bench_spawn(const char *compositor, const char *self,
+					   const char *output_path, int num_windows,
+					   int num_rounds) {
+	if (unlink(output_path) != 0 && errno != ENOENT) {
+		fprintf(stderr, "Could not remove the old %s: %s\n", output_path,
+				strerror(errno));
+		return 1;
+	}
+
+	char *quoted_self = shell_quote(self);
+	char *quoted_output = shell_quote(output_path);
+	char *cmd = NULL;
+	if (!quoted_self || !quoted_output ||
+		asprintf(&cmd, "%s -x -n %d -r %d -o %s", quoted_self, num_windows,
+				 num_rounds, quoted_output) < 0) {
+		cmd = NULL;
+	}
+	free(quoted_self);
+	free(quoted_output);
+	if (!cmd) {
+		fprintf(stderr, "Could not allocate the startup command\n");
+		return 1;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		free(cmd);
+		return 1;
+	} else if (pid == 0) {
+		// Don't leave the compositor behind if the benchmark gets killed
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		setenv("WLR_BACKENDS", "headless", true);
+		execlp(compositor, compositor, "-s", cmd, (char *)NULL);
+		fprintf(stderr, "Could not run %s: %s\n", compositor,
+				strerror(errno));
+		_exit(127);
+	}
+	free(cmd);
+
+	int status;
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			perror("waitpid");
+			return 1;
+		}
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "%s did not exit cleanly\n", compositor);
+		return 1;
+	}
+	if (access(output_path, F_OK) != 0) {
+		fprintf(stderr, "No results have been written, the benchmark "
+						"failed\n");
+		return 1;
+	}
+	return 0;
+}
+
+/** Writes to a temporary file first, so that a failed write leaves nothing */
+static bool write_results(const char *output_path, const char *json) {
+	char *tmp_path = NULL;
+	if (asprintf(&tmp_path, "%s.tmp", output_path) < 0) {
+		return false;
+	}
+	bool ok = false;
+	FILE *file = fopen(tmp_path, "w");
+	if (file) {
+		bool written = fprintf(file, "%s\n", json) > 0;
+		ok = fclose(file) == 0 && written &&
+			 rename(tmp_path, output_path) == 0;
+		if (!ok) {
+			unlink(tmp_path);
+		}
+	}
+	free(tmp_path);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	struct bench bench = {
+		.ipc_fd = -1,
+		.events_fd = -1,
+		.num_windows = BENCH_DEFAULT_WINDOWS,
+		.num_rounds = BENCH_DEFAULT_ROUNDS,
+	};
+	const char *output_path = NULL;
+	const char *compositor = NULL;
+	bool exit_compositor = false;
+
+	int c;
+	while ((c = getopt(argc, argv, "n:r:o:xc:h")) != -1) {
+		switch (c) {
+		case 'n':
+			bench.num_windows = strtol(optarg, NULL, 10);
+			break;
+		case 'r':
+			bench.num_rounds = strtol(optarg, NULL, 10);
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		case 'x':
+			exit_compositor = true;
+			break;
+		case 'c':
+			compositor = optarg;
+			break;
+		default:
+			print_help();
+			return 0;
+		}
+	}
+	if (bench.num_windows < 1 || bench.num_rounds < 1) {
+		fprintf(stderr, "The window and round counts have to be positive\n");
+		return 1;
+	}
+
+	if (compositor) {
+		if (!output_path) {
+			fprintf(stderr, "-c needs an output path (-o)\n");
+			return 1;
+		}
+		return bench_spawn(compositor, argv[0], output_path,
+						   bench.num_windows, bench.num_rounds);
+	}
+
+	bench.windows = calloc(bench.num_windows, sizeof(*bench.windows));
+	if (!bench.windows) {
+		fprintf(stderr, "Could not allocate the windows\n");
+		return 1;
+	}
+
+	int ret = 1;
+	json_object *results = json_object_new_object();
+	if (bench_connect(&bench) && bench_run(&bench, results)) {
+		const char *json = json_object_to_json_string_ext(
+			results, JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_SPACED);
+		if (output_path) {
+			if (write_results(output_path, json)) {
+				ret = 0;
+			} else {
+				fprintf(stderr, "Could not write %s\n", output_path);
+			}
+		} else {
+			printf("%s\n", json);
+			ret = 0;
+		}
+	}
+	json_object_put(results);
+
+	if (exit_compositor && bench.ipc_replies) {
+		run_action(&bench, "exit");
+	}
+	bench_finish(&bench);
+	return ret;
+}
@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <json.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "constants.h"
+
+static void print_help(void) {
+	printf("Usage: fx-comp-msg [options] <command> [events...]\n");
+	printf("\t-s <path>\tIPC socket, defaults to $%s\n", IPC_SOCKET_ENV);
+	printf("\t-c <count>\tExit after receiving <count> events\n");
+	printf("\t-r\tPrint the raw JSON lines\n");
+	printf("\t-h\tDisplay this help message\n");
+	printf("Commands:\n");
+	printf("\tget_tree\tOutputs, workspaces and toplevels\n");
+	printf("\tget_outputs\tOutputs\n");
+	printf("\tget_metrics\tMemory, slab and input latency metrics\n");
+	printf("\texport_trace\tWrites the trace for Perfetto, prints the path\n");
+	printf("\trun <action> [arg]\tRuns a keybinding action\n");
+	printf("\tsubscribe <toplevel|focus|workspace|output>...\n"
+		   "\t\tPrints the current tree, followed by the events\n");
+}
+
+static int connect_socket(const char *path) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		fprintf(stderr, "Could not connect to %s: ", path);
+		perror(NULL);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/** Returns false if the line is an unsuccessful reply */
+static bool print_line(const char *line, bool raw) {
+	json_object *object = json_tokener_parse(line);
+	if (!object) {
+		fprintf(stderr, "Invalid JSON: %s", line);
+		return false;
+	}
+
+	if (raw) {
+		printf("%s\n", json_object_to_json_string_ext(object,
+													   JSON_C_TO_STRING_PLAIN));
+	} else {
+		printf("%s\n", json_object_to_json_string_ext(
+						   object, JSON_C_TO_STRING_PRETTY |
+									   JSON_C_TO_STRING_SPACED));
+	}
+	fflush(stdout);
+
+	json_object *success;
+	bool ok = !json_object_object_get_ex(object, "success", &success) ||
+			  json_object_get_boolean(success);
+	json_object_put(object);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	const char *socket_path = getenv(IPC_SOCKET_ENV);
+	long max_events = -1;
+	bool raw = false;
+
+	int c;
+	while ((c = getopt(argc, argv, "s:c:rh")) != -1) {
+		switch (c) {
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'c':
+			max_events = strtol(optarg, NULL, 10);
+			break;
+		case 'r':
+			raw = true;
+			break;
+		default:
+			print_help();
+			return 0;
+		}
+	}
+	if (optind >= argc) {
+		print_help();
+		return 1;
+	}
+	if (!socket_path) {
+		fprintf(stderr, "$%s is not set, is fx-comp running?\n",
+				IPC_SOCKET_ENV);
+		return 1;
+	}
+
+	const char *command = argv[optind];
+	json_object *request = json_object_new_object();
+	json_object_object_add(request, "id", json_object_new_int(1));
+	json_object_object_add(request, "command",
+						   json_object_new_string(command));
+	bool subscribe = strcmp(command, "subscribe") == 0;
+	if (subscribe) {
+		json_object *events = json_object_new_array();
+		for (int i = optind + 1; i < argc; i++) {
+			json_object_array_add(events, json_object_new_string(argv[i]));
+		}
+		json_object_object_add(request, "events", events);
+	} else if (strcmp(command, "run") == 0 && optind + 1 < argc) {
+		json_object_object_add(request, "action",
+							   json_object_new_string(argv[optind + 1]));
+		if (optind + 2 < argc) {
+			json_object_object_add(request, "arg",
+								   json_object_new_string(argv[optind + 2]));
+		}
+	}
+
+	int fd = connect_socket(socket_path);
+	if (fd < 0) {
+		json_object_put(request);
+		return 1;
+	}
+	FILE *stream = fdopen(fd, "r+");
+	if (!stream) {
+		perror("fdopen");
+		close(fd);
+		json_object_put(request);
+		return 1;
+	}
+
+	fprintf(stream, "%s\n",
+			json_object_to_json_string_ext(request, JSON_C_TO_STRING_PLAIN));
+	fflush(stream);
+	json_object_put(request);
+
+	// The reply, followed by the events when subscribed
+	int ret = 0;
+	long num_events = -1;
+	char *line = NULL;
+	size_t line_size = 0;
+	while (getline(&line, &line_size, stream) > 0) {
+		if (!print_line(line, raw)) {
+			ret = 1;
+			break;
+		}
+		num_events++;
+		if (!subscribe || (max_events >= 0 && num_events >= max_events)) {
+			break;
+		}
+	}
+	if (num_events < 0) {
+		fprintf(stderr, "The compositor closed the connection\n");
+		ret = 1;
+	}
+
+	free(line);
+	fclose(stream);
+	return ret;
+}
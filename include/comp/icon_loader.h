@@ -0,0 +1,75 @@
+#ifndef FX_COMP_ICON_LOADER_H
+#define FX_COMP_ICON_LOADER_H
+
+#include <cairo.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+enum comp_icon_dir_type {
+	COMP_ICON_DIR_THRESHOLD,
+	COMP_ICON_DIR_FIXED,
+	COMP_ICON_DIR_SCALABLE,
+};
+
+/** A "Directories" entry of an icon theme index.theme */
+struct comp_icon_dir {
+	char *name;
+	enum comp_icon_dir_type type;
+	int size;
+	int scale;
+	int min_size;
+	int max_size;
+	int threshold;
+};
+
+struct comp_icon_theme {
+	struct wl_list link;
+
+	char *name;
+	// Every base directory that contains this theme
+	char **base_dirs;
+
+	struct comp_icon_dir *dirs;
+	size_t num_dirs;
+};
+
+struct comp_icon_cache_entry {
+	struct wl_list link;
+
+	char *name;
+	int size;
+	double scale;
+	uint32_t color;
+
+	cairo_surface_t *surface;
+};
+
+struct comp_icon_loader {
+	bool themes_loaded;
+	// The configured theme, followed by its parents and hicolor
+	struct wl_list themes; // comp_icon_theme
+	char **search_paths;
+
+	struct wl_list entries; // comp_icon_cache_entry
+	// Rasterized icons, kept between runs
+	char *cache_dir;
+};
+
+/** Themes are only parsed once the first icon is requested */
+void comp_icon_loader_init(void);
+void comp_icon_loader_finish(void);
+/**
+ * Frees the rasterized icons and the parsed themes, which are loaded again
+ * on the next lookup
+ */
+void comp_icon_loader_release(void);
+
+/**
+ * Returns the icon rasterized for the scale. Symbolic icons are recolored with
+ * `color`. The surface is owned by the loader.
+ */
+cairo_surface_t *comp_icon_loader_get(const char *name, int size,
+									  double scale, uint32_t color);
+
+#endif // !FX_COMP_ICON_LOADER_H
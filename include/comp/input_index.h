@@ -0,0 +1,78 @@
+#ifndef FX_COMP_INPUT_INDEX_H
+#define FX_COMP_INPUT_INDEX_H
+
+#include <scenefx/types/wlr_scene.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/box.h>
+
+struct comp_input_index_entry {
+	struct wlr_scene_node *node;
+	// Layout coordinates of the node
+	struct wlr_box box;
+
+	struct wl_listener destroy;
+};
+
+/**
+ * Uniform grid covering one output. Each cell lists the indices of the entries
+ * overlapping it, ordered from the bottom to the top of the stack.
+ */
+struct comp_input_grid {
+	struct wlr_box box;
+	int cols;
+	int rows;
+	// struct wl_array of uint32_t per cell
+	struct wl_array *cells;
+};
+
+/**
+ * Spatial index of all nodes in the scene that could be returned by
+ * wlr_scene_node_at. Invalidated when surfaces are mapped, moved or resized,
+ * and lazily rebuilt on the next lookup.
+ */
+struct comp_input_index {
+	bool valid;
+
+	// struct comp_input_index_entry, in stacking order (bottom to top)
+	struct wl_array entries;
+
+	struct {
+		struct wlr_scene_node *node;
+		// The area where no other entry is stacked above the node
+		struct wlr_box clip;
+	} last_hit;
+
+	struct wl_listener new_surface;
+};
+
+void comp_input_index_init(struct comp_input_index *index);
+void comp_input_index_finish(struct comp_input_index *index);
+
+/**
+ * Invalidates the index when a client commit changes the size, mapped state
+ * or subsurfaces of a surface. Commits that only swap the buffer are ignored.
+ */
+void comp_input_index_track_surfaces(struct comp_input_index *index,
+									 struct wlr_compositor *compositor);
+
+/**
+ * Drops the index. It gets rebuilt on the next lookup. Has to be called
+ * whenever a node which accepts input is enabled, moved or resized.
+ */
+void comp_input_index_invalidate(struct comp_input_index *index);
+
+/**
+ * Equivalent to calling wlr_scene_node_at on the root node, but only tests the
+ * nodes overlapping the grid cell under the point.
+ */
+struct wlr_scene_node *comp_input_index_node_at(struct comp_input_index *index,
+												double lx, double ly,
+												double *sx, double *sy);
+
+void comp_input_grid_finish(struct comp_input_grid *grid);
+
+#endif // !FX_COMP_INPUT_INDEX_H
@@ -0,0 +1,101 @@
+#ifndef FX_COMP_IPC_H
+#define FX_COMP_IPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_pointer.h>
+
+struct comp_output;
+struct comp_toplevel;
+struct comp_workspace;
+
+enum comp_ipc_event_type {
+	// toplevel_map, toplevel_unmap, toplevel_title, toplevel_move and
+	// toplevel_state
+	COMP_IPC_EVENT_TOPLEVEL = 1 << 0,
+	COMP_IPC_EVENT_FOCUS = 1 << 1,
+	// workspace, workspace_add and workspace_remove
+	COMP_IPC_EVENT_WORKSPACE = 1 << 2,
+	// output_add and output_remove
+	COMP_IPC_EVENT_OUTPUT = 1 << 3,
+};
+
+struct comp_ipc_client {
+	struct wl_list link;
+
+	int fd;
+	struct wl_event_source *source;
+	// comp_ipc_event_type bitmask
+	uint32_t subscriptions;
+	// Last focus sent to the client, 0 if nothing is focused
+	uint32_t focused_id;
+
+	// Incomplete request line
+	struct wl_array read_buffer;
+	// Replies and events which couldn't be written without blocking
+	struct wl_array write_buffer;
+	size_t write_offset;
+	// The client has shut down its end, closed once everything is written
+	bool read_closed;
+
+	// Disconnected, but only destroyed from an idle callback, since requests
+	// and events can disconnect clients which are still being handled
+	bool closing;
+};
+
+struct comp_ipc {
+	int socket_fd;
+	char *socket_path;
+	struct wl_event_source *socket_source;
+
+	struct wl_list clients; // comp_ipc_client
+	// Destroys the closing clients
+	struct wl_event_source *destroy_idle;
+
+	// Sends one focus event per event loop iteration, instead of one for the
+	// unfocus and one for the focus
+	struct wl_event_source *focus_idle;
+
+	// Driven by the pointer command, added to the seat on first use
+	struct wlr_pointer pointer;
+	bool pointer_added;
+};
+
+/**
+ * Listens on $XDG_RUNTIME_DIR and exports the path as IPC_SOCKET_ENV.
+ *
+ * Requests are JSON objects, one per line, with a "command" and an optional
+ * "id" which is echoed in the reply. The commands are get_tree, get_outputs,
+ * get_metrics, export_trace, run, pointer and subscribe. run executes the
+ * keybinding "action" with the optional "arg", the same as pressing its
+ * binding, and fails while the session is locked.
+ */
+bool comp_ipc_init(void);
+void comp_ipc_finish(void);
+
+/*
+ * Events, only sent to the subscribed clients
+ */
+
+void comp_ipc_toplevel_map(struct comp_toplevel *toplevel);
+void comp_ipc_toplevel_unmap(struct comp_toplevel *toplevel);
+void comp_ipc_toplevel_title(struct comp_toplevel *toplevel);
+/** Moved to another workspace, which might be on another output */
+void comp_ipc_toplevel_move(struct comp_toplevel *toplevel);
+/**
+ * Sends the geometry, floating, fullscreen and minimized state if any of them
+ * changed since the last call
+ */
+void comp_ipc_toplevel_state(struct comp_toplevel *toplevel);
+void comp_ipc_focus_changed(void);
+void comp_ipc_workspace_changed(struct comp_output *output);
+void comp_ipc_workspace_added(struct comp_workspace *ws);
+/** Sent before the workspace is removed from its output */
+void comp_ipc_workspace_removed(struct comp_workspace *ws);
+void comp_ipc_output_added(struct comp_output *output);
+void comp_ipc_output_removed(struct comp_output *output);
+
+#endif // !FX_COMP_IPC_H
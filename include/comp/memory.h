@@ -0,0 +1,64 @@
+#ifndef FX_COMP_MEMORY_H
+#define FX_COMP_MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct comp_output;
+struct comp_toplevel;
+
+/** Buffer memory in bytes kept alive by a toplevel */
+struct comp_toplevel_memory {
+	struct comp_toplevel *toplevel;
+
+	// Buffers attached by the client, including its subsurfaces and popups
+	size_t client;
+	// Titlebar and resize edge buffers
+	size_t decorations;
+	// Snapshots saved for the animations and transactions
+	size_t saved;
+	size_t total;
+};
+
+/** Buffer memory in bytes kept alive by an output */
+struct comp_output_memory {
+	struct comp_output *output;
+
+	// Output and cursor swapchains
+	size_t swapchains;
+	// Estimated, see MEMORY_BLUR_BUFFERS_PER_OUTPUT
+	size_t blur;
+	// Layer shell and unmanaged XWayland surfaces
+	size_t layers;
+	// Workspace switch and overview snapshots
+	size_t snapshots;
+	size_t widgets;
+	size_t total;
+};
+
+struct comp_memory_usage {
+	// Sorted from largest to smallest
+	struct comp_toplevel_memory *toplevels;
+	size_t num_toplevels;
+	struct comp_output_memory *outputs;
+	size_t num_outputs;
+
+	size_t total;
+};
+
+/**
+ * Sums up the buffers of every toplevel and output. Buffers which are shared
+ * between scene trees, like snapshots of unchanged client buffers, are only
+ * counted for their first owner.
+ */
+bool comp_memory_usage_get(struct comp_memory_usage *usage);
+void comp_memory_usage_finish(struct comp_memory_usage *usage);
+
+/** Prints the memory usage of every toplevel and output */
+void comp_memory_report(void);
+
+/** Logs the total and the largest toplevel every MEMORY_LOG_INTERVAL_MS */
+bool comp_memory_log_start(void);
+void comp_memory_log_stop(void);
+
+#endif // !FX_COMP_MEMORY_H
@@ -0,0 +1,38 @@
+#ifndef FX_COMP_MEMORY_PRESSURE_H
+#define FX_COMP_MEMORY_PRESSURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-server-core.h>
+
+struct comp_memory_pressure {
+	// Watches memory.events, which only signals EPOLLPRI
+	int epoll_fd;
+	struct wl_event_source *epoll_source;
+
+	// A PSI trigger on the cgroup, or system wide memory pressure
+	int psi_fd;
+	// Only watches psi_fd. Polling a trigger clears its event, which the
+	// event loop already does, so this epoll waking up is the trigger firing.
+	int psi_epoll_fd;
+	struct wl_event_source *psi_source;
+
+	// memory.events of the cgroup, -1 if not running in a cgroup v2
+	int events_fd;
+	uint64_t high_events;
+
+	struct timespec last_release;
+};
+
+/** Starts watching for memory pressure, if the kernel supports PSI */
+void comp_memory_pressure_init(void);
+void comp_memory_pressure_finish(void);
+
+/**
+ * Frees memory that can be rebuilt when needed: decorations and snapshots of
+ * hidden workspaces, icons, fonts and empty slab pages.
+ */
+void comp_memory_pressure_release(void);
+
+#endif // !FX_COMP_MEMORY_PRESSURE_H
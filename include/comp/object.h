@@ -40,6 +40,8 @@ struct comp_object {
 	size_t num_txn_refs;
 	struct wl_list dirty_link;
 	bool dirty;
+	// Configure the client even if the next commit isn't a server request
+	bool dirty_server_request;
 };
 
 struct comp_object *comp_object_at(struct comp_server *server, double lx,
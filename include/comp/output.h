@@ -1,6 +1,7 @@
 #ifndef FX_COMP_OUTPUT_H
 #define FX_COMP_OUTPUT_H
 
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 
@@ -25,6 +26,9 @@ struct comp_output {
 		struct wlr_scene_optimized_blur *optimized_blur_node;
 		// TODO: Make fullscreen a layer
 		struct wlr_scene_tree *workspaces;
+		// Workspace snapshots, only shown while switching workspaces
+		struct wlr_scene_tree *workspace_switch;
+		struct wlr_scene_tree *overview;
 		// for unmanaged XWayland surfaces without a parent
 		struct wlr_scene_tree *unmanaged;
 		struct wlr_scene_tree *shell_top;
@@ -33,17 +37,33 @@ struct comp_output {
 	} layers;
 
 	struct comp_ws_indicator *ws_indicator;
+	// NULL unless the overview is shown
+	struct comp_overview *overview;
 
 	struct wl_list workspaces;
 	struct comp_workspace *active_workspace;
 	struct comp_workspace *prev_workspace;
 
+	struct {
+		struct comp_animation_client *client;
+		struct comp_workspace *from;
+		struct comp_workspace *to;
+		// 1 if the new workspace slides in from the right, -1 if from the left
+		int direction;
+	} ws_switch;
+
 	struct wlr_box usable_area;
 	struct wlr_box geometry;
 
+	struct comp_input_grid input_grid;
+
 	uint32_t refresh_nsec;
 	float refresh_sec;
 
+	// Rendered frames, exposed through the IPC to measure the frame rate
+	uint64_t num_frames;
+	struct timespec last_frame;
+
 	struct wl_listener frame;
 	struct wl_listener request_state;
 	struct wl_listener present;
@@ -60,6 +80,7 @@ struct comp_output {
  * Util
  */
 
+/** Creates a workspace next to the active one and focuses it */
 struct comp_workspace *comp_output_new_workspace(struct comp_output *output,
 												 enum comp_workspace_type type);
 void comp_output_remove_workspace(struct comp_output *output,
@@ -91,6 +112,10 @@ void comp_output_move_workspace_to(struct comp_output *dest_output,
 								   struct comp_workspace *ws);
 void comp_output_focus_workspace(struct comp_output *output,
 								 struct comp_workspace *ws);
+/** Focuses the workspace and slides it in from the workspace snapshots */
+void comp_output_switch_workspace(struct comp_output *output,
+								  struct comp_workspace *ws);
+void comp_output_cancel_workspace_switch(struct comp_output *output);
 struct comp_workspace *comp_output_prev_workspace(struct comp_output *output,
 												  bool should_wrap);
 struct comp_workspace *comp_output_next_workspace(struct comp_output *output,
@@ -0,0 +1,77 @@
+#ifndef FX_COMP_OVERVIEW_H
+#define FX_COMP_OVERVIEW_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/util/box.h>
+#include <xkbcommon/xkbcommon.h>
+
+/** A surface of the toplevel, including subsurfaces */
+struct comp_overview_part {
+	struct wl_list link;
+
+	struct comp_overview_item *item;
+	struct wlr_surface *surface;
+
+	// Shows the client's current buffer, scaled down
+	struct wlr_scene_buffer *scene_buffer;
+
+	struct wl_listener commit;
+	struct wl_listener destroy;
+	struct wl_listener frame_done;
+};
+
+struct comp_overview_item {
+	struct wl_list link;
+
+	struct comp_overview *overview;
+	struct comp_toplevel *toplevel;
+	// The main surface
+	struct wlr_surface *surface;
+
+	struct wlr_scene_tree *tree;
+	// comp_overview_part.link, in stacking order
+	struct wl_list parts;
+	// Output-relative box of the thumbnail
+	struct wlr_box box;
+	double scale;
+};
+
+struct comp_overview {
+	struct comp_output *output;
+	// The workspace hidden behind the overview
+	struct comp_workspace *workspace;
+
+	struct wlr_scene_tree *tree;
+	struct wlr_scene_rect *background;
+
+	struct wl_list items;
+};
+
+void comp_overview_toggle(struct comp_output *output);
+
+/** Also used to tear down the overview when the workspace changes */
+void comp_overview_exit(struct comp_output *output);
+
+/** Adds a thumbnail if the workspace of the toplevel is in an overview */
+void comp_overview_toplevel_add(struct comp_toplevel *toplevel);
+/**
+ * Drops the thumbnail of the toplevel. Has to be called before the toplevel
+ * is unmapped, minimized, moved to another workspace or destroyed.
+ */
+void comp_overview_toplevel_remove(struct comp_toplevel *toplevel);
+
+/**
+ * Focuses the toplevel beneath the output-relative point and exits the
+ * overview. Returns false if the overview isn't active.
+ */
+bool comp_overview_click(struct comp_output *output, double x, double y);
+
+/**
+ * Escape exits the overview. Returns true if the key should be kept from
+ * the clients, which is every key while the overview is shown.
+ */
+bool comp_overview_handle_key(struct comp_output *output, xkb_keysym_t sym);
+
+#endif // !FX_COMP_OVERVIEW_H
@@ -6,6 +6,11 @@
 #include <wlr/util/box.h>
 
 #include "comp/animation_mgr.h"
+#include "comp/icon_loader.h"
+#include "comp/input_index.h"
+#include "comp/ipc.h"
+#include "comp/memory_pressure.h"
+#include "comp/slab.h"
 #include "comp/xwayland_mgr.h"
 
 /* For brevity's sake, struct members are annotated where they are used. */
@@ -62,13 +67,39 @@ struct comp_server {
 	// XWayland
 	struct comp_xwayland_mgr xwayland_mgr;
 	struct wl_listener new_xwayland_surface;
+	struct wl_listener xwayland_start;
 	struct wl_listener xwayland_ready;
 
 	struct wlr_pointer_constraints_v1 *pointer_constraints;
 	struct wl_listener pointer_constraint;
 	struct wlr_relative_pointer_manager_v1 *relative_pointer_manager;
 
+	struct wlr_cursor_shape_manager_v1 *cursor_shape_manager;
+	struct wl_listener request_set_cursor_shape;
+
 	struct comp_seat *seat;
+	struct comp_keybindings *keybindings;
+
+	// Compiled XKB keymaps, shared between all keyboards
+	struct {
+		struct xkb_context *context;
+		struct wl_list keymaps; // comp_keymap_cache_entry
+	} keymap_cache;
+
+	// Titlebar button icons
+	struct comp_icon_loader icon_loader;
+
+	// JSON IPC socket, see comp/ipc.h
+	struct comp_ipc ipc;
+
+	// Releases the caches when the system runs low on memory
+	struct comp_memory_pressure memory_pressure;
+
+	// Processes launched by comp_spawn, until they're reaped
+	struct {
+		struct wl_list processes; // comp_spawned_process
+		struct wl_event_source *sigchld_source;
+	} spawn;
 
 	struct wlr_output_manager_v1 *output_manager;
 	struct wl_listener output_manager_apply;
@@ -86,6 +117,18 @@ struct comp_server {
 
 	struct comp_animation_mgr *animation_mgr;
 
+	// Objects allocated for every toplevel
+	struct {
+		struct comp_slab toplevels;
+		struct comp_slab animation_clients;
+		struct comp_slab saved_objects;
+		struct comp_slab titlebars;
+		struct comp_slab resize_edges;
+	} slabs;
+
+	// Used for pointer hit testing
+	struct comp_input_index input_index;
+
 	/*
 	 * Protocols
 	 */
@@ -111,13 +154,34 @@ struct comp_server {
 	// the pending transaction.
 	struct wl_list dirty_objects;
 
+	// Defers the dirty commits until the outermost batch has ended, so that
+	// one operation only produces one transaction.
+	struct {
+		int depth;
+		bool pending;
+		bool server_request;
+	} transaction_batch;
+
 	/* ext-session-lock-v1 */
 	struct comp_session_lock comp_session_lock;
 
 	// Debugging
 	struct {
 		bool log_txn_timings;
+		bool input_latency;
+		bool input_latency_bench;
+		bool startup_trace;
+		bool startup_trace_exit;
+		bool slab_stats;
+		bool memory_log;
+		bool trace;
 	} debug;
+	// Only set when the input latency tracing is enabled
+	struct comp_latency *latency;
+	// Only set when the startup tracing is enabled
+	struct comp_startup_trace *startup_trace;
+	// Only set when the periodic memory log is enabled
+	struct wl_event_source *memory_log_timer;
 };
 
 extern struct comp_server server;
@@ -0,0 +1,57 @@
+#ifndef FX_COMP_SLAB_H
+#define FX_COMP_SLAB_H
+
+#include <stddef.h>
+#include <wayland-util.h>
+
+struct comp_slab_page {
+	struct wl_list link;
+
+	size_t used;
+	// Singly linked through the first bytes of each free object
+	void *free_list;
+
+	_Alignas(max_align_t) unsigned char objects[];
+};
+
+/**
+ * Fixed size object allocator for the compositor objects that are created and
+ * destroyed with every toplevel. Objects are packed into pages, so that window
+ * churn reuses the same memory instead of fragmenting the heap.
+ */
+struct comp_slab {
+	const char *name;
+	size_t object_size;
+
+	struct wl_list pages; // comp_slab_page
+	// At most one empty page is kept for the next object
+	size_t num_empty_pages;
+
+	// Debug counters
+	size_t live;
+	size_t peak;
+	size_t num_pages;
+};
+
+void comp_slab_init(struct comp_slab *slab, const char *name,
+					size_t object_size);
+/** Frees all pages, logging the objects that are still alive */
+void comp_slab_finish(struct comp_slab *slab);
+
+/** Returns a zeroed object, like calloc */
+void *comp_slab_alloc(struct comp_slab *slab);
+void comp_slab_free(struct comp_slab *slab, void *object);
+/** Frees the empty pages, including the one kept for the next object */
+void comp_slab_shrink(struct comp_slab *slab);
+
+/** Sets up the slabs of the per-toplevel objects in `server.slabs` */
+void comp_slabs_init(void);
+void comp_slabs_finish(void);
+void comp_slabs_shrink(void);
+/** Returns the i-th server slab, or NULL after the last one */
+struct comp_slab *comp_slabs_get(size_t i);
+
+/** Prints the live objects of every server slab */
+void comp_slabs_report(void);
+
+#endif // !FX_COMP_SLAB_H
@@ -0,0 +1,39 @@
+#ifndef FX_COMP_SPAWN_H
+#define FX_COMP_SPAWN_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+
+struct comp_toplevel;
+
+struct comp_spawned_process {
+	struct wl_list link;
+
+	char *cmd;
+	pid_t pid;
+	struct timespec spawned;
+	// Only the first toplevel counts towards the launch latency
+	bool mapped;
+
+	// -1 when pidfds aren't supported, reaped on SIGCHLD instead
+	int pidfd;
+	struct wl_event_source *pidfd_source;
+};
+
+void comp_spawn_init(void);
+/** Stops tracking the spawned processes, which keep running */
+void comp_spawn_finish(void);
+
+/**
+ * Runs the command through `sh -c` without blocking the event loop. The
+ * process is reaped asynchronously.
+ */
+bool comp_spawn(const char *cmd);
+
+/** Logs the launch-to-map latency if the toplevel came from comp_spawn */
+void comp_spawn_toplevel_map(struct comp_toplevel *toplevel);
+
+#endif // !FX_COMP_SPAWN_H
@@ -0,0 +1,71 @@
+#ifndef FX_COMP_STARTUP_TRACE_H
+#define FX_COMP_STARTUP_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <wayland-server-core.h>
+
+#include "constants.h"
+
+struct comp_output;
+struct comp_toplevel;
+
+enum comp_startup_event_type {
+	// A step of main(), from the end of the previous phase
+	COMP_STARTUP_EVENT_PHASE,
+	// Something that happened after the event loop has started
+	COMP_STARTUP_EVENT_MILESTONE,
+};
+
+struct comp_startup_event {
+	enum comp_startup_event_type type;
+	char name[64];
+	struct timespec start;
+	struct timespec end;
+};
+
+struct comp_startup_trace {
+	struct timespec start;
+	struct timespec last_phase_end;
+
+	struct comp_startup_event events[STARTUP_TRACE_MAX_EVENTS];
+	size_t num_events;
+
+	bool running;
+	// Only wait for the first map if a startup command was given
+	bool wait_for_map;
+	bool mapped;
+	bool exit_when_done;
+	// Every output has presented a frame, and the first toplevel has mapped
+	bool complete;
+	bool reported;
+
+	struct wl_event_source *loop_idle;
+	struct wl_event_source *timeout;
+};
+
+/** Stamps the start time, should be called as early as possible */
+struct comp_startup_trace *comp_startup_trace_create(bool wait_for_map,
+													 bool exit_when_done);
+void comp_startup_trace_destroy(struct comp_startup_trace *trace);
+
+/**
+ * Ends the current startup phase, which started at the end of the last one.
+ * No-op if the startup tracing isn't enabled.
+ */
+void comp_startup_trace_phase(const char *name);
+
+/** Waits for the first frames, called right before running the event loop */
+void comp_startup_trace_run(void);
+
+void comp_startup_trace_output_frame(struct comp_output *output);
+void comp_startup_trace_toplevel_map(struct comp_toplevel *toplevel);
+
+/**
+ * Prints the startup waterfall and writes it as JSON. Only reports once, and
+ * marks the trace as incomplete if it's still waiting for frames.
+ */
+void comp_startup_trace_report(struct comp_startup_trace *trace);
+
+#endif // !FX_COMP_STARTUP_TRACE_H
@@ -0,0 +1,44 @@
+#ifndef FX_COMP_TILING_LAYOUT_H
+#define FX_COMP_TILING_LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <wlr/util/box.h>
+
+enum comp_tiling_layout_type {
+	// The binary split tree of tiling_node
+	COMP_TILING_LAYOUT_BSP,
+	COMP_TILING_LAYOUT_MASTER_STACK,
+	COMP_TILING_LAYOUT_COLUMNS,
+	COMP_TILING_LAYOUT_GRID,
+	COMP_TILING_LAYOUT_COUNT,
+};
+
+struct comp_tiling_params {
+	// MASTER_STACK: Width of the master area
+	double master_ratio;
+	int gaps_inner;
+	int gaps_outer;
+};
+
+struct comp_tiling_layout_impl {
+	const char *name;
+	/**
+	 * Computes the gapless box of every leaf in a single pass, in the order of
+	 * the leaves in the tiling tree. NULL if the tiling tree itself is the
+	 * layout.
+	 */
+	void (*arrange)(const struct wlr_box *area,
+					const struct comp_tiling_params *params, size_t count,
+					struct wlr_box *boxes);
+};
+
+const struct comp_tiling_layout_impl *
+comp_tiling_layout_get_impl(enum comp_tiling_layout_type type);
+
+bool comp_tiling_layout_from_name(const char *name,
+								  enum comp_tiling_layout_type *type);
+
+void comp_tiling_params_init(struct comp_tiling_params *params);
+
+#endif // !FX_COMP_TILING_LAYOUT_H
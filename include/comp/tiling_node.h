@@ -2,7 +2,6 @@
 #define FX_COMP_TILING_CONTAINER_H
 
 #include <stdbool.h>
-#include <time.h>
 #include <wayland-util.h>
 #include <wlr/util/box.h>
 
@@ -14,9 +13,10 @@ struct tiling_node {
 
 	struct comp_workspace *ws;
 
-	struct timespec time;
-
 	bool is_node;
+	// The box or split ratio has changed since the last layout. Also set on
+	// all ancestors so that the layout can skip clean subtrees.
+	bool dirty;
 	// NODE: Gapless size and position
 	struct wlr_box box;
 	// NODE: Split ratio
@@ -29,6 +29,13 @@ struct tiling_node {
 
 struct tiling_node *tiling_node_init(struct comp_workspace *ws, bool is_node);
 
+/** Marks the node and its ancestors for the next workspace layout */
+void tiling_node_mark_dirty(struct tiling_node *node);
+
+/**
+ * Fits the root node to the usable area and lays out the subtrees that have
+ * changed
+ */
 void tiling_node_mark_workspace_dirty(struct comp_workspace *workspace);
 
 /** Adds, resizes, and repositions the toplevel */
@@ -38,9 +45,15 @@ void tiling_node_remove_toplevel(struct comp_toplevel *toplevel);
 
 void tiling_node_resize_start(struct comp_toplevel *toplevel);
 void tiling_node_resize_fini(struct comp_toplevel *toplevel);
+/** Updates the split ratios and pending sizes. Doesn't commit. */
 void tiling_node_resize(struct comp_toplevel *toplevel);
 
 void tiling_node_move_start(struct comp_toplevel *toplevel);
+/** Updates the drop preview. Doesn't touch the tiled toplevels. */
+void tiling_node_move_update(struct comp_toplevel *toplevel);
+/** Re-lays out the tree for the dropped toplevel and commits */
 void tiling_node_move_fini(struct comp_toplevel *toplevel);
+/** Drops the held tiling slot without tiling the toplevel. Doesn't commit. */
+void tiling_node_move_cancel(struct comp_toplevel *toplevel);
 
 #endif // !FX_COMP_CONTAINER_H
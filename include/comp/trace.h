@@ -0,0 +1,59 @@
+#ifndef FX_COMP_TRACE_H
+#define FX_COMP_TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "constants.h"
+
+struct comp_trace_event {
+	// A string literal, only the pointer is stored
+	const char *name;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+};
+
+/** Only written to by its own thread, the exporter only reads */
+struct comp_trace_ring {
+	struct comp_trace_ring *next;
+	pid_t tid;
+	// Total number of events ever written, the slot is head % TRACE_RING_SIZE
+	_Atomic uint64_t head;
+	struct comp_trace_event events[TRACE_RING_SIZE];
+};
+
+/** Set by `-D trace`, checked by every trace point */
+extern atomic_bool comp_trace_enabled;
+
+void comp_trace_init(void);
+void comp_trace_finish(void);
+
+/** Appends to the ring of the calling thread, allocating it if needed */
+void comp_trace_record(const char *name, uint64_t start_ns);
+
+/**
+ * Writes every ring as Chrome trace JSON, which can be opened in Perfetto.
+ * Returns the path, which has to be freed with g_free, or NULL on failure.
+ */
+char *comp_trace_export(void);
+
+/** CLOCK_MONOTONIC in nanoseconds */
+uint64_t comp_trace_now_ns(void);
+
+/** Returns 0 if tracing is disabled, which makes comp_trace_end a no-op */
+static inline uint64_t comp_trace_begin(void) {
+	if (!atomic_load_explicit(&comp_trace_enabled, memory_order_relaxed)) {
+		return 0;
+	}
+	return comp_trace_now_ns();
+}
+
+static inline void comp_trace_end(const char *name, uint64_t start_ns) {
+	if (start_ns != 0) {
+		comp_trace_record(name, start_ns);
+	}
+}
+
+#endif // !FX_COMP_TRACE_H
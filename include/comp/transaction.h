@@ -51,6 +51,17 @@ struct comp_transaction_instruction {
 };
 
 void comp_transaction_commit_dirty(bool server_request);
+
+/**
+ * Starts a batch. Commits are deferred until the matching
+ * comp_transaction_batch_end. Batches can be nested.
+ */
+void comp_transaction_batch_begin(void);
+/**
+ * Commits everything deferred by the batch, and every object still marked
+ * dirty, in a single transaction
+ */
+void comp_transaction_batch_end(void);
 void comp_transaction_instruction_mark_ready(
 	struct comp_transaction_instruction *instruction);
 
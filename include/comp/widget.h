@@ -21,7 +21,8 @@ struct comp_widget_click_region {
 	void (*handle_click)(struct comp_widget *widget,
 						 struct comp_widget_click_region *region);
 
-	void *data;
+	// Widget specific, like the titlebar button type
+	int data;
 };
 
 struct comp_widget {
@@ -43,6 +44,8 @@ struct comp_widget {
 
 	struct cairo_buffer *buffer;
 	pixman_region32_t damage;
+	// The buffer was freed while hidden, and needs to be redrawn
+	bool buffer_released;
 
 	// Effects
 	int corner_radius;
@@ -88,6 +91,11 @@ void comp_widget_damage_full(struct comp_widget *widget);
 /** Redraws the full widget (fully damaged) */
 void comp_widget_draw_full(struct comp_widget *widget);
 
+/** Frees the buffer of a hidden widget, until it's redrawn */
+void comp_widget_release_buffer(struct comp_widget *widget);
+/** Redraws the widget if its buffer has been released */
+void comp_widget_restore_buffer(struct comp_widget *widget);
+
 void comp_widget_center_on_output(struct comp_widget *widget,
 								  struct comp_output *output);
 
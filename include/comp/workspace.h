@@ -2,11 +2,13 @@
 #define FX_COMP_WORKSPACE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_output_layout.h>
 
 #include "comp/object.h"
+#include "comp/tiling_layout.h"
 #include "comp/tiling_node.h"
 #include "desktop/toplevel.h"
 #include "server.h"
@@ -19,6 +21,9 @@ enum comp_workspace_type {
 struct comp_workspace {
 	struct wl_list output_link;
 
+	// Unique for the lifetime of the compositor, never 0. Used by the IPC.
+	uint32_t id;
+
 	enum comp_workspace_type type;
 
 	struct comp_output *output;
@@ -36,10 +41,20 @@ struct comp_workspace {
 
 	// Toplevels and Popups. Also contains the focus order
 	struct wl_list toplevels;
+	// Incremented every time a toplevel is moved to the front of `toplevels`
+	uint64_t focus_serial;
 
 	struct comp_toplevel *fullscreen_toplevel;
 
+	// Cached contents for the switch animation. Only rebuilt after the
+	// workspace has changed.
+	struct wlr_scene_tree *snapshot;
+	bool snapshot_dirty;
+
 	struct wl_list tiling_nodes;
+	struct tiling_node *tiling_root;
+	enum comp_tiling_layout_type tiling_layout;
+	struct comp_tiling_params tiling_params;
 };
 
 /*
@@ -59,10 +74,29 @@ struct comp_toplevel *
 comp_workspace_get_toplevel_direction(struct comp_workspace *ws,
 									  enum wlr_direction direction);
 
+/**
+ * Gets the cached snapshot of the workspace, rebuilding it if the workspace
+ * has changed. The snapshot is disabled and might be NULL.
+ */
+struct wlr_scene_tree *comp_workspace_get_snapshot(struct comp_workspace *ws);
+void comp_workspace_destroy_snapshot(struct comp_workspace *ws);
+
+/**
+ * Frees the snapshot and the decoration buffers of a hidden workspace. They're
+ * redrawn before the workspace is shown again.
+ */
+void comp_workspace_release_buffers(struct comp_workspace *ws);
+void comp_workspace_restore_buffers(struct comp_workspace *ws);
+
+/** Re-arranges the tiled toplevels in a single transaction */
+void comp_workspace_set_tiling_layout(struct comp_workspace *ws,
+									  enum comp_tiling_layout_type type);
+
 /*
  * Main
  */
 
+/** Doesn't focus the workspace, see comp_output_new_workspace */
 struct comp_workspace *comp_workspace_new(struct comp_output *output,
 										  enum comp_workspace_type type);
 
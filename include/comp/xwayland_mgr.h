@@ -2,7 +2,9 @@
 #define FX_COMP_XWAYLAND_H
 
 #include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
 #include <wlr/xwayland.h>
+#include <wlr/xwayland/server.h>
 #include <xcb/xproto.h>
 
 enum atom_name {
@@ -22,11 +24,29 @@ enum atom_name {
 
 struct comp_xwayland_mgr {
 	struct wlr_xwayland *wlr_xwayland;
+	// Only set when started lazily, owned by us instead of wlr_xwayland
+	struct wlr_xwayland_server *wlr_xwayland_server;
 	struct wlr_xcursor_manager *xcursor_manager;
 
 	xcb_atom_t atoms[ATOM_LAST];
+	// Reset every time that the X server is (re)started
+	bool atoms_resolved;
 };
 
+/**
+ * Creates the Xwayland server. If `lazy`, it's only started once the first X
+ * client connects to DISPLAY, and stops again after `idle_timeout_s` seconds
+ * without any X clients. An idle timeout of 0 keeps it running.
+ */
+struct wlr_xwayland *comp_xwayland_mgr_create(struct comp_xwayland_mgr *mgr,
+											  struct wl_display *display,
+											  struct wlr_compositor *compositor,
+											  bool lazy, int idle_timeout_s);
+
+void comp_xwayland_mgr_destroy(struct comp_xwayland_mgr *mgr);
+
+void xwayland_start_cb(struct wl_listener *listener, void *data);
+
 void xwayland_ready_cb(struct wl_listener *listener, void *data);
 
 void xwayland_new_surface(struct wl_listener *listener, void *data);
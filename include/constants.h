@@ -5,11 +5,18 @@
 #define WL_COMPOSITOR_VERSION 6
 #define XDG_SHELL_VERSION 6
 #define LAYER_SHELL_VERSION 4
+#define CURSOR_SHAPE_VERSION 1
 
 #define NSEC_IN_SECONDS (long)1000000000
 
 #define TRANSACTION_TIME_MS 200
 
+// Size of each cell in the per-output pointer hit testing grid
+#define INPUT_INDEX_CELL_SIZE 128
+
+// Objects per page of the per-toplevel object slabs
+#define SLAB_OBJECTS_PER_PAGE 16
+
 #define HEADLESS_FALLBACK_OUTPUT_WIDTH 800
 #define HEADLESS_FALLBACK_OUTPUT_HEIGHT 600
 
@@ -18,10 +25,18 @@
 #define BLUR_PASSES 3
 
 #define TERM "kitty"
+// How many parents of a mapped client are checked against spawned commands
+#define SPAWN_MAX_PARENT_DEPTH 4
 
 #define TILING_SPLIT_RATIO 0.5
 #define TILING_GAPS_INNER 12 / 2
 #define TILING_GAPS_OUTER 12 / 2
+#define TILING_DRAG_PREVIEW_COLOR 0xFFFFFF33
+
+// Used when the GSettings icon theme isn't available
+#define ICON_THEME_FALLBACK "Adwaita"
+// Rasterized icons, relative to $XDG_CACHE_HOME
+#define ICON_CACHE_DIR "fx-comp/icons"
 
 /*
  * Overlays
@@ -44,6 +59,14 @@
 #define WORKSPACE_SWITCHER_FADE_OUT_MS 150
 #define WORKSPACE_SWITCHER_ITEM_WIDTH 100
 #define WORKSPACE_SWITCHER_ITEM_HEIGHT 100
+#define WORKSPACE_SWITCH_ANIMATION_DURATION_MS 250
+
+/*
+ * Overview
+ */
+
+#define OVERVIEW_COLOR_BACKGROUND 0x000000AA
+#define OVERVIEW_PADDING 32
 
 /*
  * Lock
@@ -142,4 +165,83 @@
 #define INPUT_POINTER_ACCEL_SPEED (double)-0.5
 #define INPUT_POINTER_SCROLL_METHOD (int)LIBINPUT_CONFIG_SCROLL_2FG
 
+/*
+ * Input latency tracing
+ */
+
+// Power of two millisecond buckets, the last one collects everything above
+#define LATENCY_HISTOGRAM_BUCKETS 10
+#define LATENCY_BENCH_START_DELAY_MS 2000
+#define LATENCY_BENCH_INTERVAL_MS 50
+#define LATENCY_BENCH_EVENTS 400
+
+/*
+ * Startup tracing
+ */
+
+#define STARTUP_TRACE_MAX_EVENTS 64
+// Reports an incomplete trace if the first frames haven't arrived by then
+#define STARTUP_TRACE_TIMEOUT_MS 10000
+#define STARTUP_TRACE_WATERFALL_WIDTH 40
+// Written into $XDG_RUNTIME_DIR, or /tmp if unset
+#define STARTUP_TRACE_JSON_NAME "fx-comp-startup.json"
+
+/*
+ * Memory accounting
+ */
+
+#define MEMORY_LOG_INTERVAL_MS 60000
+// The blur and effects framebuffers scenefx allocates for every output. These
+// aren't exposed, so their size is estimated from the output size.
+#define MEMORY_BLUR_BUFFERS_PER_OUTPUT 4
+// PSI trigger: some task stalled on memory for 10% of a 2s window. Windows
+// need to be a multiple of 2s for unprivileged processes.
+#define MEMORY_PRESSURE_STALL_US 200000
+#define MEMORY_PRESSURE_WINDOW_US 2000000
+// Minimum time between two releases
+#define MEMORY_PRESSURE_COOLDOWN_MS 10000
+
+/*
+ * IPC
+ */
+
+// Exported to the children, so that they can find the socket
+#define IPC_SOCKET_ENV "FX_COMP_IPC_SOCK"
+// Created in $XDG_RUNTIME_DIR, with the pid of the compositor
+#define IPC_SOCKET_NAME "fx-comp-ipc.%d.sock"
+// Requests are newline delimited JSON objects
+#define IPC_MAX_REQUEST_SIZE 65536
+// Clients which don't read their events are disconnected
+#define IPC_MAX_CLIENT_BUFFER (4 * 1024 * 1024)
+
+/*
+ * Tracing
+ */
+
+// Events per thread, has to be a power of two. The oldest events are
+// overwritten, 16384 events are roughly the last 10s of 60Hz frames.
+#define TRACE_RING_SIZE 16384
+// Written into $XDG_RUNTIME_DIR, or /tmp if unset
+#define TRACE_JSON_NAME "fx-comp-trace.%d.json"
+
+/*
+ * Benchmark (fx-comp-bench)
+ */
+
+#define BENCH_DEFAULT_WINDOWS 8
+#define BENCH_DEFAULT_ROUNDS 10
+#define BENCH_WINDOW_WIDTH 640
+#define BENCH_WINDOW_HEIGHT 480
+// A step is done once nothing has changed for this long
+#define BENCH_SETTLE_MS 150
+// How often the frame counters are polled while waiting for them to settle
+#define BENCH_POLL_MS 10
+// A step that takes longer than this fails the benchmark
+#define BENCH_TIMEOUT_MS 10000
+// Pointer motions per interactive resize, half growing and half shrinking
+#define BENCH_RESIZE_MOTIONS 200
+#define BENCH_RESIZE_MOTION_PX 2
+// About the rate of a 250 Hz mouse
+#define BENCH_RESIZE_INTERVAL_MS 4
+
 #endif // !FX_COMP_CONSTANTS
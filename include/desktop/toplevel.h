@@ -2,6 +2,7 @@
 #define FX_COMP_TOPLEVEL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_compositor.h>
@@ -42,6 +43,9 @@ struct comp_toplevel {
 
 	struct comp_server *server;
 
+	// Unique for the lifetime of the compositor, never 0. Used by the IPC.
+	uint32_t id;
+
 	struct comp_object object;
 
 	struct wlr_scene_tree *toplevel_scene_tree;
@@ -70,8 +74,12 @@ struct comp_toplevel {
 	struct tiling_node *tiling_node;
 	enum comp_tiling_mode tiling_mode;
 	bool dragging_tiled;
+	// The tiled slot held while dragging a tiled toplevel
+	struct tiling_node *tiling_drag_node;
 	bool minimized;
 	bool fullscreen;
+	// Position in the workspace focus order, higher is more recent
+	uint64_t focus_rank;
 	pid_t pid;
 	char title[TOPLEVEL_TITLEBAR_LEN];
 
@@ -102,6 +110,13 @@ struct comp_toplevel {
 	struct comp_toplevel_state pending_state;
 	// Used to restore the state when exiting fullscreen
 	struct comp_toplevel_state saved_state;
+	// The state last reported by the toplevel_state IPC event
+	struct {
+		struct comp_toplevel_state geometry;
+		enum comp_tiling_mode tiling_mode;
+		bool fullscreen;
+		bool minimized;
+	} ipc_state;
 
 	/**
 	 * Whether the toplevel is mapped and visible (waiting for size change) or
@@ -191,6 +206,11 @@ void comp_toplevel_center(struct comp_toplevel *toplevel, int width, int height,
 void comp_toplevel_save_buffer(struct comp_toplevel *toplevel);
 void comp_toplevel_remove_buffer(struct comp_toplevel *toplevel);
 
+/** Frees the decoration buffers while the toplevel is hidden */
+void comp_toplevel_release_buffers(struct comp_toplevel *toplevel);
+/** Redraws the decorations released by comp_toplevel_release_buffers */
+void comp_toplevel_restore_buffers(struct comp_toplevel *toplevel);
+
 /*
  * Implementation functions
  */
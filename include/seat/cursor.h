@@ -20,7 +20,13 @@ struct comp_cursor {
 	struct wl_list tablet_pads;
 
 	enum comp_cursor_mode cursor_mode;
+	// Motion during a move/resize grab, applied once per output frame
+	struct {
+		bool pending;
+		uint32_t time;
+	} grab_motion;
 
+	// The current xcursor name, NULL when a client has set the image
 	const char *image;
 	struct wl_client *image_client;
 	struct wlr_surface *image_surface;
@@ -48,6 +54,23 @@ struct comp_cursor {
 
 void comp_cursor_reset_cursor_mode(struct comp_seat *seat);
 
+/** Schedules the move/resize grab to be applied on the next output frame */
+void comp_cursor_queue_grab_motion(struct comp_cursor *cursor, uint32_t time);
+
+/** Applies the accumulated move/resize grab motion, if any */
+void comp_cursor_flush_grab_motion(struct comp_cursor *cursor);
+
+/** Sets the xcursor image if it isn't already shown */
+void comp_cursor_set_image(struct comp_cursor *cursor, const char *image);
+
+void comp_cursor_set_client_image(struct comp_cursor *cursor,
+								  struct wl_client *client,
+								  struct wlr_surface *surface, int hotspot_x,
+								  int hotspot_y);
+
+/** Loads the cursor theme for the scale ahead of the first pointer motion */
+void comp_cursor_load_scale(struct comp_cursor *cursor, float scale);
+
 void comp_cursor_destroy(struct comp_cursor *cursor);
 
 struct comp_cursor *comp_cursor_create(struct comp_seat *seat);
@@ -56,6 +79,9 @@ struct comp_cursor *comp_cursor_create(struct comp_seat *seat);
  * Protocols
  */
 
+void comp_cursor_handle_request_set_shape(struct wl_listener *listener,
+										  void *data);
+
 void comp_cursor_handle_pointer_constraint(struct wl_listener *listener,
 										   void *data);
 
@@ -1,7 +1,34 @@
 #ifndef FX_SEAT_INPUT_H
 #define FX_SEAT_INPUT_H
 
+#include <stdbool.h>
+#include <wayland-util.h>
 #include <wlr/types/wlr_input_device.h>
+#include <xkbcommon/xkbcommon.h>
+
+struct comp_keymap_cache_entry {
+	struct wl_list link;
+
+	char *rules;
+	char *model;
+	char *layout;
+	char *variant;
+	char *options;
+
+	struct xkb_keymap *keymap;
+};
+
+/** Creates the shared XKB context and compiles the configured keymap */
+bool comp_input_keymap_cache_init(void);
+void comp_input_keymap_cache_finish(void);
+
+/**
+ * Returns the keymap matching the rule names, only compiling it on the first
+ * request. The keymap is owned by the cache.
+ */
+struct xkb_keymap *comp_input_get_keymap(const struct xkb_rule_names *names);
+/** Returns the keymap of the INPUT_KB_XKB_* rule names */
+struct xkb_keymap *comp_input_get_configured_keymap(void);
 
 void comp_input_configure_device(struct wlr_input_device *device);
 
@@ -0,0 +1,55 @@
+#ifndef FX_SEAT_KEYBINDINGS_H
+#define FX_SEAT_KEYBINDINGS_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include "comp/server.h"
+
+typedef void (*comp_keybinding_action_func_t)(struct comp_server *server,
+											  const char *arg);
+
+struct comp_keybinding {
+	// Combined modifier mask and keysym, used as the table key
+	gint64 key;
+	uint32_t modifiers;
+	xkb_keysym_t keysym;
+
+	// Run the action when the key is released instead of pressed
+	bool release;
+	// Also send the key to the focused client
+	bool passthrough;
+
+	comp_keybinding_action_func_t action;
+	char *arg;
+};
+
+struct comp_keybindings {
+	// comp_keybinding by modifier mask and keysym
+	GHashTable *table;
+};
+
+/**
+ * Loads the built-in bindings, followed by the ones in
+ * $XDG_CONFIG_HOME/fx-comp/keybindings
+ */
+struct comp_keybindings *comp_keybindings_create(void);
+void comp_keybindings_destroy(struct comp_keybindings *keybindings);
+
+/** Reloads all bindings. Keeps the current bindings on failure. */
+bool comp_keybindings_reload(struct comp_keybindings *keybindings);
+
+/** Runs the action like a binding would, returns false if it's unknown */
+bool comp_keybindings_run_action(const char *name, const char *arg);
+
+/**
+ * Single lookup for the keysym. Caps Lock and Num Lock are ignored. Shift has
+ * to be removed by the caller if it has already been applied to the keysym.
+ */
+struct comp_keybinding *
+comp_keybindings_lookup(struct comp_keybindings *keybindings,
+						uint32_t modifiers, xkb_keysym_t keysym);
+
+#endif // !FX_SEAT_KEYBINDINGS_H
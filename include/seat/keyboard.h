@@ -6,6 +6,7 @@
 #include <wayland-util.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_input_device.h>
+#include <xkbcommon/xkbcommon.h>
 
 struct comp_keyboard {
 	struct wl_list link;
@@ -13,6 +14,14 @@ struct comp_keyboard {
 	struct comp_seat *seat;
 	struct wlr_keyboard *wlr_keyboard;
 
+	// The pressed key of a release binding
+	struct {
+		bool active;
+		uint32_t keycode;
+		uint32_t modifiers;
+		xkb_keysym_t keysym;
+	} release_binding;
+
 	struct wl_listener modifiers;
 	struct wl_listener key;
 	struct wl_listener destroy;
@@ -0,0 +1,126 @@
+#ifndef FX_SEAT_LATENCY_H
+#define FX_SEAT_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_pointer.h>
+
+#include "constants.h"
+
+enum comp_latency_input_type {
+	COMP_LATENCY_INPUT_KEY,
+	COMP_LATENCY_INPUT_POINTER,
+	COMP_LATENCY_INPUT_COUNT,
+};
+
+enum comp_latency_stage {
+	// Input device event -> sent to the client
+	COMP_LATENCY_STAGE_DELIVER,
+	// Sent to the client -> next surface commit
+	COMP_LATENCY_STAGE_COMMIT,
+	// Surface commit -> presented by the output
+	COMP_LATENCY_STAGE_PRESENT,
+	COMP_LATENCY_STAGE_COUNT,
+};
+
+struct comp_latency_histogram {
+	// Power of two millisecond buckets: <1ms, <2ms, <4ms, ...
+	uint64_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+	uint64_t count;
+	double min_ms, max_ms;
+	double total_ms;
+	double stage_total_ms[COMP_LATENCY_STAGE_COUNT];
+};
+
+enum comp_latency_sample_state {
+	COMP_LATENCY_SAMPLE_NONE,
+	// Sent to the client, waiting for a commit
+	COMP_LATENCY_SAMPLE_DELIVERED,
+	// Committed, waiting for an output to render it
+	COMP_LATENCY_SAMPLE_COMMITTED,
+	// Rendered, waiting for the output to present it
+	COMP_LATENCY_SAMPLE_RENDERED,
+};
+
+struct comp_latency_sample {
+	enum comp_latency_sample_state state;
+	enum comp_latency_input_type type;
+	struct timespec arrival;
+	struct timespec delivered;
+	struct timespec committed;
+	struct wlr_output *output;
+};
+
+struct comp_latency_client {
+	struct wl_list link;
+	// NULL after the client has disconnected, the results are kept
+	struct wl_client *client;
+	pid_t pid;
+	char name[32];
+
+	// The oldest input which hasn't been committed yet
+	struct comp_latency_sample pending;
+	// Committed input waiting for presentation
+	struct comp_latency_sample inflight;
+
+	struct comp_latency_histogram histograms[COMP_LATENCY_INPUT_COUNT];
+
+	// The last surface which received input
+	struct wlr_surface *surface;
+	struct wl_listener surface_commit;
+	struct wl_listener surface_destroy;
+	struct wl_listener client_destroy;
+};
+
+struct comp_latency {
+	struct wl_list clients; // comp_latency_client
+
+	// Synthetic input used by the benchmark mode
+	struct {
+		bool enabled;
+		struct wlr_keyboard keyboard;
+		struct wlr_pointer pointer;
+		struct wl_event_source *timer;
+		int remaining;
+		bool key_pressed;
+		int direction;
+	} bench;
+};
+
+struct comp_latency *comp_latency_create(void);
+void comp_latency_destroy(struct comp_latency *latency);
+
+/** Stamps the arrival time of an input event */
+void comp_latency_stamp(struct timespec *arrival);
+
+/**
+ * Starts tracking the input event that was just sent to the client of the
+ * surface. No-op if the latency tracing isn't enabled.
+ */
+void comp_latency_input_delivered(enum comp_latency_input_type type,
+								  const struct timespec *arrival,
+								  struct wlr_surface *surface);
+
+/** Marks the committed client content as rendered by the output */
+void comp_latency_output_rendered(struct wlr_output *output);
+
+void comp_latency_output_presented(struct wlr_output *output,
+								   const struct timespec *when);
+
+/** Prints the per-client latency histograms */
+void comp_latency_report(struct comp_latency *latency);
+
+/**
+ * Injects synthetic key presses and pointer motion through virtual input
+ * devices, then exits the compositor.
+ */
+bool comp_latency_bench_start(struct comp_latency *latency);
+
+#endif // !FX_SEAT_LATENCY_H
@@ -5,6 +5,7 @@
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_input_device.h>
 
 #include "desktop/layer_shell.h"
 #include "desktop/toplevel.h"
@@ -59,10 +60,18 @@ struct comp_seat {
 	double grab_x, grab_y;
 	struct wlr_box grab_geobox;
 	uint32_t resize_edges;
+	// Cursor position at the last tiled resize step
+	double resize_cursor_x, resize_cursor_y;
+	// Where the dragged tiled toplevel would be tiled
+	struct wlr_scene_rect *tiling_preview;
 };
 
 struct comp_seat *comp_seat_create(struct comp_server *server);
 
+/** Also used for the compositor's own virtual input devices */
+void comp_seat_add_input_device(struct comp_seat *seat,
+								struct wlr_input_device *device);
+
 bool comp_seat_object_is_focus(struct comp_seat *seat,
 							   struct comp_object *object);
 
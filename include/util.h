@@ -2,7 +2,7 @@
 #define FX_COMP_UTILR_H
 
 #include <cairo.h>
-#include <gtk-3.0/gtk/gtk.h>
+#include <glib.h>
 #include <scenefx/types/wlr_scene.h>
 #include <wlr/util/box.h>
 
@@ -12,8 +12,6 @@
 
 int wrap(int i, int max);
 
-void exec(char *cmd);
-
 /* Wayland Helpers */
 
 void listener_init(struct wl_listener *listener);
@@ -53,8 +51,6 @@ double hex_blue(const uint32_t *const col);
 /** Get alpha component from HEX color */
 double hex_alpha(const uint32_t *const col);
 
-/** Get `GdkRGBA` from HEX color */
-GdkRGBA gdk_rgba_from_color(const uint32_t *const c);
 /** Get `struct wlr_render_color` from HEX color */
 struct wlr_render_color wlr_render_color_from_color(const uint32_t *const c);
 
@@ -8,6 +8,7 @@
 #include "comp/animation_mgr.h"
 #include "comp/output.h"
 #include "comp/server.h"
+#include "comp/trace.h"
 
 #define MIN_DURATION 100
 
@@ -21,7 +22,8 @@ struct comp_animation_client *
 comp_animation_client_init(struct comp_animation_mgr *mgr, int duration_ms,
 						   const struct comp_animation_client_impl *impl,
 						   void *data) {
-	struct comp_animation_client *client = calloc(1, sizeof(*client));
+	struct comp_animation_client *client =
+		comp_slab_alloc(&server.slabs.animation_clients);
 	if (!client) {
 		wlr_log(WLR_ERROR, "Failed to allocate comp_animation_mgr");
 		return NULL;
@@ -65,7 +67,7 @@ void comp_animation_client_cancel(struct comp_animation_mgr *mgr,
 
 void comp_animation_client_destroy(struct comp_animation_client *client) {
 	comp_animation_client_remove(client);
-	free(client);
+	comp_slab_free(&server.slabs.animation_clients, client);
 }
 
 void comp_animation_client_add(struct comp_animation_mgr *mgr,
@@ -121,6 +123,7 @@ static float get_fastest_output_refresh_s(void) {
 }
 
 static int animation_timer(void *data) {
+	const uint64_t trace_start = comp_trace_begin();
 	struct comp_animation_mgr *mgr = data;
 	const float fastest_output_refresh_s =
 		get_fastest_output_refresh_s() * 1000;
@@ -143,6 +146,7 @@ static int animation_timer(void *data) {
 		wl_event_source_timer_update(mgr->tick, fastest_output_refresh_s);
 	}
 
+	comp_trace_end("animation_timer", trace_start);
 	return 0;
 }
 
@@ -0,0 +1,576 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wayland-util.h>
+#include <wlr/util/log.h>
+
+#include "comp/icon_loader.h"
+#include "comp/server.h"
+#include "constants.h"
+
+static const char *icon_extensions[] = {".svg", ".png"};
+
+/*
+ * Themes
+ */
+
+static char *get_configured_theme_name(void) {
+	// GSettings aborts on missing schemas, so look it up first
+	GSettingsSchemaSource *source = g_settings_schema_source_get_default();
+	if (!source) {
+		return NULL;
+	}
+	GSettingsSchema *schema = g_settings_schema_source_lookup(
+		source, "org.gnome.desktop.interface", TRUE);
+	if (!schema) {
+		return NULL;
+	}
+
+	char *name = NULL;
+	if (g_settings_schema_has_key(schema, "icon-theme")) {
+		GSettings *settings = g_settings_new_full(schema, NULL, NULL);
+		name = g_settings_get_string(settings, "icon-theme");
+		g_object_unref(settings);
+	}
+	g_settings_schema_unref(schema);
+	return name;
+}
+
+static char **get_search_paths(void) {
+	GPtrArray *paths = g_ptr_array_new();
+	g_ptr_array_add(paths, g_build_filename(g_get_home_dir(), ".icons", NULL));
+	g_ptr_array_add(paths,
+					g_build_filename(g_get_user_data_dir(), "icons", NULL));
+	const char *const *data_dirs = g_get_system_data_dirs();
+	for (size_t i = 0; data_dirs[i]; i++) {
+		g_ptr_array_add(paths, g_build_filename(data_dirs[i], "icons", NULL));
+	}
+	g_ptr_array_add(paths, g_strdup("/usr/share/pixmaps"));
+	g_ptr_array_add(paths, NULL);
+	return (char **)g_ptr_array_free(paths, FALSE);
+}
+
+static int key_file_get_int(GKeyFile *file, const char *group, const char *key,
+							int fallback) {
+	GError *error = NULL;
+	int value = g_key_file_get_integer(file, group, key, &error);
+	if (error) {
+		g_error_free(error);
+		return fallback;
+	}
+	return value;
+}
+
+static void parse_dir(GKeyFile *index, const char *name,
+					  struct comp_icon_dir *dir) {
+	dir->name = g_strdup(name);
+	dir->size = key_file_get_int(index, name, "Size", 0);
+	dir->scale = key_file_get_int(index, name, "Scale", 1);
+	dir->min_size = key_file_get_int(index, name, "MinSize", dir->size);
+	dir->max_size = key_file_get_int(index, name, "MaxSize", dir->size);
+	dir->threshold = key_file_get_int(index, name, "Threshold", 2);
+
+	char *type = g_key_file_get_string(index, name, "Type", NULL);
+	if (type && strcmp(type, "Fixed") == 0) {
+		dir->type = COMP_ICON_DIR_FIXED;
+	} else if (type && strcmp(type, "Scalable") == 0) {
+		dir->type = COMP_ICON_DIR_SCALABLE;
+	} else {
+		dir->type = COMP_ICON_DIR_THRESHOLD;
+	}
+	g_free(type);
+}
+
+static void theme_destroy(struct comp_icon_theme *theme) {
+	wl_list_remove(&theme->link);
+	for (size_t i = 0; i < theme->num_dirs; i++) {
+		g_free(theme->dirs[i].name);
+	}
+	free(theme->dirs);
+	g_strfreev(theme->base_dirs);
+	g_free(theme->name);
+	free(theme);
+}
+
+static bool is_theme_loaded(struct comp_icon_loader *loader,
+							const char *name) {
+	struct comp_icon_theme *theme;
+	wl_list_for_each(theme, &loader->themes, link) {
+		if (strcmp(theme->name, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Appends the theme and then its parents, except for hicolor */
+static void load_theme(struct comp_icon_loader *loader, const char *name) {
+	if (is_theme_loaded(loader, name)) {
+		return;
+	}
+
+	// The theme can be split over multiple base directories, but only the
+	// first index.theme counts
+	GKeyFile *index = NULL;
+	GPtrArray *base_dirs = g_ptr_array_new();
+	for (size_t i = 0; loader->search_paths[i]; i++) {
+		char *path = g_build_filename(loader->search_paths[i], name, NULL);
+		if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
+			g_free(path);
+			continue;
+		}
+		g_ptr_array_add(base_dirs, path);
+
+		if (!index) {
+			char *index_path = g_build_filename(path, "index.theme", NULL);
+			index = g_key_file_new();
+			if (!g_key_file_load_from_file(index, index_path, G_KEY_FILE_NONE,
+										   NULL)) {
+				g_key_file_free(index);
+				index = NULL;
+			}
+			g_free(index_path);
+		}
+	}
+	g_ptr_array_add(base_dirs, NULL);
+	char **base_dirs_strv = (char **)g_ptr_array_free(base_dirs, FALSE);
+	if (!index) {
+		wlr_log(WLR_DEBUG, "Could not find icon theme %s", name);
+		g_strfreev(base_dirs_strv);
+		return;
+	}
+
+	struct comp_icon_theme *theme = calloc(1, sizeof(*theme));
+	if (!theme) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_icon_theme");
+		g_strfreev(base_dirs_strv);
+		g_key_file_free(index);
+		return;
+	}
+	theme->name = g_strdup(name);
+	theme->base_dirs = base_dirs_strv;
+	wl_list_insert(loader->themes.prev, &theme->link);
+
+	char **dirs = g_key_file_get_string_list(index, "Icon Theme",
+											 "Directories", NULL, NULL);
+	const size_t num_dirs = dirs ? g_strv_length(dirs) : 0;
+	if (num_dirs > 0) {
+		theme->dirs = calloc(num_dirs, sizeof(*theme->dirs));
+		if (!theme->dirs) {
+			wlr_log(WLR_ERROR, "Could not allocate icon theme directories");
+		}
+	}
+	for (size_t i = 0; theme->dirs && i < num_dirs; i++) {
+		if (g_key_file_has_group(index, dirs[i])) {
+			parse_dir(index, dirs[i], &theme->dirs[theme->num_dirs++]);
+		}
+	}
+	g_strfreev(dirs);
+
+	char **inherits =
+		g_key_file_get_string_list(index, "Icon Theme", "Inherits", NULL, NULL);
+	g_key_file_free(index);
+	for (size_t i = 0; inherits && inherits[i]; i++) {
+		// Always searched last
+		if (strcmp(inherits[i], "hicolor") != 0) {
+			load_theme(loader, inherits[i]);
+		}
+	}
+	g_strfreev(inherits);
+}
+
+static void load_themes(struct comp_icon_loader *loader) {
+	loader->themes_loaded = true;
+	loader->search_paths = get_search_paths();
+
+	char *name = get_configured_theme_name();
+	if (name && *name) {
+		load_theme(loader, name);
+	}
+	g_free(name);
+	load_theme(loader, ICON_THEME_FALLBACK);
+	load_theme(loader, "hicolor");
+
+	wlr_log(WLR_DEBUG, "Loaded %d icon themes",
+			wl_list_length(&loader->themes));
+}
+
+/*
+ * Lookup
+ */
+
+static bool dir_matches_size(const struct comp_icon_dir *dir, int size,
+							 int scale) {
+	if (dir->scale != scale) {
+		return false;
+	}
+	switch (dir->type) {
+	case COMP_ICON_DIR_FIXED:
+		return dir->size == size;
+	case COMP_ICON_DIR_SCALABLE:
+		return dir->min_size <= size && size <= dir->max_size;
+	case COMP_ICON_DIR_THRESHOLD:
+		return dir->size - dir->threshold <= size &&
+			   size <= dir->size + dir->threshold;
+	}
+	return false;
+}
+
+static int dir_size_distance(const struct comp_icon_dir *dir, int size,
+							 int scale) {
+	const int pixel_size = size * scale;
+	switch (dir->type) {
+	case COMP_ICON_DIR_FIXED:
+		return abs(dir->size * dir->scale - pixel_size);
+	case COMP_ICON_DIR_SCALABLE:
+		if (pixel_size < dir->min_size * dir->scale) {
+			return dir->min_size * dir->scale - pixel_size;
+		}
+		if (pixel_size > dir->max_size * dir->scale) {
+			return pixel_size - dir->max_size * dir->scale;
+		}
+		return 0;
+	case COMP_ICON_DIR_THRESHOLD:
+		if (pixel_size < (dir->size - dir->threshold) * dir->scale) {
+			return dir->min_size * dir->scale - pixel_size;
+		}
+		if (pixel_size > (dir->size + dir->threshold) * dir->scale) {
+			return pixel_size - dir->max_size * dir->scale;
+		}
+		return 0;
+	}
+	return INT_MAX;
+}
+
+static char *find_icon_file(const char *dir, const char *name) {
+	for (size_t i = 0; i < sizeof(icon_extensions) / sizeof(*icon_extensions);
+		 i++) {
+		char *file = g_strconcat(name, icon_extensions[i], NULL);
+		char *path = g_build_filename(dir, file, NULL);
+		g_free(file);
+		if (g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+			return path;
+		}
+		g_free(path);
+	}
+	return NULL;
+}
+
+static char *theme_find_icon_in_dir(const struct comp_icon_theme *theme,
+									const struct comp_icon_dir *dir,
+									const char *name) {
+	for (size_t i = 0; theme->base_dirs[i]; i++) {
+		char *dir_path = g_build_filename(theme->base_dirs[i], dir->name, NULL);
+		char *path = find_icon_file(dir_path, name);
+		g_free(dir_path);
+		if (path) {
+			return path;
+		}
+	}
+	return NULL;
+}
+
+/** Follows the freedesktop icon theme specification */
+static char *theme_lookup_icon(const struct comp_icon_theme *theme,
+							   const char *name, int size, int scale) {
+	char *closest = NULL;
+	int min_distance = INT_MAX;
+	for (size_t i = 0; i < theme->num_dirs; i++) {
+		const struct comp_icon_dir *dir = &theme->dirs[i];
+		const bool matches = dir_matches_size(dir, size, scale);
+		const int distance = matches ? 0 : dir_size_distance(dir, size, scale);
+		// Exact matches always win over the closest size
+		if (!matches && distance >= min_distance) {
+			continue;
+		}
+
+		char *path = theme_find_icon_in_dir(theme, dir, name);
+		if (!path) {
+			continue;
+		}
+		g_free(closest);
+		if (matches) {
+			return path;
+		}
+		closest = path;
+		min_distance = distance;
+	}
+	return closest;
+}
+
+static char *lookup_icon(struct comp_icon_loader *loader, const char *name,
+						 int size, int scale) {
+	struct comp_icon_theme *theme;
+	wl_list_for_each(theme, &loader->themes, link) {
+		char *path = theme_lookup_icon(theme, name, size, scale);
+		if (path) {
+			return path;
+		}
+	}
+
+	// Unthemed icons
+	for (size_t i = 0; loader->search_paths[i]; i++) {
+		char *path = find_icon_file(loader->search_paths[i], name);
+		if (path) {
+			return path;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Rasterizing
+ */
+
+/**
+ * Converts the RGBA pixbuf into a premultiplied cairo surface. Symbolic icons
+ * only use their alpha channel, so recoloring them just replaces the color
+ * channels.
+ */
+static cairo_surface_t *surface_from_pixbuf(GdkPixbuf *pixbuf, bool recolor,
+											uint32_t color) {
+	if (gdk_pixbuf_get_colorspace(pixbuf) != GDK_COLORSPACE_RGB ||
+		gdk_pixbuf_get_bits_per_sample(pixbuf) != 8) {
+		return NULL;
+	}
+
+	const int width = gdk_pixbuf_get_width(pixbuf);
+	const int height = gdk_pixbuf_get_height(pixbuf);
+	const int channels = gdk_pixbuf_get_n_channels(pixbuf);
+	const int src_stride = gdk_pixbuf_get_rowstride(pixbuf);
+	const bool has_alpha = gdk_pixbuf_get_has_alpha(pixbuf);
+	const guint8 *src_data = gdk_pixbuf_read_pixels(pixbuf);
+
+	cairo_surface_t *surface =
+		cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+	cairo_surface_flush(surface);
+	uint8_t *dst_data = cairo_image_surface_get_data(surface);
+	const int dst_stride = cairo_image_surface_get_stride(surface);
+
+	const uint32_t color_r = (color >> 24) & 0xFF;
+	const uint32_t color_g = (color >> 16) & 0xFF;
+	const uint32_t color_b = (color >> 8) & 0xFF;
+	const uint32_t color_a = color & 0xFF;
+
+	for (int y = 0; y < height; y++) {
+		const guint8 *src = src_data + y * src_stride;
+		uint32_t *dst = (uint32_t *)(dst_data + y * dst_stride);
+		for (int x = 0; x < width; x++, src += channels) {
+			uint32_t a = has_alpha ? src[3] : 0xFF;
+			uint32_t r = src[0];
+			uint32_t g = src[1];
+			uint32_t b = src[2];
+			if (recolor) {
+				a = a * color_a / 0xFF;
+				r = color_r;
+				g = color_g;
+				b = color_b;
+			}
+			dst[x] = a << 24 | (r * a / 0xFF) << 16 | (g * a / 0xFF) << 8 |
+					 (b * a / 0xFF);
+		}
+	}
+	cairo_surface_mark_dirty(surface);
+	return surface;
+}
+
+static cairo_surface_t *rasterize_icon(const char *path, int pixel_size,
+									   bool recolor, uint32_t color) {
+	GError *error = NULL;
+	GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file_at_size(path, pixel_size,
+														 pixel_size, &error);
+	if (!pixbuf) {
+		wlr_log(WLR_ERROR, "Could not load icon %s: %s", path, error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	cairo_surface_t *surface = surface_from_pixbuf(pixbuf, recolor, color);
+	g_object_unref(pixbuf);
+	return surface;
+}
+
+/*
+ * Disk cache
+ */
+
+static char *get_cache_path(struct comp_icon_loader *loader, const char *name,
+							const char *source_path, int pixel_size,
+							uint32_t color) {
+	struct stat st;
+	if (!loader->cache_dir || stat(source_path, &st) != 0) {
+		return NULL;
+	}
+
+	// Changes with the icon theme and with updates of the icon itself
+	char *source_key =
+		g_strdup_printf("%s:%lld", source_path, (long long)st.st_mtime);
+	char *file = g_strdup_printf("%s-%d-%08x-%08x.png", name, pixel_size,
+								 color, g_str_hash(source_key));
+	char *path = g_build_filename(loader->cache_dir, file, NULL);
+	g_free(file);
+	g_free(source_key);
+	return path;
+}
+
+static cairo_surface_t *cache_read(const char *path) {
+	if (!g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+		return NULL;
+	}
+	cairo_surface_t *surface = cairo_image_surface_create_from_png(path);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		wlr_log(WLR_DEBUG, "Ignoring invalid cached icon %s", path);
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+	return surface;
+}
+
+static void cache_write(struct comp_icon_loader *loader, const char *path,
+						cairo_surface_t *surface) {
+	if (g_mkdir_with_parents(loader->cache_dir, 0700) != 0) {
+		wlr_log(WLR_ERROR, "Could not create icon cache directory %s",
+				loader->cache_dir);
+		return;
+	}
+
+	// Renamed into place so that other instances never read partial files
+	char *tmp_path = g_strdup_printf("%s.%d", path, getpid());
+	if (cairo_surface_write_to_png(surface, tmp_path) !=
+			CAIRO_STATUS_SUCCESS ||
+		rename(tmp_path, path) != 0) {
+		wlr_log(WLR_ERROR, "Could not cache icon %s", path);
+		unlink(tmp_path);
+	}
+	g_free(tmp_path);
+}
+
+/*
+ * Loader
+ */
+
+static void cache_entry_destroy(struct comp_icon_cache_entry *entry) {
+	wl_list_remove(&entry->link);
+	cairo_surface_destroy(entry->surface);
+	free(entry->name);
+	free(entry);
+}
+
+static cairo_surface_t *load_icon(struct comp_icon_loader *loader,
+								  const char *name, int size, double scale,
+								  bool symbolic, uint32_t color) {
+	if (!loader->themes_loaded) {
+		load_themes(loader);
+	}
+
+	char *path = lookup_icon(loader, name, size, MAX(ceil(scale), 1));
+	if (!path) {
+		wlr_log(WLR_ERROR, "Could not find icon %s", name);
+		return NULL;
+	}
+
+	const int pixel_size = ceil(size * scale);
+	char *cache_path = get_cache_path(loader, name, path, pixel_size, color);
+	cairo_surface_t *surface = cache_path ? cache_read(cache_path) : NULL;
+	if (!surface) {
+		surface = rasterize_icon(path, pixel_size, symbolic, color);
+		if (surface && cache_path) {
+			cache_write(loader, cache_path, surface);
+		}
+	}
+	g_free(cache_path);
+	g_free(path);
+
+	if (surface) {
+		cairo_surface_set_device_scale(surface, scale, scale);
+	}
+	return surface;
+}
+
+void comp_icon_loader_init(void) {
+	struct comp_icon_loader *loader = &server.icon_loader;
+	wl_list_init(&loader->themes);
+	wl_list_init(&loader->entries);
+	loader->themes_loaded = false;
+	loader->search_paths = NULL;
+	loader->cache_dir =
+		g_build_filename(g_get_user_cache_dir(), ICON_CACHE_DIR, NULL);
+}
+
+void comp_icon_loader_finish(void) {
+	struct comp_icon_loader *loader = &server.icon_loader;
+
+	comp_icon_loader_release();
+	g_free(loader->cache_dir);
+	loader->cache_dir = NULL;
+}
+
+void comp_icon_loader_release(void) {
+	struct comp_icon_loader *loader = &server.icon_loader;
+
+	struct comp_icon_cache_entry *entry, *entry_tmp;
+	wl_list_for_each_safe(entry, entry_tmp, &loader->entries, link) {
+		cache_entry_destroy(entry);
+	}
+
+	struct comp_icon_theme *theme, *theme_tmp;
+	wl_list_for_each_safe(theme, theme_tmp, &loader->themes, link) {
+		theme_destroy(theme);
+	}
+
+	g_strfreev(loader->search_paths);
+	loader->search_paths = NULL;
+	loader->themes_loaded = false;
+}
+
+cairo_surface_t *comp_icon_loader_get(const char *name, int size,
+									  double scale, uint32_t color) {
+	struct comp_icon_loader *loader = &server.icon_loader;
+	const bool symbolic = g_str_has_suffix(name, "-symbolic");
+	if (!symbolic) {
+		// Doesn't affect the icon
+		color = 0;
+	}
+
+	struct comp_icon_cache_entry *entry;
+	wl_list_for_each(entry, &loader->entries, link) {
+		if (entry->size == size && entry->scale == scale &&
+			entry->color == color && strcmp(entry->name, name) == 0) {
+			return entry->surface;
+		}
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_icon_cache_entry");
+		return NULL;
+	}
+	entry->name = strdup(name);
+	if (!entry->name) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_icon_cache_entry");
+		free(entry);
+		return NULL;
+	}
+	entry->size = size;
+	entry->scale = scale;
+	entry->color = color;
+	// Also caches missing icons, so that they're only looked up once
+	entry->surface = load_icon(loader, name, size, scale, symbolic, color);
+	wl_list_insert(&loader->entries, &entry->link);
+	return entry->surface;
+}
@@ -0,0 +1,408 @@
+#include <scenefx/types/wlr_scene.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_subcompositor.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+
+#include "comp/input_index.h"
+#include "comp/output.h"
+#include "comp/server.h"
+#include "constants.h"
+#include "util.h"
+
+/*
+ * Grid
+ */
+
+void comp_input_grid_finish(struct comp_input_grid *grid) {
+	if (grid->cells) {
+		for (int i = 0; i < grid->cols * grid->rows; i++) {
+			wl_array_release(&grid->cells[i]);
+		}
+		free(grid->cells);
+	}
+	*grid = (struct comp_input_grid){0};
+}
+
+static bool grid_reset(struct comp_input_grid *grid, struct wlr_box *box) {
+	int cols = (box->width + INPUT_INDEX_CELL_SIZE - 1) / INPUT_INDEX_CELL_SIZE;
+	int rows =
+		(box->height + INPUT_INDEX_CELL_SIZE - 1) / INPUT_INDEX_CELL_SIZE;
+
+	if (grid->cells && grid->cols == cols && grid->rows == rows) {
+		// Keep the allocations around
+		for (int i = 0; i < cols * rows; i++) {
+			grid->cells[i].size = 0;
+		}
+		grid->box = *box;
+		return true;
+	}
+
+	comp_input_grid_finish(grid);
+	if (cols <= 0 || rows <= 0) {
+		return true;
+	}
+
+	grid->cells = calloc(cols * rows, sizeof(*grid->cells));
+	if (!grid->cells) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_input_grid cells");
+		return false;
+	}
+	for (int i = 0; i < cols * rows; i++) {
+		wl_array_init(&grid->cells[i]);
+	}
+	grid->cols = cols;
+	grid->rows = rows;
+	grid->box = *box;
+	return true;
+}
+
+static bool grid_insert(struct comp_input_grid *grid, struct wlr_box *box,
+						uint32_t entry_index) {
+	struct wlr_box intersection;
+	if (!grid->cells ||
+		!wlr_box_intersection(&intersection, &grid->box, box)) {
+		return true;
+	}
+
+	int x1 = (intersection.x - grid->box.x) / INPUT_INDEX_CELL_SIZE;
+	int y1 = (intersection.y - grid->box.y) / INPUT_INDEX_CELL_SIZE;
+	int x2 = (intersection.x + intersection.width - 1 - grid->box.x) /
+			 INPUT_INDEX_CELL_SIZE;
+	int y2 = (intersection.y + intersection.height - 1 - grid->box.y) /
+			 INPUT_INDEX_CELL_SIZE;
+	for (int y = y1; y <= y2; y++) {
+		for (int x = x1; x <= x2; x++) {
+			uint32_t *cell_entry =
+				wl_array_add(&grid->cells[y * grid->cols + x], sizeof(uint32_t));
+			if (!cell_entry) {
+				wlr_log(WLR_ERROR, "Could not allocate comp_input_grid entry");
+				return false;
+			}
+			*cell_entry = entry_index;
+		}
+	}
+	return true;
+}
+
+/*
+ * Surfaces
+ */
+
+/** The parts of a surface's state which change the input boxes */
+struct input_surface {
+	struct wlr_surface *surface;
+
+	bool mapped;
+	bool has_buffer;
+	int width;
+	int height;
+	// Hash of the subsurfaces and their positions
+	uint64_t subsurfaces;
+
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+static uint64_t hash_subsurfaces(struct wlr_surface *surface) {
+	uint64_t hash = 0;
+	struct wl_list *lists[] = {
+		&surface->current.subsurfaces_below,
+		&surface->current.subsurfaces_above,
+	};
+	for (size_t i = 0; i < sizeof(lists) / sizeof(*lists); i++) {
+		struct wlr_subsurface *subsurface;
+		wl_list_for_each(subsurface, lists[i], current.link) {
+			hash = hash * 31 + (uintptr_t)subsurface;
+			hash = hash * 31 + (uint32_t)subsurface->current.x;
+			hash = hash * 31 + (uint32_t)subsurface->current.y;
+		}
+		hash = hash * 31 + i;
+	}
+	return hash;
+}
+
+static void input_surface_handle_commit(struct wl_listener *listener,
+										void *data) {
+	struct input_surface *input_surface =
+		wl_container_of(listener, input_surface, commit);
+	struct wlr_surface *surface = input_surface->surface;
+
+	const bool has_buffer = surface->buffer != NULL;
+	const uint64_t subsurfaces = hash_subsurfaces(surface);
+	if (input_surface->mapped == surface->mapped &&
+		input_surface->has_buffer == has_buffer &&
+		input_surface->width == surface->current.width &&
+		input_surface->height == surface->current.height &&
+		input_surface->subsurfaces == subsurfaces) {
+		return;
+	}
+	input_surface->mapped = surface->mapped;
+	input_surface->has_buffer = has_buffer;
+	input_surface->width = surface->current.width;
+	input_surface->height = surface->current.height;
+	input_surface->subsurfaces = subsurfaces;
+
+	comp_input_index_invalidate(&server.input_index);
+}
+
+static void input_surface_handle_destroy(struct wl_listener *listener,
+										 void *data) {
+	struct input_surface *input_surface =
+		wl_container_of(listener, input_surface, destroy);
+	listener_remove(&input_surface->commit);
+	listener_remove(&input_surface->destroy);
+	free(input_surface);
+}
+
+static void index_handle_new_surface(struct wl_listener *listener,
+									 void *data) {
+	struct wlr_surface *surface = data;
+	struct input_surface *input_surface = calloc(1, sizeof(*input_surface));
+	if (!input_surface) {
+		wlr_log(WLR_ERROR, "Could not allocate input_surface");
+		return;
+	}
+	input_surface->surface = surface;
+	listener_connect_init(&surface->events.commit, &input_surface->commit,
+						  input_surface_handle_commit);
+	listener_connect_init(&surface->events.destroy, &input_surface->destroy,
+						  input_surface_handle_destroy);
+}
+
+void comp_input_index_track_surfaces(struct comp_input_index *index,
+									 struct wlr_compositor *compositor) {
+	listener_connect_init(&compositor->events.new_surface, &index->new_surface,
+						  index_handle_new_surface);
+}
+
+/*
+ * Index
+ */
+
+static void entry_handle_destroy(struct wl_listener *listener, void *data) {
+	// The entries reference the node directly, so drop everything
+	comp_input_index_invalidate(&server.input_index);
+}
+
+static bool node_get_size(struct wlr_scene_node *node, int *width,
+						  int *height) {
+	switch (node->type) {
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+		*width = rect->width;
+		*height = rect->height;
+		return true;
+	case WLR_SCENE_NODE_BUFFER:;
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		if (buffer->dst_width > 0 && buffer->dst_height > 0) {
+			*width = buffer->dst_width;
+			*height = buffer->dst_height;
+		} else if (buffer->buffer) {
+			*width = buffer->buffer->width;
+			*height = buffer->buffer->height;
+			wlr_output_transform_coords(buffer->transform, width, height);
+		} else {
+			return false;
+		}
+		return true;
+	default:
+		// Trees are walked, and shadows/blur never accept input
+		return false;
+	}
+}
+
+static bool index_node(struct comp_input_index *index,
+					   struct wlr_scene_node *node, int lx, int ly) {
+	if (!node->enabled) {
+		return true;
+	}
+
+	lx += node->x;
+	ly += node->y;
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			if (!index_node(index, child, lx, ly)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int width, height;
+	if (!node_get_size(node, &width, &height) || width <= 0 || height <= 0) {
+		return true;
+	}
+
+	struct comp_input_index_entry *entry =
+		wl_array_add(&index->entries, sizeof(*entry));
+	if (!entry) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_input_index_entry");
+		return false;
+	}
+	*entry = (struct comp_input_index_entry){
+		.node = node,
+		.box = {.x = lx, .y = ly, .width = width, .height = height},
+	};
+	return true;
+}
+
+/** Disabling a parent tree doesn't invalidate the index */
+static bool node_is_visible(struct wlr_scene_node *node) {
+	for (; node; node = node->parent ? &node->parent->node : NULL) {
+		if (!node->enabled) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool index_rebuild(struct comp_input_index *index) {
+	index->entries.size = 0;
+	index->last_hit.node = NULL;
+
+	if (!index_node(index, &server.root_scene->tree.node, 0, 0)) {
+		index->entries.size = 0;
+		return false;
+	}
+
+	struct comp_output *output;
+	wl_list_for_each(output, &server.outputs, link) {
+		struct wlr_box box = output->geometry;
+		if (!output->wlr_output->enabled || output == server.fallback_output) {
+			box = (struct wlr_box){0};
+		}
+		if (!grid_reset(&output->input_grid, &box)) {
+			index->entries.size = 0;
+			return false;
+		}
+	}
+
+	uint32_t i = 0;
+	struct comp_input_index_entry *entry;
+	wl_array_for_each(entry, &index->entries) {
+		wl_list_for_each(output, &server.outputs, link) {
+			if (!grid_insert(&output->input_grid, &entry->box, i)) {
+				index->entries.size = 0;
+				return false;
+			}
+		}
+		i++;
+	}
+
+	// The array doesn't grow anymore, safe to connect the listeners
+	wl_array_for_each(entry, &index->entries) {
+		listener_connect_init(&entry->node->events.destroy, &entry->destroy,
+							  entry_handle_destroy);
+	}
+
+	index->valid = true;
+	return true;
+}
+
+void comp_input_index_invalidate(struct comp_input_index *index) {
+	if (!index->valid) {
+		return;
+	}
+	index->valid = false;
+	index->last_hit.node = NULL;
+
+	struct comp_input_index_entry *entry;
+	wl_array_for_each(entry, &index->entries) {
+		listener_remove(&entry->destroy);
+	}
+	index->entries.size = 0;
+}
+
+struct wlr_scene_node *comp_input_index_node_at(struct comp_input_index *index,
+												double lx, double ly,
+												double *sx, double *sy) {
+	if (!index->valid && !index_rebuild(index)) {
+		goto fallback;
+	}
+
+	// Skip the lookup while moving within the same unobstructed area
+	if (index->last_hit.node &&
+		wlr_box_contains_point(&index->last_hit.clip, lx, ly) &&
+		node_is_visible(index->last_hit.node)) {
+		struct wlr_scene_node *node =
+			wlr_scene_node_at(index->last_hit.node, lx, ly, sx, sy);
+		if (node) {
+			return node;
+		}
+	}
+	index->last_hit.node = NULL;
+
+	struct comp_input_grid *grid = NULL;
+	struct comp_output *output;
+	wl_list_for_each(output, &server.outputs, link) {
+		if (output->input_grid.cells &&
+			wlr_box_contains_point(&output->input_grid.box, lx, ly)) {
+			grid = &output->input_grid;
+			break;
+		}
+	}
+	if (!grid) {
+		goto fallback;
+	}
+
+	int col = ((int)lx - grid->box.x) / INPUT_INDEX_CELL_SIZE;
+	int row = ((int)ly - grid->box.y) / INPUT_INDEX_CELL_SIZE;
+	struct wl_array *cell = &grid->cells[row * grid->cols + col];
+	struct comp_input_index_entry *entries = index->entries.data;
+	uint32_t *cell_entries = cell->data;
+	size_t len = cell->size / sizeof(uint32_t);
+
+	// Iterate from the top of the stack
+	for (size_t i = len; i-- > 0;) {
+		struct comp_input_index_entry *entry = &entries[cell_entries[i]];
+		if (!wlr_box_contains_point(&entry->box, lx, ly)) {
+			continue;
+		}
+
+		// Also checks the input region of the buffer
+		struct wlr_scene_node *node =
+			wlr_scene_node_at(entry->node, lx, ly, sx, sy);
+		if (!node || !node_is_visible(entry->node)) {
+			continue;
+		}
+
+		if (i == len - 1) {
+			struct wlr_box cell_box = {
+				.x = grid->box.x + col * INPUT_INDEX_CELL_SIZE,
+				.y = grid->box.y + row * INPUT_INDEX_CELL_SIZE,
+				.width = INPUT_INDEX_CELL_SIZE,
+				.height = INPUT_INDEX_CELL_SIZE,
+			};
+			if (wlr_box_intersection(&index->last_hit.clip, &cell_box,
+									 &entry->box)) {
+				index->last_hit.node = node;
+			}
+		}
+		return node;
+	}
+
+	// A subsurface might have grown outside of its indexed box since the
+	// last rebuild, the scene is the source of truth
+fallback:
+	return wlr_scene_node_at(&server.root_scene->tree.node, lx, ly, sx, sy);
+}
+
+void comp_input_index_init(struct comp_input_index *index) {
+	*index = (struct comp_input_index){0};
+	wl_array_init(&index->entries);
+	listener_init(&index->new_surface);
+}
+
+void comp_input_index_finish(struct comp_input_index *index) {
+	listener_remove(&index->new_surface);
+	comp_input_index_invalidate(index);
+	wl_array_release(&index->entries);
+}
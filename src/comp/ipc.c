@@ -0,0 +1,1004 @@
+#define _GNU_SOURCE // for accept4
+
+#include <errno.h>
+#include <glib.h>
+#include <json.h>
+#include <linux/input-event-codes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+
+#include "comp/ipc.h"
+#include "comp/memory.h"
+#include "comp/output.h"
+#include "comp/server.h"
+#include "comp/slab.h"
+#include "comp/trace.h"
+#include "comp/workspace.h"
+#include "constants.h"
+#include "desktop/toplevel.h"
+#include "seat/keybindings.h"
+#include "seat/latency.h"
+#include "seat/seat.h"
+
+static const struct {
+	const char *name;
+	enum comp_ipc_event_type type;
+} event_types[] = {
+	{"toplevel", COMP_IPC_EVENT_TOPLEVEL},
+	{"focus", COMP_IPC_EVENT_FOCUS},
+	{"workspace", COMP_IPC_EVENT_WORKSPACE},
+	{"output", COMP_IPC_EVENT_OUTPUT},
+};
+
+/*
+ * Serialization
+ */
+
+static json_object *box_to_json(int x, int y, int width, int height) {
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "x", json_object_new_int(x));
+	json_object_object_add(object, "y", json_object_new_int(y));
+	json_object_object_add(object, "width", json_object_new_int(width));
+	json_object_object_add(object, "height", json_object_new_int(height));
+	return object;
+}
+
+static json_object *string_or_null(const char *str) {
+	return str ? json_object_new_string(str) : NULL;
+}
+
+/** Position in the output workspace list, changes as workspaces come and go */
+static int get_workspace_index(struct comp_workspace *ws) {
+	int index = 0;
+	struct comp_workspace *pos;
+	wl_list_for_each(pos, &ws->output->workspaces, output_link) {
+		if (pos == ws) {
+			return index;
+		}
+		index++;
+	}
+	return -1;
+}
+
+/** Adds the fields which are sent again in the toplevel_state event */
+static void toplevel_state_to_json(json_object *object,
+								   struct comp_toplevel *toplevel) {
+	json_object_object_add(
+		object, "geometry",
+		box_to_json(toplevel->state.x, toplevel->state.y,
+					toplevel->state.width, toplevel->state.height));
+	json_object_object_add(
+		object, "floating",
+		json_object_new_boolean(toplevel->tiling_mode ==
+								COMP_TILING_MODE_FLOATING));
+	json_object_object_add(object, "fullscreen",
+						   json_object_new_boolean(toplevel->fullscreen));
+	json_object_object_add(object, "minimized",
+						   json_object_new_boolean(toplevel->minimized));
+}
+
+static json_object *toplevel_to_json(struct comp_toplevel *toplevel) {
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "id", json_object_new_int64(toplevel->id));
+	json_object_object_add(
+		object, "type",
+		json_object_new_string(toplevel->type == COMP_TOPLEVEL_TYPE_XWAYLAND
+								   ? "xwayland"
+								   : "xdg"));
+	json_object_object_add(object, "title",
+						   string_or_null(comp_toplevel_get_title(toplevel)));
+	json_object_object_add(
+		object, "app_id",
+		string_or_null(comp_toplevel_get_foreign_id(toplevel)));
+	json_object_object_add(object, "pid", json_object_new_int(toplevel->pid));
+
+	struct comp_workspace *ws = toplevel->workspace;
+	json_object_object_add(
+		object, "output",
+		json_object_new_string(ws->output->wlr_output->name));
+	json_object_object_add(object, "workspace", json_object_new_int64(ws->id));
+	toplevel_state_to_json(object, toplevel);
+	json_object_object_add(
+		object, "focused",
+		json_object_new_boolean(server.seat->focused_toplevel == toplevel));
+	return object;
+}
+
+static json_object *workspace_to_json(struct comp_workspace *ws) {
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "id", json_object_new_int64(ws->id));
+	json_object_object_add(object, "index",
+						   json_object_new_int(get_workspace_index(ws)));
+	json_object_object_add(
+		object, "type",
+		json_object_new_string(ws->type == COMP_WORKSPACE_TYPE_FULLSCREEN
+								   ? "fullscreen"
+								   : "regular"));
+	json_object_object_add(
+		object, "active",
+		json_object_new_boolean(ws == ws->output->active_workspace));
+
+	// Most recently focused first
+	json_object *toplevels = json_object_new_array();
+	struct comp_toplevel *toplevel;
+	wl_list_for_each(toplevel, &ws->toplevels, workspace_link) {
+		json_object_array_add(toplevels, toplevel_to_json(toplevel));
+	}
+	json_object_object_add(object, "toplevels", toplevels);
+	return object;
+}
+
+static json_object *output_to_json(struct comp_output *output,
+								   bool with_workspaces) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "name",
+						   json_object_new_string(wlr_output->name));
+	json_object_object_add(object, "enabled",
+						   json_object_new_boolean(wlr_output->enabled));
+	json_object_object_add(
+		object, "fallback",
+		json_object_new_boolean(output == server.fallback_output));
+	json_object_object_add(object, "geometry",
+						   box_to_json(output->geometry.x, output->geometry.y,
+									   output->geometry.width,
+									   output->geometry.height));
+	json_object_object_add(object, "scale",
+						   json_object_new_double(wlr_output->scale));
+	json_object_object_add(object, "refresh_mhz",
+						   json_object_new_int(wlr_output->refresh));
+	json_object_object_add(object, "frames",
+						   json_object_new_int64(output->num_frames));
+	// CLOCK_MONOTONIC, 0 if nothing has been rendered yet
+	const int64_t last_frame_ns =
+		(int64_t)output->last_frame.tv_sec * NSEC_IN_SECONDS +
+		output->last_frame.tv_nsec;
+	json_object_object_add(object, "last_frame_ns",
+						   json_object_new_int64(last_frame_ns));
+
+	if (with_workspaces) {
+		json_object *workspaces = json_object_new_array();
+		struct comp_workspace *ws;
+		wl_list_for_each(ws, &output->workspaces, output_link) {
+			json_object_array_add(workspaces, workspace_to_json(ws));
+		}
+		json_object_object_add(object, "workspaces", workspaces);
+	}
+	return object;
+}
+
+static json_object *tree_to_json(void) {
+	json_object *object = json_object_new_object();
+	json_object *outputs = json_object_new_array();
+	struct comp_output *output;
+	wl_list_for_each(output, &server.outputs, link) {
+		json_object_array_add(outputs, output_to_json(output, true));
+	}
+	json_object_object_add(object, "outputs", outputs);
+
+	struct comp_toplevel *focused = server.seat->focused_toplevel;
+	json_object_object_add(object, "focused",
+						   focused ? json_object_new_int64(focused->id) : NULL);
+	return object;
+}
+
+static json_object *memory_to_json(void) {
+	struct comp_memory_usage usage;
+	if (!comp_memory_usage_get(&usage)) {
+		return NULL;
+	}
+
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "total",
+						   json_object_new_int64(usage.total));
+
+	json_object *toplevels = json_object_new_array();
+	for (size_t i = 0; i < usage.num_toplevels; i++) {
+		struct comp_toplevel_memory *memory = &usage.toplevels[i];
+		json_object *entry = json_object_new_object();
+		json_object_object_add(entry, "id",
+							   json_object_new_int64(memory->toplevel->id));
+		json_object_object_add(entry, "client",
+							   json_object_new_int64(memory->client));
+		json_object_object_add(entry, "decorations",
+							   json_object_new_int64(memory->decorations));
+		json_object_object_add(entry, "saved",
+							   json_object_new_int64(memory->saved));
+		json_object_object_add(entry, "total",
+							   json_object_new_int64(memory->total));
+		json_object_array_add(toplevels, entry);
+	}
+	json_object_object_add(object, "toplevels", toplevels);
+
+	json_object *outputs = json_object_new_array();
+	for (size_t i = 0; i < usage.num_outputs; i++) {
+		struct comp_output_memory *memory = &usage.outputs[i];
+		json_object *entry = json_object_new_object();
+		json_object_object_add(
+			entry, "name",
+			json_object_new_string(memory->output->wlr_output->name));
+		json_object_object_add(entry, "swapchains",
+							   json_object_new_int64(memory->swapchains));
+		json_object_object_add(entry, "blur_estimate",
+							   json_object_new_int64(memory->blur));
+		json_object_object_add(entry, "layers",
+							   json_object_new_int64(memory->layers));
+		json_object_object_add(entry, "snapshots",
+							   json_object_new_int64(memory->snapshots));
+		json_object_object_add(entry, "widgets",
+							   json_object_new_int64(memory->widgets));
+		json_object_object_add(entry, "total",
+							   json_object_new_int64(memory->total));
+		json_object_array_add(outputs, entry);
+	}
+	json_object_object_add(object, "outputs", outputs);
+
+	comp_memory_usage_finish(&usage);
+	return object;
+}
+
+static json_object *latency_to_json(struct comp_latency *latency) {
+	const char *input_names[COMP_LATENCY_INPUT_COUNT] = {
+		[COMP_LATENCY_INPUT_KEY] = "key",
+		[COMP_LATENCY_INPUT_POINTER] = "pointer",
+	};
+
+	json_object *clients = json_object_new_array();
+	struct comp_latency_client *client;
+	wl_list_for_each(client, &latency->clients, link) {
+		json_object *entry = json_object_new_object();
+		json_object_object_add(entry, "name",
+							   json_object_new_string(client->name));
+		json_object_object_add(entry, "pid", json_object_new_int(client->pid));
+		for (size_t i = 0; i < COMP_LATENCY_INPUT_COUNT; i++) {
+			struct comp_latency_histogram *histogram = &client->histograms[i];
+			json_object *stats = json_object_new_object();
+			json_object_object_add(stats, "count",
+								   json_object_new_int64(histogram->count));
+			if (histogram->count > 0) {
+				json_object_object_add(
+					stats, "mean_ms",
+					json_object_new_double(histogram->total_ms /
+										   histogram->count));
+				json_object_object_add(
+					stats, "min_ms", json_object_new_double(histogram->min_ms));
+				json_object_object_add(
+					stats, "max_ms", json_object_new_double(histogram->max_ms));
+			}
+			json_object_object_add(entry, input_names[i], stats);
+		}
+		json_object_array_add(clients, entry);
+	}
+	return clients;
+}
+
+static json_object *metrics_to_json(void) {
+	json_object *object = json_object_new_object();
+	json_object_object_add(object, "memory", memory_to_json());
+
+	json_object *slabs = json_object_new_array();
+	struct comp_slab *slab;
+	for (size_t i = 0; (slab = comp_slabs_get(i)); i++) {
+		json_object *entry = json_object_new_object();
+		json_object_object_add(entry, "name",
+							   json_object_new_string(slab->name));
+		json_object_object_add(entry, "live",
+							   json_object_new_int64(slab->live));
+		json_object_object_add(entry, "peak",
+							   json_object_new_int64(slab->peak));
+		json_object_object_add(entry, "pages",
+							   json_object_new_int64(slab->num_pages));
+		json_object_array_add(slabs, entry);
+	}
+	json_object_object_add(object, "slabs", slabs);
+
+	// Only available with `-D input-latency`
+	json_object_object_add(
+		object, "input_latency",
+		server.latency ? latency_to_json(server.latency) : NULL);
+	return object;
+}
+
+/*
+ * Clients
+ */
+
+static void client_destroy(struct comp_ipc_client *client) {
+	wl_list_remove(&client->link);
+	wl_event_source_remove(client->source);
+	close(client->fd);
+	wl_array_release(&client->read_buffer);
+	wl_array_release(&client->write_buffer);
+	free(client);
+}
+
+static void handle_destroy_idle(void *data) {
+	server.ipc.destroy_idle = NULL;
+
+	struct comp_ipc_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &server.ipc.clients, link) {
+		if (client->closing) {
+			client_destroy(client);
+		}
+	}
+}
+
+/** Destroys the client once the current event has been handled */
+static void client_close(struct comp_ipc_client *client) {
+	if (client->closing) {
+		return;
+	}
+	client->closing = true;
+	// Errors and hangups are still reported, handle_client ignores them
+	wl_event_source_fd_update(client->source, 0);
+	if (!server.ipc.destroy_idle) {
+		server.ipc.destroy_idle = wl_event_loop_add_idle(
+			server.wl_event_loop, handle_destroy_idle, NULL);
+	}
+}
+
+/** Returns false if the client is closing */
+static bool client_flush(struct comp_ipc_client *client) {
+	struct wl_array *buffer = &client->write_buffer;
+	while (client->write_offset < buffer->size) {
+		ssize_t written =
+			send(client->fd, (char *)buffer->data + client->write_offset,
+				 buffer->size - client->write_offset, MSG_NOSIGNAL);
+		if (written < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			} else if (errno == EINTR) {
+				continue;
+			}
+			wlr_log_errno(WLR_DEBUG, "Could not write to IPC client");
+			client_close(client);
+			return false;
+		}
+		client->write_offset += written;
+	}
+
+	uint32_t mask = client->read_closed ? 0 : WL_EVENT_READABLE;
+	if (client->write_offset == buffer->size) {
+		buffer->size = 0;
+		client->write_offset = 0;
+		if (client->read_closed) {
+			client_close(client);
+			return false;
+		}
+	} else {
+		// Wait until the client has read its events
+		mask |= WL_EVENT_WRITABLE;
+	}
+	wl_event_source_fd_update(client->source, mask);
+	return true;
+}
+
+/** Returns false if the client is closing */
+static bool client_write(struct comp_ipc_client *client, const char *message,
+						 size_t len) {
+	if (client->closing) {
+		return false;
+	}
+
+	struct wl_array *buffer = &client->write_buffer;
+	if (buffer->size - client->write_offset + len > IPC_MAX_CLIENT_BUFFER) {
+		wlr_log(WLR_INFO, "Disconnecting IPC client which stopped reading");
+		client_close(client);
+		return false;
+	}
+
+	// Drop the part which has already been written
+	if (client->write_offset > 0) {
+		memmove(buffer->data, (char *)buffer->data + client->write_offset,
+				buffer->size - client->write_offset);
+		buffer->size -= client->write_offset;
+		client->write_offset = 0;
+	}
+
+	char *data = wl_array_add(buffer, len + 1);
+	if (!data) {
+		wlr_log(WLR_ERROR, "Could not allocate IPC message");
+		client_close(client);
+		return false;
+	}
+	memcpy(data, message, len);
+	data[len] = '\n';
+	return client_flush(client);
+}
+
+/** Takes ownership of the reply, returns false if the client is closing */
+static bool client_reply(struct comp_ipc_client *client, json_object *id,
+						 json_object *result, const char *error) {
+	json_object *reply = json_object_new_object();
+	json_object_object_add(reply, "id", json_object_get(id));
+	json_object_object_add(reply, "success", json_object_new_boolean(!error));
+	if (error) {
+		json_object_object_add(reply, "error", json_object_new_string(error));
+	} else {
+		json_object_object_add(reply, "result", result);
+	}
+
+	size_t len;
+	const char *message =
+		json_object_to_json_string_length(reply, JSON_C_TO_STRING_PLAIN, &len);
+	bool alive = client_write(client, message, len);
+	json_object_put(reply);
+	return alive;
+}
+
+static const char *client_subscribe(struct comp_ipc_client *client,
+									json_object *events) {
+	if (!events || !json_object_is_type(events, json_type_array)) {
+		return "Expected an array of events";
+	}
+
+	uint32_t subscriptions = 0;
+	for (size_t i = 0; i < json_object_array_length(events); i++) {
+		const char *name =
+			json_object_get_string(json_object_array_get_idx(events, i));
+		size_t j = 0;
+		for (; j < sizeof(event_types) / sizeof(*event_types); j++) {
+			if (name && strcmp(name, event_types[j].name) == 0) {
+				subscriptions |= event_types[j].type;
+				break;
+			}
+		}
+		if (j == sizeof(event_types) / sizeof(*event_types)) {
+			return "Unknown event type";
+		}
+	}
+
+	client->subscriptions |= subscriptions;
+	// The reply contains the current focus
+	struct comp_toplevel *focused = server.seat->focused_toplevel;
+	client->focused_id = focused ? focused->id : 0;
+	return NULL;
+}
+
+/*
+ * Pointer
+ */
+
+static const struct wlr_pointer_impl ipc_pointer_impl = {
+	.name = "fx-comp-ipc-pointer",
+};
+
+/**
+ * Moves the pointer to the layout coordinates x and y, then by dx and dy,
+ * then presses or releases the left button. Goes through the same path as a
+ * real pointer, e.g. for driving interactive resizes from fx-comp-bench.
+ */
+static const char *pointer_command(json_object *request) {
+	struct comp_ipc *ipc = &server.ipc;
+	if (server.comp_session_lock.locked) {
+		return "The session is locked";
+	}
+	if (!ipc->pointer_added) {
+		wlr_pointer_init(&ipc->pointer, &ipc_pointer_impl,
+						 ipc_pointer_impl.name);
+		comp_seat_add_input_device(server.seat, &ipc->pointer.base);
+		ipc->pointer_added = true;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	const uint32_t time = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+	json_object *x, *y, *dx = NULL, *dy = NULL, *pressed;
+	if (json_object_object_get_ex(request, "x", &x) &&
+		json_object_object_get_ex(request, "y", &y)) {
+		struct wlr_box box;
+		wlr_output_layout_get_box(server.output_layout, NULL, &box);
+		if (wlr_box_empty(&box)) {
+			return "No outputs";
+		}
+		struct wlr_pointer_motion_absolute_event event = {
+			.pointer = &ipc->pointer,
+			.time_msec = time,
+			.x = (json_object_get_double(x) - box.x) / box.width,
+			.y = (json_object_get_double(y) - box.y) / box.height,
+		};
+		wl_signal_emit_mutable(&ipc->pointer.events.motion_absolute, &event);
+	}
+	json_object_object_get_ex(request, "dx", &dx);
+	json_object_object_get_ex(request, "dy", &dy);
+	if (dx || dy) {
+		struct wlr_pointer_motion_event event = {
+			.pointer = &ipc->pointer,
+			.time_msec = time,
+			.delta_x = json_object_get_double(dx),
+			.delta_y = json_object_get_double(dy),
+			.unaccel_dx = json_object_get_double(dx),
+			.unaccel_dy = json_object_get_double(dy),
+		};
+		wl_signal_emit_mutable(&ipc->pointer.events.motion, &event);
+	}
+	if (json_object_object_get_ex(request, "pressed", &pressed)) {
+		struct wlr_pointer_button_event event = {
+			.pointer = &ipc->pointer,
+			.time_msec = time,
+			.button = BTN_LEFT,
+			.state = json_object_get_boolean(pressed)
+						 ? WL_POINTER_BUTTON_STATE_PRESSED
+						 : WL_POINTER_BUTTON_STATE_RELEASED,
+		};
+		wl_signal_emit_mutable(&ipc->pointer.events.button, &event);
+	}
+	wl_signal_emit_mutable(&ipc->pointer.events.frame, &ipc->pointer);
+	return NULL;
+}
+
+/** Returns false if the client is closing */
+static bool client_handle_request(struct comp_ipc_client *client,
+								  const char *line) {
+	json_object *request = json_tokener_parse(line);
+	if (!request || !json_object_is_type(request, json_type_object)) {
+		json_object_put(request);
+		return client_reply(client, NULL, NULL, "Invalid JSON request");
+	}
+
+	json_object *id = NULL, *command = NULL, *events = NULL, *action = NULL,
+				*arg = NULL;
+	json_object_object_get_ex(request, "id", &id);
+	json_object_object_get_ex(request, "command", &command);
+	json_object_object_get_ex(request, "events", &events);
+	json_object_object_get_ex(request, "action", &action);
+	json_object_object_get_ex(request, "arg", &arg);
+	const char *name = command ? json_object_get_string(command) : "";
+
+	json_object *result = NULL;
+	const char *error = NULL;
+	if (strcmp(name, "get_tree") == 0) {
+		result = tree_to_json();
+	} else if (strcmp(name, "get_outputs") == 0) {
+		result = json_object_new_array();
+		struct comp_output *output;
+		wl_list_for_each(output, &server.outputs, link) {
+			json_object_array_add(result, output_to_json(output, false));
+		}
+	} else if (strcmp(name, "get_metrics") == 0) {
+		result = metrics_to_json();
+	} else if (strcmp(name, "run") == 0) {
+		// Runs the keybinding action with its optional argument, same as
+		// pressing its binding. Part of the IPC API, e.g. for scripts and
+		// fx-comp-bench.
+		const char *action_name =
+			action ? json_object_get_string(action) : NULL;
+		const char *action_arg = arg ? json_object_get_string(arg) : NULL;
+		if (server.comp_session_lock.locked) {
+			error = "The session is locked";
+		} else if (!action_name ||
+				   !comp_keybindings_run_action(action_name, action_arg)) {
+			error = "Unknown action or missing argument";
+		}
+	} else if (strcmp(name, "pointer") == 0) {
+		error = pointer_command(request);
+	} else if (strcmp(name, "export_trace") == 0) {
+		// Only available with `-D trace`
+		char *path = comp_trace_export();
+		if (path) {
+			result = json_object_new_string(path);
+			g_free(path);
+		} else {
+			error = "Could not export the trace, is `-D trace` set?";
+		}
+	} else if (strcmp(name, "subscribe") == 0) {
+		// Reply with the current state, which the events are deltas of
+		if (!(error = client_subscribe(client, events))) {
+			result = tree_to_json();
+		}
+	} else {
+		error = "Unknown command";
+	}
+
+	// The action or a broadcast might have closed the client
+	bool alive = client_reply(client, id, result, error);
+	json_object_put(request);
+	return alive;
+}
+
+static int handle_client(int fd, uint32_t mask, void *data) {
+	struct comp_ipc_client *client = data;
+	if (client->closing) {
+		return 0;
+	}
+	if (mask & (WL_EVENT_ERROR | WL_EVENT_HANGUP)) {
+		client_close(client);
+		return 0;
+	}
+	if ((mask & WL_EVENT_WRITABLE) && !client_flush(client)) {
+		return 0;
+	}
+	if (!(mask & WL_EVENT_READABLE)) {
+		return 0;
+	}
+
+	struct wl_array *buffer = &client->read_buffer;
+	bool eof = false;
+	while (true) {
+		char chunk[4096];
+		ssize_t len = read(client->fd, chunk, sizeof(chunk));
+		if (len == 0) {
+			eof = true;
+			break;
+		} else if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			client_close(client);
+			return 0;
+		}
+
+		char *data = wl_array_add(buffer, len);
+		if (!data || buffer->size > IPC_MAX_REQUEST_SIZE) {
+			wlr_log(WLR_INFO, "Disconnecting IPC client, request too large");
+			client_close(client);
+			return 0;
+		}
+		memcpy(data, chunk, len);
+	}
+
+	// Handle every complete line
+	char *start = buffer->data;
+	size_t remaining = buffer->size;
+	char *end;
+	while ((end = memchr(start, '\n', remaining))) {
+		*end = '\0';
+		remaining -= end + 1 - start;
+		if (*start && !client_handle_request(client, start)) {
+			return 0;
+		}
+		start = end + 1;
+	}
+	memmove(buffer->data, start, remaining);
+	buffer->size = remaining;
+	if (!eof) {
+		return 0;
+	}
+
+	// No more requests are coming, the last one doesn't need a newline
+	if (buffer->size > 0) {
+		char *nul = wl_array_add(buffer, 1);
+		if (!nul) {
+			wlr_log(WLR_ERROR, "Could not allocate IPC request");
+			client_close(client);
+			return 0;
+		}
+		*nul = '\0';
+		bool alive = client_handle_request(client, buffer->data);
+		buffer->size = 0;
+		if (!alive) {
+			return 0;
+		}
+	}
+	// Close once the replies have been written
+	client->read_closed = true;
+	client_flush(client);
+	return 0;
+}
+
+static int handle_socket(int fd, uint32_t mask, void *data) {
+	int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (client_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Could not accept IPC client");
+		return 0;
+	}
+
+	struct comp_ipc_client *client = calloc(1, sizeof(*client));
+	if (!client) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_ipc_client");
+		close(client_fd);
+		return 0;
+	}
+	client->fd = client_fd;
+	wl_array_init(&client->read_buffer);
+	wl_array_init(&client->write_buffer);
+	client->source =
+		wl_event_loop_add_fd(server.wl_event_loop, client_fd,
+							 WL_EVENT_READABLE, handle_client, client);
+	if (!client->source) {
+		wlr_log(WLR_ERROR, "Could not watch IPC client");
+		close(client_fd);
+		free(client);
+		return 0;
+	}
+	wl_list_insert(&server.ipc.clients, &client->link);
+	return 0;
+}
+
+/*
+ * Events
+ */
+
+static bool has_subscribers(enum comp_ipc_event_type type) {
+	struct comp_ipc_client *client;
+	wl_list_for_each(client, &server.ipc.clients, link) {
+		if (!client->closing && client->subscriptions & type) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Takes ownership of the event */
+static void broadcast(enum comp_ipc_event_type type, json_object *event) {
+	size_t len;
+	const char *message =
+		json_object_to_json_string_length(event, JSON_C_TO_STRING_PLAIN, &len);
+
+	struct comp_ipc_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &server.ipc.clients, link) {
+		if (client->subscriptions & type) {
+			client_write(client, message, len);
+		}
+	}
+	json_object_put(event);
+}
+
+static json_object *event_create(const char *name) {
+	json_object *event = json_object_new_object();
+	json_object_object_add(event, "event", json_object_new_string(name));
+	return event;
+}
+
+/** Returns false if the state is the same as the last one reported */
+static bool toplevel_sync_ipc_state(struct comp_toplevel *toplevel) {
+	bool changed =
+		!comp_toplevel_state_is_same(&toplevel->ipc_state.geometry,
+									 &toplevel->state) ||
+		toplevel->ipc_state.tiling_mode != toplevel->tiling_mode ||
+		toplevel->ipc_state.fullscreen != toplevel->fullscreen ||
+		toplevel->ipc_state.minimized != toplevel->minimized;
+	toplevel->ipc_state.geometry = toplevel->state;
+	toplevel->ipc_state.tiling_mode = toplevel->tiling_mode;
+	toplevel->ipc_state.fullscreen = toplevel->fullscreen;
+	toplevel->ipc_state.minimized = toplevel->minimized;
+	return changed;
+}
+
+void comp_ipc_toplevel_map(struct comp_toplevel *toplevel) {
+	// The map event already contains the state
+	toplevel_sync_ipc_state(toplevel);
+	if (!has_subscribers(COMP_IPC_EVENT_TOPLEVEL)) {
+		return;
+	}
+	json_object *event = event_create("toplevel_map");
+	json_object_object_add(event, "toplevel", toplevel_to_json(toplevel));
+	broadcast(COMP_IPC_EVENT_TOPLEVEL, event);
+}
+
+void comp_ipc_toplevel_unmap(struct comp_toplevel *toplevel) {
+	if (!has_subscribers(COMP_IPC_EVENT_TOPLEVEL)) {
+		return;
+	}
+	json_object *event = event_create("toplevel_unmap");
+	json_object_object_add(event, "id", json_object_new_int64(toplevel->id));
+	broadcast(COMP_IPC_EVENT_TOPLEVEL, event);
+}
+
+void comp_ipc_toplevel_title(struct comp_toplevel *toplevel) {
+	if (toplevel->unmapped || !has_subscribers(COMP_IPC_EVENT_TOPLEVEL)) {
+		return;
+	}
+	json_object *event = event_create("toplevel_title");
+	json_object_object_add(event, "id", json_object_new_int64(toplevel->id));
+	json_object_object_add(event, "title",
+						   string_or_null(comp_toplevel_get_title(toplevel)));
+	broadcast(COMP_IPC_EVENT_TOPLEVEL, event);
+}
+
+void comp_ipc_toplevel_move(struct comp_toplevel *toplevel) {
+	if (toplevel->unmapped || !has_subscribers(COMP_IPC_EVENT_TOPLEVEL)) {
+		return;
+	}
+	struct comp_workspace *ws = toplevel->workspace;
+	json_object *event = event_create("toplevel_move");
+	json_object_object_add(event, "id", json_object_new_int64(toplevel->id));
+	json_object_object_add(
+		event, "output", json_object_new_string(ws->output->wlr_output->name));
+	json_object_object_add(event, "workspace", json_object_new_int64(ws->id));
+	broadcast(COMP_IPC_EVENT_TOPLEVEL, event);
+}
+
+void comp_ipc_toplevel_state(struct comp_toplevel *toplevel) {
+	// Always kept in sync, so that a client subscribing later doesn't miss a
+	// change back to a previously reported state
+	if (!toplevel_sync_ipc_state(toplevel) || toplevel->unmapped ||
+		!has_subscribers(COMP_IPC_EVENT_TOPLEVEL)) {
+		return;
+	}
+	json_object *event = event_create("toplevel_state");
+	json_object_object_add(event, "id", json_object_new_int64(toplevel->id));
+	toplevel_state_to_json(event, toplevel);
+	broadcast(COMP_IPC_EVENT_TOPLEVEL, event);
+}
+
+static void handle_focus_idle(void *data) {
+	server.ipc.focus_idle = NULL;
+
+	struct comp_toplevel *focused = server.seat->focused_toplevel;
+	uint32_t id = focused ? focused->id : 0;
+
+	json_object *event = event_create("focus");
+	json_object_object_add(event, "id",
+						   focused ? json_object_new_int64(id) : NULL);
+	size_t len;
+	const char *message =
+		json_object_to_json_string_length(event, JSON_C_TO_STRING_PLAIN, &len);
+
+	// Only send it to the clients which haven't seen this focus yet
+	struct comp_ipc_client *client;
+	wl_list_for_each(client, &server.ipc.clients, link) {
+		if (client->subscriptions & COMP_IPC_EVENT_FOCUS &&
+			client->focused_id != id) {
+			client->focused_id = id;
+			client_write(client, message, len);
+		}
+	}
+	json_object_put(event);
+}
+
+void comp_ipc_focus_changed(void) {
+	if (server.ipc.focus_idle || !has_subscribers(COMP_IPC_EVENT_FOCUS)) {
+		return;
+	}
+	server.ipc.focus_idle =
+		wl_event_loop_add_idle(server.wl_event_loop, handle_focus_idle, NULL);
+}
+
+void comp_ipc_workspace_changed(struct comp_output *output) {
+	if (!output->active_workspace ||
+		!has_subscribers(COMP_IPC_EVENT_WORKSPACE)) {
+		return;
+	}
+	json_object *event = event_create("workspace");
+	json_object_object_add(event, "output",
+						   json_object_new_string(output->wlr_output->name));
+	json_object_object_add(
+		event, "workspace",
+		json_object_new_int64(output->active_workspace->id));
+	broadcast(COMP_IPC_EVENT_WORKSPACE, event);
+}
+
+void comp_ipc_workspace_added(struct comp_workspace *ws) {
+	if (!has_subscribers(COMP_IPC_EVENT_WORKSPACE)) {
+		return;
+	}
+	json_object *event = event_create("workspace_add");
+	json_object_object_add(
+		event, "output", json_object_new_string(ws->output->wlr_output->name));
+	json_object_object_add(event, "workspace", workspace_to_json(ws));
+	broadcast(COMP_IPC_EVENT_WORKSPACE, event);
+}
+
+void comp_ipc_workspace_removed(struct comp_workspace *ws) {
+	if (!has_subscribers(COMP_IPC_EVENT_WORKSPACE)) {
+		return;
+	}
+	json_object *event = event_create("workspace_remove");
+	json_object_object_add(
+		event, "output", json_object_new_string(ws->output->wlr_output->name));
+	json_object_object_add(event, "id", json_object_new_int64(ws->id));
+	broadcast(COMP_IPC_EVENT_WORKSPACE, event);
+}
+
+void comp_ipc_output_added(struct comp_output *output) {
+	if (!has_subscribers(COMP_IPC_EVENT_OUTPUT)) {
+		return;
+	}
+	json_object *event = event_create("output_add");
+	json_object_object_add(event, "output", output_to_json(output, true));
+	broadcast(COMP_IPC_EVENT_OUTPUT, event);
+}
+
+void comp_ipc_output_removed(struct comp_output *output) {
+	if (!has_subscribers(COMP_IPC_EVENT_OUTPUT)) {
+		return;
+	}
+	json_object *event = event_create("output_remove");
+	json_object_object_add(event, "name",
+						   json_object_new_string(output->wlr_output->name));
+	broadcast(COMP_IPC_EVENT_OUTPUT, event);
+}
+
+/*
+ * Socket
+ */
+
+bool comp_ipc_init(void) {
+	struct comp_ipc *ipc = &server.ipc;
+	wl_list_init(&ipc->clients);
+	ipc->socket_fd = -1;
+
+	const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+	if (!runtime_dir) {
+		wlr_log(WLR_ERROR, "XDG_RUNTIME_DIR not set, IPC disabled");
+		return false;
+	}
+	char name[64];
+	snprintf(name, sizeof(name), IPC_SOCKET_NAME, getpid());
+	ipc->socket_path = g_build_filename(runtime_dir, name, NULL);
+
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(ipc->socket_path) >= sizeof(addr.sun_path)) {
+		wlr_log(WLR_ERROR, "IPC socket path too long: %s", ipc->socket_path);
+		goto err;
+	}
+	strcpy(addr.sun_path, ipc->socket_path);
+
+	ipc->socket_fd =
+		socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (ipc->socket_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Could not create the IPC socket");
+		goto err;
+	}
+	// Left behind by a crashed compositor with the same pid
+	unlink(ipc->socket_path);
+	if (bind(ipc->socket_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+		listen(ipc->socket_fd, 16) != 0) {
+		wlr_log_errno(WLR_ERROR, "Could not listen on %s", ipc->socket_path);
+		goto err;
+	}
+
+	ipc->socket_source =
+		wl_event_loop_add_fd(server.wl_event_loop, ipc->socket_fd,
+							 WL_EVENT_READABLE, handle_socket, NULL);
+	if (!ipc->socket_source) {
+		wlr_log(WLR_ERROR, "Could not watch the IPC socket");
+		goto err;
+	}
+
+	setenv(IPC_SOCKET_ENV, ipc->socket_path, true);
+	wlr_log(WLR_INFO, "IPC listening on %s", ipc->socket_path);
+	return true;
+
+err:
+	comp_ipc_finish();
+	return false;
+}
+
+void comp_ipc_finish(void) {
+	struct comp_ipc *ipc = &server.ipc;
+
+	struct comp_ipc_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &ipc->clients, link) {
+		client_destroy(client);
+	}
+	if (ipc->destroy_idle) {
+		wl_event_source_remove(ipc->destroy_idle);
+		ipc->destroy_idle = NULL;
+	}
+	if (ipc->focus_idle) {
+		wl_event_source_remove(ipc->focus_idle);
+		ipc->focus_idle = NULL;
+	}
+	if (ipc->pointer_added) {
+		wlr_pointer_finish(&ipc->pointer);
+		ipc->pointer_added = false;
+	}
+	if (ipc->socket_source) {
+		wl_event_source_remove(ipc->socket_source);
+		ipc->socket_source = NULL;
+	}
+	if (ipc->socket_fd >= 0) {
+		close(ipc->socket_fd);
+		unlink(ipc->socket_path);
+		ipc->socket_fd = -1;
+	}
+	g_free(ipc->socket_path);
+	ipc->socket_path = NULL;
+}
@@ -180,6 +180,7 @@ static void lock_output_reconfigure(struct comp_session_lock_output *output) {
 		wlr_session_lock_surface_v1_configure(output->surface, output_box.width,
 											  output_box.height);
 	}
+	comp_input_index_invalidate(&server.input_index);
 }
 
 static void lock_node_handle_destroy(struct wl_listener *listener, void *data) {
@@ -278,6 +279,7 @@ static void handle_surface_map(struct wl_listener *listener, void *data) {
 		focus_surface(l_output->surface->surface);
 	}
 	mark_effects_dirty(l_output);
+	comp_input_index_invalidate(&server.input_index);
 	// cursor_rebase_all();
 }
 
@@ -376,6 +378,7 @@ static void handle_abandon(struct wl_listener *listener, void *data) {
 	wl_list_for_each(lock_output, &lock->outputs, link) {
 		wlr_scene_node_set_enabled(&lock_output->background->node, true);
 	}
+	comp_input_index_invalidate(&server.input_index);
 
 	lock->focused = NULL;
 	// Only change the state if still locked. Fixes state being abandoned after
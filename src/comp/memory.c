@@ -0,0 +1,286 @@
+#include <glib.h>
+#include <scenefx/types/wlr_scene.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/render/swapchain.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+#include "comp/memory.h"
+#include "comp/output.h"
+#include "comp/server.h"
+#include "comp/workspace.h"
+#include "constants.h"
+#include "desktop/toplevel.h"
+#include "desktop/widgets/workspace_indicator.h"
+
+static double to_mib(size_t bytes) {
+	return bytes / (1024.0 * 1024.0);
+}
+
+static size_t buffer_size(struct wlr_buffer *buffer) {
+	struct wlr_shm_attributes shm;
+	if (wlr_buffer_get_shm(buffer, &shm)) {
+		return (size_t)shm.stride * shm.height;
+	}
+
+	struct wlr_dmabuf_attributes dmabuf;
+	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		// Over-estimates subsampled planes, close enough
+		size_t size = 0;
+		for (int i = 0; i < dmabuf.n_planes; i++) {
+			size += (size_t)dmabuf.stride[i] * dmabuf.height;
+		}
+		return size;
+	}
+
+	// Cairo buffers, and client buffers without their source. Assume 32 bpp.
+	return (size_t)buffer->width * buffer->height * 4;
+}
+
+static size_t swapchain_size(struct wlr_swapchain *swapchain) {
+	if (!swapchain) {
+		return 0;
+	}
+
+	size_t size = 0;
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		if (swapchain->slots[i].buffer) {
+			size += buffer_size(swapchain->slots[i].buffer);
+		}
+	}
+	return size;
+}
+
+/** Adds the size of every buffer in the tree which hasn't been seen yet */
+static void tree_add_buffers(GHashTable *seen, struct wlr_scene_tree *tree,
+							 size_t *size) {
+	if (!tree) {
+		return;
+	}
+
+	struct wlr_scene_node *node;
+	wl_list_for_each(node, &tree->children, link) {
+		switch (node->type) {
+		case WLR_SCENE_NODE_TREE:
+			tree_add_buffers(seen, wlr_scene_tree_from_node(node), size);
+			break;
+		case WLR_SCENE_NODE_BUFFER: {
+			struct wlr_buffer *buffer =
+				wlr_scene_buffer_from_node(node)->buffer;
+			if (buffer && g_hash_table_add(seen, buffer)) {
+				*size += buffer_size(buffer);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+static void toplevel_get_memory(GHashTable *seen,
+								struct comp_toplevel *toplevel,
+								struct comp_toplevel_memory *memory) {
+	*memory = (struct comp_toplevel_memory){.toplevel = toplevel};
+
+	tree_add_buffers(seen, toplevel->toplevel_scene_tree, &memory->client);
+	tree_add_buffers(seen, toplevel->decoration_scene_tree,
+					 &memory->decorations);
+	tree_add_buffers(seen, toplevel->saved_scene_tree, &memory->saved);
+	tree_add_buffers(seen, toplevel->object.saved_tree, &memory->saved);
+	// Everything else, like the popup tree of XDG toplevels
+	tree_add_buffers(seen, toplevel->object.scene_tree, &memory->client);
+
+	memory->total = memory->client + memory->decorations + memory->saved;
+}
+
+static void output_get_memory(GHashTable *seen, struct comp_output *output,
+							  struct comp_output_memory *memory) {
+	*memory = (struct comp_output_memory){.output = output};
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	memory->swapchains = swapchain_size(wlr_output->swapchain) +
+						 swapchain_size(wlr_output->cursor_swapchain);
+	if (wlr_output->enabled && output != server.fallback_output) {
+		memory->blur = (size_t)MEMORY_BLUR_BUFFERS_PER_OUTPUT *
+					   wlr_output->width * wlr_output->height * 4;
+	}
+
+	tree_add_buffers(seen, output->layers.shell_background, &memory->layers);
+	tree_add_buffers(seen, output->layers.shell_bottom, &memory->layers);
+	tree_add_buffers(seen, output->layers.unmanaged, &memory->layers);
+	tree_add_buffers(seen, output->layers.shell_top, &memory->layers);
+	tree_add_buffers(seen, output->layers.shell_overlay, &memory->layers);
+
+	// Counted after the toplevels, so only buffers which are no longer shown
+	// anywhere else end up here
+	tree_add_buffers(seen, output->layers.workspace_switch,
+					 &memory->snapshots);
+	tree_add_buffers(seen, output->layers.overview, &memory->snapshots);
+	struct comp_workspace *ws;
+	wl_list_for_each(ws, &output->workspaces, output_link) {
+		tree_add_buffers(seen, ws->snapshot, &memory->snapshots);
+	}
+
+	if (output->ws_indicator) {
+		tree_add_buffers(seen, output->ws_indicator->widget.object.scene_tree,
+						 &memory->widgets);
+	}
+
+	memory->total = memory->swapchains + memory->blur + memory->layers +
+					memory->snapshots + memory->widgets;
+}
+
+static int compare_toplevel_memory(const void *a, const void *b) {
+	const struct comp_toplevel_memory *memory_a = a;
+	const struct comp_toplevel_memory *memory_b = b;
+	if (memory_a->total == memory_b->total) {
+		return 0;
+	}
+	return memory_a->total < memory_b->total ? 1 : -1;
+}
+
+bool comp_memory_usage_get(struct comp_memory_usage *usage) {
+	*usage = (struct comp_memory_usage){0};
+
+	struct comp_output *output;
+	struct comp_workspace *ws;
+	struct comp_toplevel *toplevel;
+	wl_list_for_each(output, &server.outputs, link) {
+		usage->num_outputs++;
+		wl_list_for_each(ws, &output->workspaces, output_link) {
+			usage->num_toplevels += wl_list_length(&ws->toplevels);
+		}
+	}
+
+	usage->outputs = calloc(usage->num_outputs, sizeof(*usage->outputs));
+	usage->toplevels = calloc(usage->num_toplevels, sizeof(*usage->toplevels));
+	if ((usage->num_outputs && !usage->outputs) ||
+		(usage->num_toplevels && !usage->toplevels)) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_memory_usage");
+		comp_memory_usage_finish(usage);
+		return false;
+	}
+
+	GHashTable *seen = g_hash_table_new(NULL, NULL);
+
+	size_t i = 0;
+	wl_list_for_each(output, &server.outputs, link) {
+		wl_list_for_each(ws, &output->workspaces, output_link) {
+			wl_list_for_each(toplevel, &ws->toplevels, workspace_link) {
+				struct comp_toplevel_memory *memory = &usage->toplevels[i++];
+				toplevel_get_memory(seen, toplevel, memory);
+				usage->total += memory->total;
+			}
+		}
+	}
+	qsort(usage->toplevels, usage->num_toplevels, sizeof(*usage->toplevels),
+		  compare_toplevel_memory);
+
+	i = 0;
+	wl_list_for_each(output, &server.outputs, link) {
+		struct comp_output_memory *memory = &usage->outputs[i++];
+		output_get_memory(seen, output, memory);
+		usage->total += memory->total;
+	}
+
+	g_hash_table_destroy(seen);
+	return true;
+}
+
+void comp_memory_usage_finish(struct comp_memory_usage *usage) {
+	free(usage->toplevels);
+	free(usage->outputs);
+	*usage = (struct comp_memory_usage){0};
+}
+
+void comp_memory_report(void) {
+	struct comp_memory_usage usage;
+	if (!comp_memory_usage_get(&usage)) {
+		return;
+	}
+
+	printf("Compositor buffer memory: %.1f MiB\n", to_mib(usage.total));
+
+	printf("  Toplevels:\n");
+	for (size_t i = 0; i < usage.num_toplevels; i++) {
+		struct comp_toplevel_memory *memory = &usage.toplevels[i];
+		const char *title = memory->toplevel->title;
+		printf("    %-32.32s pid: %6d  client: %6.1f  decorations: %5.1f  "
+			   "saved: %6.1f  total: %6.1f MiB\n",
+			   title[0] ? title : "(untitled)", memory->toplevel->pid,
+			   to_mib(memory->client), to_mib(memory->decorations),
+			   to_mib(memory->saved), to_mib(memory->total));
+	}
+
+	printf("  Outputs:\n");
+	for (size_t i = 0; i < usage.num_outputs; i++) {
+		struct comp_output_memory *memory = &usage.outputs[i];
+		printf("    %-12s swapchains: %6.1f  blur (est.): %6.1f  "
+			   "layers: %6.1f  snapshots: %6.1f  widgets: %5.1f  "
+			   "total: %6.1f MiB\n",
+			   memory->output->wlr_output->name, to_mib(memory->swapchains),
+			   to_mib(memory->blur), to_mib(memory->layers),
+			   to_mib(memory->snapshots), to_mib(memory->widgets),
+			   to_mib(memory->total));
+	}
+	fflush(stdout);
+
+	comp_memory_usage_finish(&usage);
+}
+
+/*
+ * Periodic log
+ */
+
+static int handle_log_timer(void *data) {
+	struct comp_memory_usage usage;
+	if (comp_memory_usage_get(&usage)) {
+		size_t toplevels_total = usage.total;
+		for (size_t i = 0; i < usage.num_outputs; i++) {
+			toplevels_total -= usage.outputs[i].total;
+		}
+
+		if (usage.num_toplevels > 0) {
+			struct comp_toplevel_memory *largest = &usage.toplevels[0];
+			wlr_log(WLR_INFO,
+					"Buffer memory: %.1f MiB, %zu toplevels: %.1f MiB "
+					"(largest: '%s' %.1f MiB), %zu outputs: %.1f MiB",
+					to_mib(usage.total), usage.num_toplevels,
+					to_mib(toplevels_total), largest->toplevel->title,
+					to_mib(largest->total), usage.num_outputs,
+					to_mib(usage.total - toplevels_total));
+		} else {
+			wlr_log(WLR_INFO, "Buffer memory: %.1f MiB, %zu outputs",
+					to_mib(usage.total), usage.num_outputs);
+		}
+		comp_memory_usage_finish(&usage);
+	}
+
+	wl_event_source_timer_update(server.memory_log_timer,
+								 MEMORY_LOG_INTERVAL_MS);
+	return 0;
+}
+
+bool comp_memory_log_start(void) {
+	server.memory_log_timer =
+		wl_event_loop_add_timer(server.wl_event_loop, handle_log_timer, NULL);
+	if (!server.memory_log_timer) {
+		wlr_log(WLR_ERROR, "Could not create the memory log timer");
+		return false;
+	}
+	wl_event_source_timer_update(server.memory_log_timer,
+								 MEMORY_LOG_INTERVAL_MS);
+	return true;
+}
+
+void comp_memory_log_stop(void) {
+	if (server.memory_log_timer) {
+		wl_event_source_remove(server.memory_log_timer);
+		server.memory_log_timer = NULL;
+	}
+}
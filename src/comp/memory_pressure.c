@@ -0,0 +1,314 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <pango/pangocairo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/util/log.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "comp/animation_mgr.h"
+#include "comp/icon_loader.h"
+#include "comp/memory.h"
+#include "comp/memory_pressure.h"
+#include "comp/output.h"
+#include "comp/server.h"
+#include "comp/slab.h"
+#include "comp/widget.h"
+#include "comp/workspace.h"
+#include "constants.h"
+#include "desktop/widgets/workspace_indicator.h"
+
+static double timespec_diff_ms(const struct timespec *start,
+							   const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 +
+		   (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/** Returns the cgroup v2 directory of the compositor, or NULL */
+static char *get_cgroup_dir(void) {
+	FILE *file = fopen("/proc/self/cgroup", "r");
+	if (!file) {
+		return NULL;
+	}
+
+	char *dir = NULL;
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t len;
+	while ((len = getline(&line, &line_size, file)) > 0) {
+		// The unified hierarchy has no controllers: "0::/path"
+		if (strncmp(line, "0::", 3) != 0) {
+			continue;
+		}
+		if (line[len - 1] == '\n') {
+			line[len - 1] = '\0';
+		}
+		// The root cgroup doesn't have memory.events or memory.pressure
+		if (strcmp(line + 3, "/") != 0) {
+			dir = g_build_filename("/sys/fs/cgroup", line + 3, NULL);
+		}
+		break;
+	}
+	free(line);
+	fclose(file);
+	return dir;
+}
+
+static int open_psi_trigger(const char *path) {
+	int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+
+	char trigger[64];
+	snprintf(trigger, sizeof(trigger), "some %d %d", MEMORY_PRESSURE_STALL_US,
+			 MEMORY_PRESSURE_WINDOW_US);
+	if (write(fd, trigger, strlen(trigger) + 1) < 0) {
+		wlr_log_errno(WLR_DEBUG, "Could not create a PSI trigger on %s", path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/** Returns true if memory.high has been hit since the last read */
+static bool read_high_events(struct comp_memory_pressure *pressure) {
+	char buffer[512];
+	ssize_t len = pread(pressure->events_fd, buffer, sizeof(buffer) - 1, 0);
+	if (len <= 0) {
+		return false;
+	}
+	buffer[len] = '\0';
+
+	const char *line = strncmp(buffer, "high ", 5) == 0
+						   ? buffer
+						   : strstr(buffer, "\nhigh ");
+	uint64_t high_events;
+	if (!line || sscanf(line, " high %" SCNu64, &high_events) != 1) {
+		return false;
+	}
+
+	bool hit = high_events > pressure->high_events;
+	pressure->high_events = high_events;
+	return hit;
+}
+
+static bool watch_fd(int epoll_fd, int fd) {
+	struct epoll_event event = {
+		.events = EPOLLPRI,
+		.data.fd = fd,
+	};
+	return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+static void close_psi_trigger(struct comp_memory_pressure *pressure) {
+	if (pressure->psi_source) {
+		wl_event_source_remove(pressure->psi_source);
+		pressure->psi_source = NULL;
+	}
+	if (pressure->psi_epoll_fd >= 0) {
+		close(pressure->psi_epoll_fd);
+		pressure->psi_epoll_fd = -1;
+	}
+	if (pressure->psi_fd >= 0) {
+		close(pressure->psi_fd);
+		pressure->psi_fd = -1;
+	}
+}
+
+/** Releases the memory, at most once per cooldown */
+static void pressure_release(struct comp_memory_pressure *pressure) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	bool released_before = pressure->last_release.tv_sec != 0 ||
+						   pressure->last_release.tv_nsec != 0;
+	if (released_before && timespec_diff_ms(&pressure->last_release, &now) <
+							   MEMORY_PRESSURE_COOLDOWN_MS) {
+		return;
+	}
+	comp_memory_pressure_release();
+}
+
+static int handle_epoll(int fd, uint32_t mask, void *data) {
+	struct comp_memory_pressure *pressure = data;
+
+	struct epoll_event event;
+	// kernfs files always signal EPOLLERR on changes, and keep signaling
+	// until read
+	if (epoll_wait(pressure->epoll_fd, &event, 1, 0) == 1 &&
+		read_high_events(pressure)) {
+		wlr_log(WLR_INFO, "Memory pressure: cgroup memory.high hit");
+		pressure_release(pressure);
+	}
+	return 0;
+}
+
+static int handle_psi(int fd, uint32_t mask, void *data) {
+	struct comp_memory_pressure *pressure = data;
+
+	// The event has already been consumed, only errors are still reported
+	struct epoll_event event;
+	if (epoll_wait(pressure->psi_epoll_fd, &event, 1, 0) == 1 &&
+		(event.events & EPOLLERR)) {
+		// The cgroup has been removed
+		wlr_log(WLR_ERROR, "PSI memory trigger stopped");
+		close_psi_trigger(pressure);
+		return 0;
+	}
+	wlr_log(WLR_INFO, "Memory pressure: PSI threshold exceeded");
+	pressure_release(pressure);
+	return 0;
+}
+
+static bool watch_psi_trigger(struct comp_memory_pressure *pressure) {
+	pressure->psi_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (pressure->psi_epoll_fd < 0 ||
+		!watch_fd(pressure->psi_epoll_fd, pressure->psi_fd)) {
+		return false;
+	}
+	pressure->psi_source =
+		wl_event_loop_add_fd(server.wl_event_loop, pressure->psi_epoll_fd,
+							 WL_EVENT_READABLE, handle_psi, pressure);
+	return pressure->psi_source != NULL;
+}
+
+static bool watch_high_events(struct comp_memory_pressure *pressure) {
+	pressure->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (pressure->epoll_fd < 0 ||
+		!watch_fd(pressure->epoll_fd, pressure->events_fd)) {
+		return false;
+	}
+	pressure->epoll_source =
+		wl_event_loop_add_fd(server.wl_event_loop, pressure->epoll_fd,
+							 WL_EVENT_READABLE, handle_epoll, pressure);
+	return pressure->epoll_source != NULL;
+}
+
+void comp_memory_pressure_init(void) {
+	struct comp_memory_pressure *pressure = &server.memory_pressure;
+	*pressure = (struct comp_memory_pressure){
+		.epoll_fd = -1,
+		.psi_fd = -1,
+		.psi_epoll_fd = -1,
+		.events_fd = -1,
+	};
+
+	// Prefer the pressure of our own cgroup, which includes being throttled
+	// by memory.high
+	char *cgroup_dir = get_cgroup_dir();
+	if (cgroup_dir) {
+		char *path = g_build_filename(cgroup_dir, "memory.pressure", NULL);
+		pressure->psi_fd = open_psi_trigger(path);
+		g_free(path);
+
+		path = g_build_filename(cgroup_dir, "memory.events", NULL);
+		pressure->events_fd = open(path, O_RDONLY | O_CLOEXEC);
+		g_free(path);
+		g_free(cgroup_dir);
+	}
+	if (pressure->psi_fd < 0) {
+		pressure->psi_fd = open_psi_trigger("/proc/pressure/memory");
+	}
+
+	if (pressure->psi_fd >= 0 && !watch_psi_trigger(pressure)) {
+		wlr_log_errno(WLR_ERROR, "Could not watch the PSI memory trigger");
+		close_psi_trigger(pressure);
+	}
+	if (pressure->events_fd >= 0) {
+		read_high_events(pressure);
+		if (!watch_high_events(pressure)) {
+			wlr_log_errno(WLR_ERROR, "Could not watch memory.events");
+			if (pressure->epoll_source) {
+				wl_event_source_remove(pressure->epoll_source);
+				pressure->epoll_source = NULL;
+			}
+			close(pressure->events_fd);
+			pressure->events_fd = -1;
+		}
+	}
+
+	if (pressure->psi_fd < 0 && pressure->events_fd < 0) {
+		wlr_log(WLR_INFO, "Memory pressure notifications unavailable");
+		comp_memory_pressure_finish();
+		return;
+	}
+	wlr_log(WLR_DEBUG, "Watching for memory pressure (PSI: %s, cgroup: %s)",
+			pressure->psi_fd >= 0 ? "yes" : "no",
+			pressure->events_fd >= 0 ? "yes" : "no");
+}
+
+void comp_memory_pressure_finish(void) {
+	struct comp_memory_pressure *pressure = &server.memory_pressure;
+	if (pressure->epoll_source) {
+		wl_event_source_remove(pressure->epoll_source);
+		pressure->epoll_source = NULL;
+	}
+	close_psi_trigger(pressure);
+	if (pressure->events_fd >= 0) {
+		close(pressure->events_fd);
+		pressure->events_fd = -1;
+	}
+	if (pressure->epoll_fd >= 0) {
+		close(pressure->epoll_fd);
+		pressure->epoll_fd = -1;
+	}
+}
+
+void comp_memory_pressure_release(void) {
+	struct comp_memory_pressure *pressure = &server.memory_pressure;
+	clock_gettime(CLOCK_MONOTONIC, &pressure->last_release);
+
+	struct comp_memory_usage before;
+	bool measured = comp_memory_usage_get(&before);
+
+	struct comp_output *output;
+	wl_list_for_each(output, &server.outputs, link) {
+		// The snapshots are on screen while switching
+		if (output->ws_switch.client->state == ANIMATION_STATE_NONE) {
+			struct comp_workspace *ws;
+			wl_list_for_each(ws, &output->workspaces, output_link) {
+				if (ws == output->active_workspace) {
+					comp_workspace_destroy_snapshot(ws);
+				} else {
+					comp_workspace_release_buffers(ws);
+				}
+			}
+		}
+
+		if (output->ws_indicator && !output->ws_indicator->visible) {
+			comp_widget_release_buffer(&output->ws_indicator->widget);
+		}
+	}
+
+	comp_icon_loader_release();
+	// Drops the cached fonts and glyphs, a new font map is created on demand
+	pango_cairo_font_map_set_default(NULL);
+	comp_slabs_shrink();
+#ifdef __GLIBC__
+	// Return the freed heap memory to the system
+	malloc_trim(0);
+#endif
+
+	struct comp_memory_usage after;
+	if (measured && comp_memory_usage_get(&after)) {
+		wlr_log(WLR_INFO, "Released %.1f MiB of buffers and the caches",
+				(double)(before.total - MIN(before.total, after.total)) /
+					(1024.0 * 1024.0));
+		comp_memory_usage_finish(&after);
+	}
+	if (measured) {
+		comp_memory_usage_finish(&before);
+	}
+}
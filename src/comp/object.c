@@ -1,19 +1,21 @@
 #include <scenefx/types/wlr_scene.h>
 #include <wlr/util/log.h>
 
+#include "comp/input_index.h"
 #include "comp/object.h"
 #include "comp/saved_object.h"
+#include "comp/trace.h"
 #include "util.h"
 
-struct comp_object *comp_object_at(struct comp_server *server, double lx,
-								   double ly, double *sx, double *sy,
-								   struct wlr_scene_buffer **scene_buffer,
-								   struct wlr_surface **surface) {
+static struct comp_object *object_at(struct comp_server *server, double lx,
+									 double ly, double *sx, double *sy,
+									 struct wlr_scene_buffer **scene_buffer,
+									 struct wlr_surface **surface) {
 	/* This returns the topmost node in the scene at the given layout coords.
 	 * We only care about surface nodes as we are specifically looking for a
 	 * surface in the surface tree of a comp_toplevel. */
 	struct wlr_scene_node *node =
-		wlr_scene_node_at(&server->root_scene->tree.node, lx, ly, sx, sy);
+		comp_input_index_node_at(&server->input_index, lx, ly, sx, sy);
 	if (node == NULL || node->type != WLR_SCENE_NODE_BUFFER) {
 		return NULL;
 	}
@@ -37,6 +39,17 @@ struct comp_object *comp_object_at(struct comp_server *server, double lx,
 	return current->data;
 }
 
+struct comp_object *comp_object_at(struct comp_server *server, double lx,
+								   double ly, double *sx, double *sy,
+								   struct wlr_scene_buffer **scene_buffer,
+								   struct wlr_surface **surface) {
+	const uint64_t trace_start = comp_trace_begin();
+	struct comp_object *object =
+		object_at(server, lx, ly, sx, sy, scene_buffer, surface);
+	comp_trace_end("comp_object_at", trace_start);
+	return object;
+}
+
 void comp_object_save_buffer(struct comp_object *object) {
 	// Thanks Sway for the simple implementation! :)
 	if (object->saved_tree) {
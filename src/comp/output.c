@@ -1,5 +1,5 @@
 #include <assert.h>
-#include <gtk-3.0/gtk/gtk.h>
+#include <glib.h>
 #include <scenefx/types/wlr_scene.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -16,18 +16,26 @@
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/log.h>
 
+#include "comp/animation_mgr.h"
+#include "comp/ipc.h"
 #include "comp/lock.h"
 #include "comp/object.h"
 #include "comp/output.h"
+#include "comp/overview.h"
 #include "comp/saved_object.h"
 #include "comp/server.h"
+#include "comp/startup_trace.h"
 #include "comp/tiling_node.h"
+#include "comp/trace.h"
+#include "comp/transaction.h"
 #include "comp/widget.h"
 #include "comp/workspace.h"
 #include "constants.h"
 #include "desktop/layer_shell.h"
 #include "desktop/toplevel.h"
 #include "desktop/widgets/workspace_indicator.h"
+#include "seat/cursor.h"
+#include "seat/latency.h"
 #include "seat/seat.h"
 #include "util.h"
 
@@ -69,12 +77,19 @@ struct comp_output *comp_output_by_name_or_id(const char *name_or_id) {
 struct comp_workspace *
 comp_output_new_workspace(struct comp_output *output,
 						  enum comp_workspace_type type) {
-	return comp_workspace_new(output, type);
+	struct comp_workspace *ws = comp_workspace_new(output, type);
+	if (ws) {
+		// Announced before it becomes the active workspace
+		comp_ipc_workspace_added(ws);
+		comp_output_focus_workspace(output, ws);
+	}
+	return ws;
 }
 
 void comp_output_remove_workspace(struct comp_output *output,
 								  struct comp_workspace *ws) {
-	if (!wl_list_empty(&ws->toplevels)) {
+	// Also keep the tiling slot of a dragged toplevel
+	if (!wl_list_empty(&ws->toplevels) || !wl_list_empty(&ws->tiling_nodes)) {
 		return;
 	}
 
@@ -87,6 +102,7 @@ void comp_output_remove_workspace(struct comp_output *output,
 	}
 
 	bool is_active = ws == output->active_workspace;
+	comp_ipc_workspace_removed(ws);
 	comp_workspace_destroy(ws);
 
 	if (is_active) {
@@ -316,18 +332,38 @@ static void output_frame(struct wl_listener *listener, void *data) {
 	if (!output->wlr_output->enabled) {
 		return;
 	}
+	const uint64_t trace_start = comp_trace_begin();
 
 	struct wlr_scene *scene = output->server->root_scene;
 	struct wlr_scene_output *scene_output =
 		wlr_scene_get_scene_output(scene, output->wlr_output);
 
+	// Apply the pointer motion of move/resize grabs once per frame
+	if (server.seat) {
+		comp_cursor_flush_grab_motion(server.seat->cursor);
+	}
+
+	uint64_t step_start = comp_trace_begin();
 	output_configure_scene(output, &server.root_scene->tree.node, false, NULL);
+	comp_trace_end("output_configure_scene", step_start);
+
 	/* Render the scene if needed and commit the output */
-	wlr_scene_output_commit(scene_output, NULL);
+	bool needs_frame = wlr_scene_output_needs_frame(scene_output);
+	step_start = comp_trace_begin();
+	bool committed = wlr_scene_output_commit(scene_output, NULL);
+	comp_trace_end("wlr_scene_output_commit", step_start);
 
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (committed && needs_frame) {
+		output->num_frames++;
+		output->last_frame = now;
+		comp_latency_output_rendered(output->wlr_output);
+		comp_startup_trace_output_frame(output);
+	}
+
 	wlr_scene_output_send_frame_done(scene_output, &now);
+	comp_trace_end("output_frame", trace_start);
 }
 
 static void output_request_state(struct wl_listener *listener, void *data) {
@@ -350,11 +386,14 @@ static void output_present(struct wl_listener *listener, void *data) {
 		return;
 	}
 
+	comp_latency_output_presented(output->wlr_output, output_event->when);
+
 	output->refresh_nsec = output_event->refresh;
 	output->refresh_sec = (float)output_event->refresh / NSEC_IN_SECONDS;
 }
 
 static void evacuate_workspaces(struct comp_output *output) {
+	comp_overview_exit(output);
 	if (wl_list_empty(&output->workspaces)) {
 		return;
 	}
@@ -373,12 +412,16 @@ static void evacuate_workspaces(struct comp_output *output) {
 	wlr_log(WLR_DEBUG, "Evacuating workspace to output '%s'",
 			dest_output->wlr_output->name);
 
+	// Move and arrange all of the workspaces in a single transaction
+	comp_transaction_batch_begin();
+
 	bool moved = false;
 	struct comp_workspace *workspace, *tmp_ws;
 	wl_list_for_each_reverse_safe(workspace, tmp_ws, &output->workspaces,
 								  output_link) {
 		// Ignore empty workspaces
-		if (!wl_list_empty(&workspace->toplevels)) {
+		if (!wl_list_empty(&workspace->toplevels) ||
+			!wl_list_empty(&workspace->tiling_nodes)) {
 			comp_output_move_workspace_to(dest_output, workspace);
 			moved = true;
 		}
@@ -392,6 +435,8 @@ static void evacuate_workspaces(struct comp_output *output) {
 		comp_output_focus_workspace(dest_output, last_ws);
 		wl_signal_emit_mutable(&output->events.ws_change, output);
 	}
+
+	comp_transaction_batch_end();
 }
 
 static void output_destroy(struct wl_listener *listener, void *data) {
@@ -406,17 +451,137 @@ static void output_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&output->present.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->link);
+	comp_ipc_output_removed(output);
 
 	wlr_scene_output_destroy(output->scene_output);
 	output->wlr_output->data = NULL;
 	output->wlr_output = NULL;
 	output->scene_output = NULL;
 
+	// The overview items live in the output tree
+	comp_overview_exit(output);
 	wlr_scene_node_destroy(&output->object.scene_tree->node);
 
+	comp_input_index_invalidate(&server.input_index);
+	comp_input_grid_finish(&output->input_grid);
+
+	comp_animation_client_destroy(output->ws_switch.client);
+
 	free(output);
 }
 
+/*
+ * Workspace switch animation
+ */
+
+static void ws_switch_animation_update(struct comp_animation_mgr *mgr,
+									   struct comp_animation_client *client) {
+	struct comp_output *output = client->data;
+	struct comp_workspace *from = output->ws_switch.from;
+	struct comp_workspace *to = output->ws_switch.to;
+	if (!from || !to || !from->snapshot || !to->snapshot) {
+		return;
+	}
+
+	// Only moves the snapshots, nothing needs to be re-rendered by the
+	// clients
+	const int width = output->geometry.width;
+	const int offset = width * ease_out_cubic(client->progress) *
+					   output->ws_switch.direction;
+	wlr_scene_node_set_position(&from->snapshot->node, -offset, 0);
+	wlr_scene_node_set_position(
+		&to->snapshot->node, width * output->ws_switch.direction - offset, 0);
+	comp_input_index_invalidate(&server.input_index);
+}
+
+static void ws_switch_animation_done(struct comp_animation_mgr *mgr,
+									 struct comp_animation_client *client,
+									 bool cancelled) {
+	struct comp_output *output = client->data;
+	struct comp_workspace *workspaces[] = {output->ws_switch.from,
+										   output->ws_switch.to};
+	for (size_t i = 0; i < sizeof(workspaces) / sizeof(*workspaces); i++) {
+		struct comp_workspace *ws = workspaces[i];
+		if (ws && ws->snapshot) {
+			wlr_scene_node_set_enabled(&ws->snapshot->node, false);
+			wlr_scene_node_set_position(&ws->snapshot->node, 0, 0);
+		}
+	}
+	output->ws_switch.from = NULL;
+	output->ws_switch.to = NULL;
+
+	// Show the real workspace again
+	if (output->active_workspace) {
+		wlr_scene_node_set_enabled(
+			&output->active_workspace->object.scene_tree->node, true);
+	}
+	comp_input_index_invalidate(&server.input_index);
+}
+
+static const struct comp_animation_client_impl ws_switch_animation_impl = {
+	.done = ws_switch_animation_done,
+	.update = ws_switch_animation_update,
+};
+
+static int get_workspace_index(struct comp_output *output,
+							   struct comp_workspace *ws) {
+	int index = 0;
+	struct comp_workspace *pos;
+	wl_list_for_each(pos, &output->workspaces, output_link) {
+		if (pos == ws) {
+			return index;
+		}
+		index++;
+	}
+	return -1;
+}
+
+void comp_output_cancel_workspace_switch(struct comp_output *output) {
+	if (output && output->ws_switch.client->state != ANIMATION_STATE_NONE) {
+		comp_animation_client_cancel(server.animation_mgr,
+									 output->ws_switch.client);
+	}
+}
+
+void comp_output_switch_workspace(struct comp_output *output,
+								  struct comp_workspace *ws) {
+	struct comp_workspace *from = output->active_workspace;
+	if (!from || from == ws || server.comp_session_lock.locked) {
+		comp_output_focus_workspace(output, ws);
+		return;
+	}
+	comp_output_cancel_workspace_switch(output);
+
+	// The outgoing workspace is visible, so always snapshot its current
+	// contents. The incoming one reuses its cached snapshot if it hasn't
+	// changed since.
+	from->snapshot_dirty = true;
+	struct wlr_scene_tree *from_snapshot = comp_workspace_get_snapshot(from);
+	struct wlr_scene_tree *to_snapshot = comp_workspace_get_snapshot(ws);
+
+	comp_output_focus_workspace(output, ws);
+	if (!from_snapshot || !to_snapshot) {
+		return;
+	}
+
+	output->ws_switch.from = from;
+	output->ws_switch.to = ws;
+	// The workspaces are stored in the reverse order
+	output->ws_switch.direction =
+		get_workspace_index(output, ws) < get_workspace_index(output, from)
+			? 1
+			: -1;
+
+	// Hide the real workspace until the animation is done
+	wlr_scene_node_set_enabled(&ws->object.scene_tree->node, false);
+	wlr_scene_node_set_enabled(&from_snapshot->node, true);
+	wlr_scene_node_set_enabled(&to_snapshot->node, true);
+	ws_switch_animation_update(server.animation_mgr, output->ws_switch.client);
+
+	comp_animation_client_add(server.animation_mgr, output->ws_switch.client,
+							  true);
+}
+
 struct comp_output *comp_output_create(struct comp_server *server,
 									   struct wlr_output *wlr_output) {
 	struct comp_output *output = calloc(1, sizeof(*output));
@@ -441,6 +606,9 @@ struct comp_output *comp_output_create(struct comp_server *server,
 	output->layers.optimized_blur_node = wlr_scene_optimized_blur_create(
 		output->object.content_tree, wlr_output->width, wlr_output->height);
 	output->layers.workspaces = alloc_tree(output->object.content_tree);
+	output->layers.workspace_switch =
+		alloc_tree(output->object.content_tree);
+	output->layers.overview = alloc_tree(output->object.content_tree);
 	output->layers.unmanaged = alloc_tree(output->object.content_tree);
 	output->layers.shell_top = alloc_tree(output->object.content_tree);
 	output->layers.shell_overlay = alloc_tree(output->object.content_tree);
@@ -450,6 +618,14 @@ struct comp_output *comp_output_create(struct comp_server *server,
 	wlr_scene_node_set_enabled(&output->layers.optimized_blur_node->node,
 							   false);
 
+	output->ws_switch.client = comp_animation_client_init(
+		server->animation_mgr, WORKSPACE_SWITCH_ANIMATION_DURATION_MS,
+		&ws_switch_animation_impl, output);
+	if (!output->ws_switch.client) {
+		wlr_log(WLR_ERROR, "Could not allocate workspace switch animation");
+		abort();
+	}
+
 	wl_list_init(&output->workspaces);
 
 	wl_list_insert(&server->outputs, &output->link);
@@ -503,6 +679,10 @@ void comp_new_output(struct wl_listener *listener, void *data) {
 		server->active_output = output;
 	}
 
+	if (server->seat) {
+		comp_cursor_load_scale(server->seat->cursor, wlr_output->scale);
+	}
+
 	/*
 	 * Workspaces
 	 */
@@ -517,6 +697,8 @@ void comp_new_output(struct wl_listener *listener, void *data) {
 				output->wlr_output->name);
 		abort();
 	}
+	// Start on the first one, with the second one as the previous workspace
+	comp_output_focus_workspace(output, second_ws);
 	comp_output_focus_workspace(output, first_ws);
 
 	output->ws_indicator = comp_ws_indicator_init(server, output);
@@ -563,6 +745,8 @@ void comp_new_output(struct wl_listener *listener, void *data) {
 	if (server->comp_session_lock.locked) {
 		comp_session_lock_add_output(wlr_output);
 	}
+
+	comp_ipc_output_added(output);
 }
 
 void comp_output_disable(struct comp_output *output) {
@@ -621,9 +805,15 @@ void comp_output_move_workspace_to(struct comp_output *dest_output,
 
 	// Remove from previous output
 	if (ws->output) {
+		// The overview would keep items of the moved toplevels
+		comp_overview_exit(ws->output);
+		comp_output_cancel_workspace_switch(ws->output);
+		comp_ipc_workspace_removed(ws);
 		wl_list_remove(&ws->output_link);
 		ws->output = NULL;
 	}
+	// The snapshot lives in the tree of the previous output
+	comp_workspace_destroy_snapshot(ws);
 
 	// Add to the new output
 	wlr_scene_node_reparent(&ws->object.scene_tree->node,
@@ -633,6 +823,7 @@ void comp_output_move_workspace_to(struct comp_output *dest_output,
 	ws->output = dest_output;
 
 	wl_list_insert(&dest_output->workspaces, &ws->output_link);
+	comp_ipc_workspace_added(ws);
 	wl_signal_emit_mutable(&dest_output->events.ws_change, dest_output);
 }
 
@@ -640,6 +831,9 @@ void comp_output_focus_workspace(struct comp_output *output,
 								 struct comp_workspace *ws) {
 	assert(ws);
 
+	comp_output_cancel_workspace_switch(output);
+	comp_overview_exit(output);
+
 	// Disable the previous workspace
 	if (output->active_workspace) {
 		wlr_scene_node_set_enabled(
@@ -649,6 +843,7 @@ void comp_output_focus_workspace(struct comp_output *output,
 
 	// Enable the active workspace
 	output->active_workspace = ws;
+	comp_workspace_restore_buffers(ws);
 
 	// Make sure that all other workspaces are disabled
 	struct comp_workspace *workspace;
@@ -669,6 +864,7 @@ void comp_output_focus_workspace(struct comp_output *output,
 	}
 
 	wl_signal_emit_mutable(&output->events.ws_change, output);
+	comp_ipc_workspace_changed(output);
 }
 
 enum workspace_dir {
@@ -725,6 +921,9 @@ struct comp_workspace *comp_output_next_workspace(struct comp_output *output,
  */
 
 void comp_output_arrange_output(struct comp_output *output) {
+	// Workspaces and layers might have been enabled or disabled
+	comp_input_index_invalidate(&server.input_index);
+
 	// Center Workspace Switcher
 	if (output->ws_indicator) {
 		comp_widget_center_on_output(&output->ws_indicator->widget, output);
@@ -769,6 +968,9 @@ void comp_output_arrange_output(struct comp_output *output) {
 	wlr_scene_node_set_enabled(&output->layers.optimized_blur_node->node,
 							   !is_fullscreen && !is_locked);
 	wlr_scene_node_set_enabled(&output->layers.workspaces->node, !is_locked);
+	wlr_scene_node_set_enabled(&output->layers.workspace_switch->node,
+							   !is_locked);
+	wlr_scene_node_set_enabled(&output->layers.overview->node, !is_locked);
 	wlr_scene_node_set_enabled(&output->layers.shell_top->node,
 							   !is_fullscreen && !is_locked);
 	wlr_scene_node_set_enabled(&output->layers.shell_overlay->node, !is_locked);
@@ -809,6 +1011,9 @@ void comp_output_arrange_layers(struct comp_output *output) {
 									&usable_area.height);
 	const struct wlr_box full_area = usable_area;
 
+	// Mapped, unmapped or moved layer surfaces
+	comp_input_index_invalidate(&server.input_index);
+
 	arrange_layer_surfaces(output, &full_area, &usable_area,
 						   output->layers.shell_background);
 	arrange_layer_surfaces(output, &full_area, &usable_area,
@@ -0,0 +1,480 @@
+#include <glib.h>
+#include <scenefx/types/wlr_scene.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/types/wlr_subcompositor.h>
+#include <wlr/util/log.h>
+#include <xkbcommon/xkbcommon-keysyms.h>
+
+#include "comp/output.h"
+#include "comp/overview.h"
+#include "comp/server.h"
+#include "comp/tiling_layout.h"
+#include "comp/workspace.h"
+#include "constants.h"
+#include "desktop/toplevel.h"
+#include "seat/seat.h"
+#include "util.h"
+
+/*
+ * Items
+ */
+
+static void part_destroy(struct comp_overview_part *part) {
+	listener_remove(&part->commit);
+	listener_remove(&part->destroy);
+	listener_remove(&part->frame_done);
+	wl_list_remove(&part->link);
+	wlr_scene_node_destroy(&part->scene_buffer->node);
+	free(part);
+}
+
+static void item_destroy(struct comp_overview_item *item) {
+	struct comp_overview_part *part, *tmp;
+	wl_list_for_each_safe(part, tmp, &item->parts, link) {
+		part_destroy(part);
+	}
+	wl_list_remove(&item->link);
+	wlr_scene_node_destroy(&item->tree->node);
+	free(item);
+}
+
+/**
+ * Shows the surface at the main surface relative x and y, cropped to the
+ * geometry of the toplevel to skip client side shadows
+ */
+static void part_update(struct comp_overview_part *part, int x, int y) {
+	struct comp_overview_item *item = part->item;
+	struct wlr_surface *surface = part->surface;
+	struct wlr_scene_buffer *scene_buffer = part->scene_buffer;
+
+	struct wlr_box geometry = comp_toplevel_get_geometry(item->toplevel);
+	struct wlr_box box = {
+		.x = x,
+		.y = y,
+		.width = surface->current.width,
+		.height = surface->current.height,
+	};
+	struct wlr_box visible;
+	if (!surface->mapped || !surface->buffer ||
+		!wlr_box_intersection(&visible, &geometry, &box)) {
+		wlr_scene_node_set_enabled(&scene_buffer->node, false);
+		wlr_scene_buffer_set_buffer(scene_buffer, NULL);
+		return;
+	}
+
+	// Reuses the client's buffer, so the thumbnail is always live without
+	// sending any configures
+	struct wlr_buffer *buffer = &surface->buffer->base;
+	wlr_scene_buffer_set_buffer_with_damage(scene_buffer, buffer,
+											&surface->buffer_damage);
+	wlr_scene_buffer_set_transform(scene_buffer, surface->current.transform);
+
+	struct wlr_fbox src_box = {0};
+	if (surface->current.transform == WL_OUTPUT_TRANSFORM_NORMAL) {
+		// Also covers the buffer scale and viewport destination size
+		const double scale_x = (double)buffer->width / box.width;
+		const double scale_y = (double)buffer->height / box.height;
+		src_box.x = (visible.x - box.x) * scale_x;
+		src_box.y = (visible.y - box.y) * scale_y;
+		src_box.width = visible.width * scale_x;
+		src_box.height = visible.height * scale_y;
+	} else {
+		// Don't bother cropping rotated buffers
+		visible = box;
+	}
+	wlr_scene_buffer_set_source_box(scene_buffer, &src_box);
+
+	wlr_scene_node_set_position(&scene_buffer->node,
+								(visible.x - geometry.x) * item->scale,
+								(visible.y - geometry.y) * item->scale);
+	wlr_scene_buffer_set_dest_size(scene_buffer,
+								   MAX(visible.width * item->scale, 1),
+								   MAX(visible.height * item->scale, 1));
+	wlr_scene_node_set_enabled(&scene_buffer->node, true);
+}
+
+static void item_sync(struct comp_overview_item *item);
+
+static void part_handle_commit(struct wl_listener *listener, void *data) {
+	struct comp_overview_part *part =
+		wl_container_of(listener, part, commit);
+	// Might've mapped, moved or added subsurfaces
+	item_sync(part->item);
+}
+
+static void part_handle_destroy(struct wl_listener *listener, void *data) {
+	struct comp_overview_part *part =
+		wl_container_of(listener, part, destroy);
+	if (part->surface == part->item->surface) {
+		item_destroy(part->item);
+	} else {
+		part_destroy(part);
+	}
+}
+
+static void part_handle_frame_done(struct wl_listener *listener, void *data) {
+	struct comp_overview_part *part =
+		wl_container_of(listener, part, frame_done);
+	struct timespec *when = data;
+	// The real surface is hidden, so keep the client drawing
+	wlr_surface_send_frame_done(part->surface, when);
+}
+
+static struct comp_overview_part *part_create(struct comp_overview_item *item,
+											  struct wlr_surface *surface) {
+	struct comp_overview_part *part = calloc(1, sizeof(*part));
+	if (!part) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_overview_part");
+		return NULL;
+	}
+	part->item = item;
+	part->surface = surface;
+
+	part->scene_buffer = wlr_scene_buffer_create(item->tree, NULL);
+	if (!part->scene_buffer) {
+		wlr_log(WLR_ERROR, "Could not allocate overview scene buffer");
+		free(part);
+		return NULL;
+	}
+
+	listener_connect_init(&surface->events.commit, &part->commit,
+						  part_handle_commit);
+	listener_connect_init(&surface->events.destroy, &part->destroy,
+						  part_handle_destroy);
+	listener_connect_init(&part->scene_buffer->events.frame_done,
+						  &part->frame_done, part_handle_frame_done);
+	return part;
+}
+
+/**
+ * Moves the part of the surface into the synced list in stacking order. Also
+ * keeps parts for unmapped subsurfaces so that their commit maps them.
+ */
+static void item_sync_surface(struct comp_overview_item *item,
+							  struct wl_list *synced,
+							  struct wlr_surface *surface, int x, int y) {
+	struct wlr_subsurface *subsurface;
+	wl_list_for_each(subsurface, &surface->current.subsurfaces_below,
+					 current.link) {
+		item_sync_surface(item, synced, subsurface->surface,
+						  x + subsurface->current.x, y + subsurface->current.y);
+	}
+
+	struct comp_overview_part *part = NULL, *iter;
+	wl_list_for_each(iter, &item->parts, link) {
+		if (iter->surface == surface) {
+			part = iter;
+			break;
+		}
+	}
+	if (part) {
+		wl_list_remove(&part->link);
+	} else {
+		part = part_create(item, surface);
+	}
+	if (part) {
+		wl_list_insert(synced->prev, &part->link);
+		wlr_scene_node_raise_to_top(&part->scene_buffer->node);
+		part_update(part, x, y);
+	}
+
+	wl_list_for_each(subsurface, &surface->current.subsurfaces_above,
+					 current.link) {
+		item_sync_surface(item, synced, subsurface->surface,
+						  x + subsurface->current.x, y + subsurface->current.y);
+	}
+}
+
+/** Matches the parts to the current subsurface tree */
+static void item_sync(struct comp_overview_item *item) {
+	struct wl_list synced;
+	wl_list_init(&synced);
+	item_sync_surface(item, &synced, item->surface, 0, 0);
+
+	// The rest were detached from the tree
+	struct comp_overview_part *part, *tmp;
+	wl_list_for_each_safe(part, tmp, &item->parts, link) {
+		part_destroy(part);
+	}
+	wl_list_insert_list(&item->parts, &synced);
+}
+
+static struct comp_overview_item *item_create(struct comp_overview *overview,
+											  struct comp_toplevel *toplevel,
+											  struct wlr_surface *surface) {
+	struct comp_overview_item *item = calloc(1, sizeof(*item));
+	if (!item) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_overview_item");
+		return NULL;
+	}
+	item->overview = overview;
+	item->toplevel = toplevel;
+	item->surface = surface;
+	item->scale = 1.0;
+	wl_list_init(&item->parts);
+
+	item->tree = alloc_tree(overview->tree);
+	if (!item->tree) {
+		free(item);
+		return NULL;
+	}
+	// Shown once arranged
+	wlr_scene_node_set_enabled(&item->tree->node, false);
+
+	wl_list_insert(overview->items.prev, &item->link);
+	item_sync(item);
+	return item;
+}
+
+/*
+ * Overview
+ */
+
+/** Places the thumbnails in a grid, keeping the aspect ratio of each one */
+static void overview_arrange(struct comp_overview *overview) {
+	size_t count = wl_list_length(&overview->items);
+	if (count == 0) {
+		return;
+	}
+
+	struct wlr_box *boxes = calloc(count, sizeof(*boxes));
+	if (!boxes) {
+		wlr_log(WLR_ERROR, "Could not allocate overview boxes");
+		return;
+	}
+
+	struct wlr_box area = overview->output->usable_area;
+	area.x += OVERVIEW_PADDING;
+	area.y += OVERVIEW_PADDING;
+	area.width -= OVERVIEW_PADDING * 2;
+	area.height -= OVERVIEW_PADDING * 2;
+	struct comp_tiling_params params;
+	comp_tiling_params_init(&params);
+	comp_tiling_layout_get_impl(COMP_TILING_LAYOUT_GRID)
+		->arrange(&area, &params, count, boxes);
+
+	size_t i = 0;
+	struct comp_overview_item *item;
+	wl_list_for_each(item, &overview->items, link) {
+		struct wlr_box cell = boxes[i++];
+		cell.x += OVERVIEW_PADDING / 2;
+		cell.y += OVERVIEW_PADDING / 2;
+		cell.width -= OVERVIEW_PADDING;
+		cell.height -= OVERVIEW_PADDING;
+
+		struct wlr_box geometry = comp_toplevel_get_geometry(item->toplevel);
+		if (geometry.width <= 0 || geometry.height <= 0 || cell.width <= 0 ||
+			cell.height <= 0) {
+			wlr_scene_node_set_enabled(&item->tree->node, false);
+			continue;
+		}
+
+		// Never scale up
+		item->scale = MIN(MIN((double)cell.width / geometry.width,
+							  (double)cell.height / geometry.height),
+						  1.0);
+		item->box.width = MAX(geometry.width * item->scale, 1);
+		item->box.height = MAX(geometry.height * item->scale, 1);
+		item->box.x = cell.x + (cell.width - item->box.width) / 2;
+		item->box.y = cell.y + (cell.height - item->box.height) / 2;
+
+		wlr_scene_node_set_position(&item->tree->node, item->box.x,
+									item->box.y);
+		wlr_scene_node_set_enabled(&item->tree->node, true);
+		item_sync(item);
+	}
+	comp_input_index_invalidate(&server.input_index);
+
+	free(boxes);
+}
+
+static void overview_enter(struct comp_output *output) {
+	struct comp_workspace *ws = output->active_workspace;
+	if (!ws || server.comp_session_lock.locked) {
+		return;
+	}
+	comp_output_cancel_workspace_switch(output);
+
+	struct comp_overview *overview = calloc(1, sizeof(*overview));
+	if (!overview) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_overview");
+		return;
+	}
+	overview->output = output;
+	overview->workspace = ws;
+	wl_list_init(&overview->items);
+
+	overview->tree = alloc_tree(output->layers.overview);
+	if (!overview->tree) {
+		free(overview);
+		return;
+	}
+
+	// A plain dim instead of blur to keep the overview cheap to render
+	struct wlr_render_color color = wlr_render_color_from_color(
+		&(const uint32_t){OVERVIEW_COLOR_BACKGROUND});
+	// The scene expects premultiplied colors
+	overview->background = wlr_scene_rect_create(
+		overview->tree, output->geometry.width, output->geometry.height,
+		(float[4]){color.r * color.a, color.g * color.a, color.b * color.a,
+				   color.a});
+	if (!overview->background) {
+		wlr_log(WLR_ERROR, "Could not allocate overview background");
+		wlr_scene_node_destroy(&overview->tree->node);
+		free(overview);
+		return;
+	}
+
+	// Most recently focused first
+	struct comp_toplevel *toplevel;
+	wl_list_for_each(toplevel, &ws->toplevels, workspace_link) {
+		struct wlr_surface *surface;
+		if (toplevel->unmapped || toplevel->minimized ||
+			!(surface = comp_toplevel_get_wlr_surface(toplevel))) {
+			continue;
+		}
+		item_create(overview, toplevel, surface);
+	}
+	overview_arrange(overview);
+
+	// Hide the workspace, which also skips its blur and shadows
+	wlr_scene_node_set_enabled(&ws->object.scene_tree->node, false);
+
+	output->overview = overview;
+
+	// Keys shouldn't reach clients that can't be seen. Focus changes while
+	// the overview is shown only reorder the toplevels, see
+	// comp_seat_surface_focus.
+	struct wlr_seat *wlr_seat = server.seat->wlr_seat;
+	struct wlr_surface *focused = wlr_seat->keyboard_state.focused_surface;
+	if (focused && comp_toplevel_from_wlr_surface(focused)) {
+		comp_seat_surface_unfocus(focused, false);
+		wlr_seat_keyboard_notify_clear_focus(wlr_seat);
+	}
+}
+
+/** Exits the overview and gives the keyboard back to a toplevel */
+static void overview_leave(struct comp_output *output,
+						   struct comp_toplevel *toplevel) {
+	struct comp_workspace *ws = output->overview->workspace;
+	comp_overview_exit(output);
+
+	if (!toplevel && ws == output->active_workspace) {
+		toplevel = comp_workspace_get_latest_focused(ws);
+	}
+	if (toplevel) {
+		comp_seat_surface_focus(&toplevel->object,
+								comp_toplevel_get_wlr_surface(toplevel));
+	}
+}
+
+void comp_overview_exit(struct comp_output *output) {
+	struct comp_overview *overview = output->overview;
+	if (!overview) {
+		return;
+	}
+	output->overview = NULL;
+
+	struct comp_overview_item *item, *tmp;
+	wl_list_for_each_safe(item, tmp, &overview->items, link) {
+		item_destroy(item);
+	}
+	wlr_scene_node_destroy(&overview->tree->node);
+
+	struct comp_workspace *ws = overview->workspace;
+	if (ws == output->active_workspace) {
+		wlr_scene_node_set_enabled(&ws->object.scene_tree->node, true);
+	}
+	comp_input_index_invalidate(&server.input_index);
+
+	free(overview);
+}
+
+void comp_overview_toggle(struct comp_output *output) {
+	if (output->overview) {
+		overview_leave(output, NULL);
+	} else {
+		overview_enter(output);
+	}
+}
+
+void comp_overview_toplevel_add(struct comp_toplevel *toplevel) {
+	struct comp_output *output = toplevel->workspace->output;
+	struct comp_overview *overview = output ? output->overview : NULL;
+	struct wlr_surface *surface;
+	if (!overview || overview->workspace != toplevel->workspace ||
+		toplevel->minimized || toplevel->object.destroying ||
+		!(surface = comp_toplevel_get_wlr_surface(toplevel))) {
+		return;
+	}
+
+	struct comp_overview_item *item;
+	wl_list_for_each(item, &overview->items, link) {
+		if (item->toplevel == toplevel) {
+			return;
+		}
+	}
+	if (!(item = item_create(overview, toplevel, surface))) {
+		return;
+	}
+	// Most recently focused first
+	wl_list_remove(&item->link);
+	wl_list_insert(&overview->items, &item->link);
+	overview_arrange(overview);
+}
+
+void comp_overview_toplevel_remove(struct comp_toplevel *toplevel) {
+	struct comp_output *output;
+	wl_list_for_each(output, &server.outputs, link) {
+		struct comp_overview *overview = output->overview;
+		if (!overview) {
+			continue;
+		}
+
+		bool removed = false;
+		struct comp_overview_item *item, *tmp;
+		wl_list_for_each_safe(item, tmp, &overview->items, link) {
+			if (item->toplevel == toplevel) {
+				item_destroy(item);
+				removed = true;
+			}
+		}
+		if (removed) {
+			overview_arrange(overview);
+		}
+	}
+}
+
+bool comp_overview_click(struct comp_output *output, double x, double y) {
+	struct comp_overview *overview = output->overview;
+	if (!overview) {
+		return false;
+	}
+
+	struct comp_toplevel *toplevel = NULL;
+	struct comp_overview_item *item;
+	wl_list_for_each(item, &overview->items, link) {
+		if (item->tree->node.enabled &&
+			wlr_box_contains_point(&item->box, x, y)) {
+			toplevel = item->toplevel;
+			break;
+		}
+	}
+
+	overview_leave(output, toplevel);
+	return true;
+}
+
+bool comp_overview_handle_key(struct comp_output *output, xkb_keysym_t sym) {
+	if (!output || !output->overview) {
+		return false;
+	}
+	if (sym == XKB_KEY_Escape) {
+		overview_leave(output, NULL);
+	}
+	return true;
+}
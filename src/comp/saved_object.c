@@ -2,10 +2,12 @@
 #include <wlr/util/log.h>
 
 #include "comp/saved_object.h"
+#include "comp/server.h"
 
 struct comp_saved_object *
 comp_saved_object_init(struct comp_object *save_object) {
-	struct comp_saved_object *saved = calloc(1, sizeof(*saved));
+	struct comp_saved_object *saved =
+		comp_slab_alloc(&server.slabs.saved_objects);
 	if (!saved) {
 		wlr_log(WLR_ERROR, "Could not allocate comp_saved_object");
 		return NULL;
@@ -25,5 +27,5 @@ comp_saved_object_init(struct comp_object *save_object) {
 }
 
 void comp_saved_object_destroy(struct comp_saved_object *saved_object) {
-	free(saved_object);
+	comp_slab_free(&server.slabs.saved_objects, saved_object);
 }
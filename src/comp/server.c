@@ -3,7 +3,6 @@
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output_management_v1.h>
 #include <wlr/types/wlr_output_swapchain_manager.h>
-#include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/util/log.h>
 
 #include "comp/lock.h"
@@ -67,6 +66,9 @@ static void server_update_monitors(struct comp_server *server) {
 
 	comp_session_lock_arrange();
 
+	// The output geometry might have changed
+	comp_input_index_invalidate(&server->input_index);
+
 	wlr_output_manager_v1_set_configuration(server->output_manager,
 											output_config);
 }
@@ -117,8 +119,7 @@ apply_resolved_output_configs(struct wlr_output_configuration_head_v1 *configs,
 			}
 			wlr_output_state_set_transform(state, head->state.transform);
 			wlr_output_state_set_scale(state, head->state.scale);
-			wlr_xcursor_manager_load(server.seat->cursor->cursor_mgr,
-									 head->state.scale);
+			comp_cursor_load_scale(server.seat->cursor, head->state.scale);
 			wlr_output_state_set_adaptive_sync_enabled(
 				state, head->state.adaptive_sync_enabled);
 		}
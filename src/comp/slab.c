@@ -0,0 +1,206 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/util/log.h>
+
+#include "comp/animation_mgr.h"
+#include "comp/saved_object.h"
+#include "comp/server.h"
+#include "comp/slab.h"
+#include "constants.h"
+#include "desktop/toplevel.h"
+#include "desktop/widgets/resize_edge.h"
+#include "desktop/widgets/titlebar.h"
+
+static struct comp_slab_page *page_create(struct comp_slab *slab) {
+	struct comp_slab_page *page =
+		malloc(sizeof(*page) + slab->object_size * SLAB_OBJECTS_PER_PAGE);
+	if (!page) {
+		wlr_log(WLR_ERROR, "Could not allocate %s slab page", slab->name);
+		return NULL;
+	}
+	page->used = 0;
+
+	// Link the objects front to back
+	page->free_list = NULL;
+	for (size_t i = SLAB_OBJECTS_PER_PAGE; i > 0; i--) {
+		void **object = (void **)(page->objects + (i - 1) * slab->object_size);
+		*object = page->free_list;
+		page->free_list = object;
+	}
+
+	wl_list_insert(&slab->pages, &page->link);
+	slab->num_pages++;
+	slab->num_empty_pages++;
+	return page;
+}
+
+static void page_destroy(struct comp_slab *slab, struct comp_slab_page *page) {
+	wl_list_remove(&page->link);
+	slab->num_pages--;
+	if (page->used == 0) {
+		slab->num_empty_pages--;
+	}
+	free(page);
+}
+
+static bool page_contains(struct comp_slab *slab, struct comp_slab_page *page,
+						  void *object) {
+	const unsigned char *ptr = object;
+	return ptr >= page->objects &&
+		   ptr < page->objects + slab->object_size * SLAB_OBJECTS_PER_PAGE;
+}
+
+void comp_slab_init(struct comp_slab *slab, const char *name,
+					size_t object_size) {
+	slab->name = name;
+	// Keep every object aligned, and large enough to hold the free list link
+	const size_t align = _Alignof(max_align_t);
+	if (object_size < sizeof(void *)) {
+		object_size = sizeof(void *);
+	}
+	slab->object_size = (object_size + align - 1) / align * align;
+
+	wl_list_init(&slab->pages);
+	slab->num_empty_pages = 0;
+	slab->live = 0;
+	slab->peak = 0;
+	slab->num_pages = 0;
+}
+
+void comp_slab_finish(struct comp_slab *slab) {
+	if (slab->live > 0) {
+		wlr_log(WLR_ERROR, "Leaked %zu %s", slab->live, slab->name);
+	}
+
+	struct comp_slab_page *page, *tmp;
+	wl_list_for_each_safe(page, tmp, &slab->pages, link) {
+		page_destroy(slab, page);
+	}
+	slab->live = 0;
+}
+
+void *comp_slab_alloc(struct comp_slab *slab) {
+	// Fill the partially used pages first, so that the empty page stays empty
+	struct comp_slab_page *page = NULL, *empty = NULL, *iter;
+	wl_list_for_each(iter, &slab->pages, link) {
+		if (iter->used == 0) {
+			empty = iter;
+		} else if (iter->free_list) {
+			page = iter;
+			break;
+		}
+	}
+	if (!page && !(page = empty) && !(page = page_create(slab))) {
+		return NULL;
+	}
+
+	void **object = page->free_list;
+	page->free_list = *object;
+	if (page->used++ == 0) {
+		slab->num_empty_pages--;
+	}
+
+	slab->live++;
+	if (slab->live > slab->peak) {
+		slab->peak = slab->live;
+	}
+
+	memset(object, 0, slab->object_size);
+	return object;
+}
+
+void comp_slab_free(struct comp_slab *slab, void *object) {
+	if (!object) {
+		return;
+	}
+
+	struct comp_slab_page *page;
+	wl_list_for_each(page, &slab->pages, link) {
+		if (!page_contains(slab, page, object)) {
+			continue;
+		}
+
+		*(void **)object = page->free_list;
+		page->free_list = object;
+		page->used--;
+		slab->live--;
+
+		// Keep one empty page around for the next toplevel
+		if (page->used == 0 && ++slab->num_empty_pages > 1) {
+			page_destroy(slab, page);
+		}
+		return;
+	}
+
+	wlr_log(WLR_ERROR, "Freed %p which isn't part of the %s slab", object,
+			slab->name);
+	abort();
+}
+
+void comp_slab_shrink(struct comp_slab *slab) {
+	struct comp_slab_page *page, *tmp;
+	wl_list_for_each_safe(page, tmp, &slab->pages, link) {
+		if (page->used == 0) {
+			page_destroy(slab, page);
+		}
+	}
+}
+
+/*
+ * Server slabs
+ */
+
+struct comp_slab *comp_slabs_get(size_t i) {
+	struct comp_slab *slabs[] = {
+		&server.slabs.toplevels,
+		&server.slabs.animation_clients,
+		&server.slabs.saved_objects,
+		&server.slabs.titlebars,
+		&server.slabs.resize_edges,
+	};
+	return i < sizeof(slabs) / sizeof(*slabs) ? slabs[i] : NULL;
+}
+
+void comp_slabs_init(void) {
+	comp_slab_init(&server.slabs.toplevels, "toplevels",
+				   sizeof(struct comp_toplevel));
+	comp_slab_init(&server.slabs.animation_clients, "animation clients",
+				   sizeof(struct comp_animation_client));
+	comp_slab_init(&server.slabs.saved_objects, "saved objects",
+				   sizeof(struct comp_saved_object));
+	comp_slab_init(&server.slabs.titlebars, "titlebars",
+				   sizeof(struct comp_titlebar));
+	comp_slab_init(&server.slabs.resize_edges, "resize edges",
+				   sizeof(struct comp_resize_edge));
+}
+
+void comp_slabs_finish(void) {
+	struct comp_slab *slab;
+	for (size_t i = 0; (slab = comp_slabs_get(i)); i++) {
+		comp_slab_finish(slab);
+	}
+}
+
+void comp_slabs_shrink(void) {
+	struct comp_slab *slab;
+	for (size_t i = 0; (slab = comp_slabs_get(i)); i++) {
+		comp_slab_shrink(slab);
+	}
+}
+
+void comp_slabs_report(void) {
+	printf("Live compositor objects:\n");
+	struct comp_slab *slab;
+	for (size_t i = 0; (slab = comp_slabs_get(i)); i++) {
+		printf("  %-20s live: %4zu  peak: %4zu  pages: %2zu (%zu bytes)\n",
+			   slab->name, slab->live, slab->peak, slab->num_pages,
+			   slab->num_pages *
+				   (sizeof(struct comp_slab_page) +
+					slab->object_size * SLAB_OBJECTS_PER_PAGE));
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,213 @@
+#define _GNU_SOURCE // for POSIX_SPAWN_SETSID
+
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/util/log.h>
+
+#include "comp/server.h"
+#include "comp/spawn.h"
+#include "constants.h"
+#include "desktop/toplevel.h"
+
+static double timespec_diff_ms(const struct timespec *start,
+							   const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 +
+		   (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void process_destroy(struct comp_spawned_process *process) {
+	wl_list_remove(&process->link);
+	if (process->pidfd_source) {
+		wl_event_source_remove(process->pidfd_source);
+	}
+	if (process->pidfd >= 0) {
+		close(process->pidfd);
+	}
+	free(process->cmd);
+	free(process);
+}
+
+/** Returns false if the process is still running */
+static bool process_reap(struct comp_spawned_process *process) {
+	int status;
+	pid_t pid = waitpid(process->pid, &status, WNOHANG);
+	if (pid == 0 || (pid < 0 && errno == EINTR)) {
+		return false;
+	}
+
+	if (pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+		wlr_log(WLR_INFO, "'%s' exited with status %d", process->cmd,
+				WEXITSTATUS(status));
+	}
+	process_destroy(process);
+	return true;
+}
+
+static int handle_pidfd(int fd, uint32_t mask, void *data) {
+	struct comp_spawned_process *process = data;
+	// Readable once the process has exited
+	process_reap(process);
+	return 0;
+}
+
+/** Fallback for kernels without pidfd_open (< 5.3) */
+static int handle_sigchld(int signal_number, void *data) {
+	struct comp_spawned_process *process, *tmp;
+	wl_list_for_each_safe(process, tmp, &server.spawn.processes, link) {
+		if (process->pidfd < 0) {
+			process_reap(process);
+		}
+	}
+	return 0;
+}
+
+static bool process_watch(struct comp_spawned_process *process) {
+#ifdef SYS_pidfd_open
+	process->pidfd = syscall(SYS_pidfd_open, process->pid, 0);
+#endif
+	if (process->pidfd >= 0) {
+		process->pidfd_source =
+			wl_event_loop_add_fd(server.wl_event_loop, process->pidfd,
+								 WL_EVENT_READABLE, handle_pidfd, process);
+		if (process->pidfd_source) {
+			return true;
+		}
+		close(process->pidfd);
+		process->pidfd = -1;
+	}
+
+	if (!server.spawn.sigchld_source) {
+		wlr_log(WLR_DEBUG, "pidfd_open unsupported, reaping on SIGCHLD");
+		server.spawn.sigchld_source = wl_event_loop_add_signal(
+			server.wl_event_loop, SIGCHLD, handle_sigchld, NULL);
+		if (!server.spawn.sigchld_source) {
+			wlr_log(WLR_ERROR, "Could not watch SIGCHLD");
+			return false;
+		}
+	}
+	// The process might have exited before the signal was watched
+	handle_sigchld(SIGCHLD, NULL);
+	return true;
+}
+
+/** Walks up the parents, as `sh -c` might not exec the command directly */
+static bool is_descendant(pid_t pid, pid_t ancestor) {
+	for (int depth = 0; pid > 1 && depth < SPAWN_MAX_PARENT_DEPTH; depth++) {
+		if (pid == ancestor) {
+			return true;
+		}
+
+		char path[64];
+		snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+		FILE *file = fopen(path, "r");
+		if (!file) {
+			return false;
+		}
+		// The comm field can contain spaces and parentheses
+		char buffer[512];
+		size_t len = fread(buffer, 1, sizeof(buffer) - 1, file);
+		fclose(file);
+		buffer[len] = '\0';
+		char *comm_end = strrchr(buffer, ')');
+		if (!comm_end || sscanf(comm_end + 1, " %*c %d", &pid) != 1) {
+			return false;
+		}
+	}
+	return false;
+}
+
+void comp_spawn_init(void) {
+	wl_list_init(&server.spawn.processes);
+	server.spawn.sigchld_source = NULL;
+}
+
+void comp_spawn_finish(void) {
+	struct comp_spawned_process *process, *tmp;
+	wl_list_for_each_safe(process, tmp, &server.spawn.processes, link) {
+		process_destroy(process);
+	}
+	if (server.spawn.sigchld_source) {
+		wl_event_source_remove(server.spawn.sigchld_source);
+		server.spawn.sigchld_source = NULL;
+	}
+}
+
+bool comp_spawn(const char *cmd) {
+	struct comp_spawned_process *process = calloc(1, sizeof(*process));
+	if (!process) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_spawned_process");
+		return false;
+	}
+	process->pidfd = -1;
+	process->cmd = strdup(cmd);
+	if (!process->cmd) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_spawned_process");
+		free(process);
+		return false;
+	}
+
+	// Reset the signal state of the compositor in the child
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	sigset_t set;
+	sigemptyset(&set);
+	posix_spawnattr_setsigmask(&attr, &set);
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	sigaddset(&set, SIGCHLD);
+	posix_spawnattr_setsigdefault(&attr, &set);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID |
+										POSIX_SPAWN_SETSIGMASK |
+										POSIX_SPAWN_SETSIGDEF);
+
+	// glibc implements posix_spawn with CLONE_VFORK, so the page tables of
+	// the compositor are never copied
+	char *const argv[] = {"sh", "-c", process->cmd, NULL};
+	clock_gettime(CLOCK_MONOTONIC, &process->spawned);
+	int err = posix_spawnp(&process->pid, "sh", NULL, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+	if (err != 0) {
+		wlr_log(WLR_ERROR, "Could not spawn '%s': %s", cmd, strerror(err));
+		free(process->cmd);
+		free(process);
+		return false;
+	}
+
+	wl_list_insert(&server.spawn.processes, &process->link);
+	wlr_log(WLR_DEBUG, "Spawned '%s' (pid %d)", cmd, process->pid);
+	if (!process_watch(process)) {
+		// Can't be reaped, but keep tracking the launch
+		wlr_log(WLR_ERROR, "Could not watch pid %d", process->pid);
+	}
+	return true;
+}
+
+void comp_spawn_toplevel_map(struct comp_toplevel *toplevel) {
+	if (toplevel->pid <= 0) {
+		return;
+	}
+
+	struct comp_spawned_process *process;
+	wl_list_for_each(process, &server.spawn.processes, link) {
+		if (process->mapped || !is_descendant(toplevel->pid, process->pid)) {
+			continue;
+		}
+
+		process->mapped = true;
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		wlr_log(WLR_INFO, "'%s' mapped its first toplevel after %.1fms",
+				process->cmd, timespec_diff_ms(&process->spawned, &now));
+		return;
+	}
+}
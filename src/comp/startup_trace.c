@@ -0,0 +1,293 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+#include "comp/output.h"
+#include "comp/server.h"
+#include "comp/startup_trace.h"
+#include "constants.h"
+#include "desktop/toplevel.h"
+
+static double timespec_diff_ms(const struct timespec *start,
+							   const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 +
+		   (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static struct comp_startup_event *add_event(struct comp_startup_trace *trace,
+											enum comp_startup_event_type type,
+											const char *name) {
+	if (trace->num_events >= STARTUP_TRACE_MAX_EVENTS) {
+		wlr_log(WLR_DEBUG, "Startup trace is full, dropping %s", name);
+		return NULL;
+	}
+
+	struct comp_startup_event *event = &trace->events[trace->num_events++];
+	event->type = type;
+	snprintf(event->name, sizeof(event->name), "%s", name);
+	clock_gettime(CLOCK_MONOTONIC, &event->end);
+	event->start = event->end;
+	return event;
+}
+
+static bool has_event(struct comp_startup_trace *trace, const char *name) {
+	for (size_t i = 0; i < trace->num_events; i++) {
+		if (strcmp(trace->events[i].name, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void add_milestone(struct comp_startup_trace *trace, const char *fmt,
+						  const char *arg) {
+	char name[sizeof(trace->events[0].name)];
+	snprintf(name, sizeof(name), fmt, arg);
+	if (!has_event(trace, name)) {
+		add_event(trace, COMP_STARTUP_EVENT_MILESTONE, name);
+	}
+}
+
+/** The output has presented its first frame, not counting the fallback */
+static bool output_has_framed(struct comp_startup_trace *trace,
+							  struct comp_output *output) {
+	char name[sizeof(trace->events[0].name)];
+	snprintf(name, sizeof(name), "first-frame %s", output->wlr_output->name);
+	return has_event(trace, name);
+}
+
+static void check_done(struct comp_startup_trace *trace) {
+	if (!trace->running || trace->reported) {
+		return;
+	}
+	if (trace->wait_for_map && !trace->mapped) {
+		return;
+	}
+
+	bool has_outputs = false;
+	struct comp_output *output;
+	wl_list_for_each(output, &server.outputs, link) {
+		if (output == server.fallback_output || !output->wlr_output->enabled) {
+			continue;
+		}
+		if (!output_has_framed(trace, output)) {
+			return;
+		}
+		has_outputs = true;
+	}
+	if (!has_outputs) {
+		return;
+	}
+
+	trace->complete = true;
+	comp_startup_trace_report(trace);
+	if (trace->exit_when_done) {
+		wl_display_terminate(server.wl_display);
+	}
+}
+
+static void handle_loop_idle(void *data) {
+	struct comp_startup_trace *trace = data;
+	trace->loop_idle = NULL;
+	trace->running = true;
+	add_event(trace, COMP_STARTUP_EVENT_MILESTONE, "event-loop");
+	check_done(trace);
+}
+
+static int handle_timeout(void *data) {
+	struct comp_startup_trace *trace = data;
+	wlr_log(WLR_ERROR, "Startup trace timed out after %dms",
+			STARTUP_TRACE_TIMEOUT_MS);
+	comp_startup_trace_report(trace);
+	if (trace->exit_when_done) {
+		wl_display_terminate(server.wl_display);
+	}
+	return 0;
+}
+
+struct comp_startup_trace *comp_startup_trace_create(bool wait_for_map,
+													 bool exit_when_done) {
+	struct comp_startup_trace *trace = calloc(1, sizeof(*trace));
+	if (!trace) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_startup_trace");
+		return NULL;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &trace->start);
+	trace->last_phase_end = trace->start;
+	trace->wait_for_map = wait_for_map;
+	trace->exit_when_done = exit_when_done;
+	return trace;
+}
+
+void comp_startup_trace_destroy(struct comp_startup_trace *trace) {
+	if (trace->loop_idle) {
+		wl_event_source_remove(trace->loop_idle);
+	}
+	if (trace->timeout) {
+		wl_event_source_remove(trace->timeout);
+	}
+	free(trace);
+}
+
+void comp_startup_trace_phase(const char *name) {
+	struct comp_startup_trace *trace = server.startup_trace;
+	if (!trace) {
+		return;
+	}
+
+	struct comp_startup_event *event =
+		add_event(trace, COMP_STARTUP_EVENT_PHASE, name);
+	if (event) {
+		event->start = trace->last_phase_end;
+		trace->last_phase_end = event->end;
+	}
+}
+
+void comp_startup_trace_run(void) {
+	struct comp_startup_trace *trace = server.startup_trace;
+	if (!trace) {
+		return;
+	}
+
+	// Dispatched once the event loop is running
+	trace->loop_idle =
+		wl_event_loop_add_idle(server.wl_event_loop, handle_loop_idle, trace);
+	trace->timeout =
+		wl_event_loop_add_timer(server.wl_event_loop, handle_timeout, trace);
+	if (!trace->loop_idle || !trace->timeout) {
+		wlr_log(WLR_ERROR, "Could not start the startup trace");
+		return;
+	}
+	wl_event_source_timer_update(trace->timeout, STARTUP_TRACE_TIMEOUT_MS);
+}
+
+void comp_startup_trace_output_frame(struct comp_output *output) {
+	struct comp_startup_trace *trace = server.startup_trace;
+	if (!trace || trace->reported || output == server.fallback_output) {
+		return;
+	}
+
+	add_milestone(trace, "first-frame %s", output->wlr_output->name);
+	check_done(trace);
+}
+
+void comp_startup_trace_toplevel_map(struct comp_toplevel *toplevel) {
+	struct comp_startup_trace *trace = server.startup_trace;
+	if (!trace || trace->reported || trace->mapped) {
+		return;
+	}
+
+	trace->mapped = true;
+	char *app_id = comp_toplevel_get_app_id(toplevel);
+	add_milestone(trace, "first-map %s", app_id ? app_id : "unknown");
+	check_done(trace);
+}
+
+/*
+ * Report
+ */
+
+static void print_waterfall(struct comp_startup_trace *trace,
+							double total_ms) {
+	printf("Startup trace (%.3fms total):\n", total_ms);
+	for (size_t i = 0; i < trace->num_events; i++) {
+		struct comp_startup_event *event = &trace->events[i];
+		const double start_ms = timespec_diff_ms(&trace->start, &event->start);
+		const double end_ms = timespec_diff_ms(&trace->start, &event->end);
+
+		char bar[STARTUP_TRACE_WATERFALL_WIDTH + 1];
+		memset(bar, ' ', STARTUP_TRACE_WATERFALL_WIDTH);
+		bar[STARTUP_TRACE_WATERFALL_WIDTH] = '\0';
+		const int last = STARTUP_TRACE_WATERFALL_WIDTH - 1;
+		int from = total_ms > 0 ? start_ms / total_ms * last : 0;
+		int to = total_ms > 0 ? end_ms / total_ms * last : 0;
+		for (int x = from; x <= to && x <= last; x++) {
+			bar[x] = event->type == COMP_STARTUP_EVENT_PHASE ? '#' : '|';
+		}
+
+		if (event->type == COMP_STARTUP_EVENT_PHASE) {
+			printf("  %-28s %9.3fms %9.3fms  [%s]\n", event->name, start_ms,
+				   end_ms - start_ms, bar);
+		} else {
+			printf("  %-28s %9.3fms %11s  [%s]\n", event->name, end_ms, "",
+				   bar);
+		}
+	}
+	if (!trace->complete) {
+		printf("  (incomplete: still waiting for the first frames)\n");
+	}
+	fflush(stdout);
+}
+
+static void write_json(struct comp_startup_trace *trace, double total_ms) {
+	json_object *root = json_object_new_object();
+	json_object_object_add(root, "complete",
+						   json_object_new_boolean(trace->complete));
+	json_object_object_add(root, "total_ms", json_object_new_double(total_ms));
+
+	json_object *phases = json_object_new_array();
+	json_object *milestones = json_object_new_array();
+	for (size_t i = 0; i < trace->num_events; i++) {
+		struct comp_startup_event *event = &trace->events[i];
+		const double start_ms = timespec_diff_ms(&trace->start, &event->start);
+		const double end_ms = timespec_diff_ms(&trace->start, &event->end);
+
+		json_object *object = json_object_new_object();
+		json_object_object_add(object, "name",
+							   json_object_new_string(event->name));
+		if (event->type == COMP_STARTUP_EVENT_PHASE) {
+			json_object_object_add(object, "start_ms",
+								   json_object_new_double(start_ms));
+			json_object_object_add(object, "duration_ms",
+								   json_object_new_double(end_ms - start_ms));
+			json_object_array_add(phases, object);
+		} else {
+			json_object_object_add(object, "time_ms",
+								   json_object_new_double(end_ms));
+			json_object_array_add(milestones, object);
+		}
+	}
+	json_object_object_add(root, "phases", phases);
+	json_object_object_add(root, "milestones", milestones);
+
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/%s", dir ? dir : "/tmp",
+			 STARTUP_TRACE_JSON_NAME);
+	if (json_object_to_file_ext(path, root, JSON_C_TO_STRING_PRETTY) != 0) {
+		wlr_log(WLR_ERROR, "Could not write the startup trace to %s", path);
+	} else {
+		printf("Startup trace written to %s\n", path);
+		fflush(stdout);
+	}
+	json_object_put(root);
+}
+
+void comp_startup_trace_report(struct comp_startup_trace *trace) {
+	if (trace->reported) {
+		return;
+	}
+
+	double total_ms = 0;
+	for (size_t i = 0; i < trace->num_events; i++) {
+		const double end_ms =
+			timespec_diff_ms(&trace->start, &trace->events[i].end);
+		total_ms = end_ms > total_ms ? end_ms : total_ms;
+	}
+
+	print_waterfall(trace, total_ms);
+	write_json(trace, total_ms);
+	trace->reported = true;
+
+	if (trace->timeout) {
+		wl_event_source_remove(trace->timeout);
+		trace->timeout = NULL;
+	}
+}
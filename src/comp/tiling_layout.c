@@ -0,0 +1,119 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <wlr/util/box.h>
+
+#include "comp/tiling_layout.h"
+#include "constants.h"
+
+/** Splits the length into `count` parts without any leftover pixels */
+static void split_span(int start, int length, size_t count, size_t index,
+					   int *out_start, int *out_length) {
+	int part_start = start + (long)length * index / count;
+	int part_end = start + (long)length * (index + 1) / count;
+	*out_start = part_start;
+	*out_length = part_end - part_start;
+}
+
+/*
+ * Master/Stack
+ */
+
+static void master_stack_arrange(const struct wlr_box *area,
+								 const struct comp_tiling_params *params,
+								 size_t count, struct wlr_box *boxes) {
+	if (count == 1) {
+		boxes[0] = *area;
+		return;
+	}
+
+	int master_width = area->width * params->master_ratio;
+	boxes[0] = (struct wlr_box){
+		.x = area->x,
+		.y = area->y,
+		.width = master_width,
+		.height = area->height,
+	};
+
+	// The rest are stacked on top of each other
+	size_t stack_count = count - 1;
+	for (size_t i = 0; i < stack_count; i++) {
+		struct wlr_box *box = &boxes[i + 1];
+		box->x = area->x + master_width;
+		box->width = area->width - master_width;
+		split_span(area->y, area->height, stack_count, i, &box->y,
+				   &box->height);
+	}
+}
+
+/*
+ * Columns
+ */
+
+static void columns_arrange(const struct wlr_box *area,
+							const struct comp_tiling_params *params,
+							size_t count, struct wlr_box *boxes) {
+	for (size_t i = 0; i < count; i++) {
+		struct wlr_box *box = &boxes[i];
+		split_span(area->x, area->width, count, i, &box->x, &box->width);
+		box->y = area->y;
+		box->height = area->height;
+	}
+}
+
+/*
+ * Grid
+ */
+
+static void grid_arrange(const struct wlr_box *area,
+						 const struct comp_tiling_params *params, size_t count,
+						 struct wlr_box *boxes) {
+	size_t cols = ceil(sqrt(count));
+	size_t rows = (count + cols - 1) / cols;
+
+	for (size_t i = 0; i < count; i++) {
+		size_t row = i / cols;
+		size_t col = i % cols;
+		// Stretch the items in the last row to fill the width
+		size_t row_count = row == rows - 1 ? count - row * cols : cols;
+
+		struct wlr_box *box = &boxes[i];
+		split_span(area->x, area->width, row_count, col, &box->x, &box->width);
+		split_span(area->y, area->height, rows, row, &box->y, &box->height);
+	}
+}
+
+static const struct comp_tiling_layout_impl
+	layouts[COMP_TILING_LAYOUT_COUNT] = {
+	[COMP_TILING_LAYOUT_BSP] = {.name = "bsp", .arrange = NULL},
+	[COMP_TILING_LAYOUT_MASTER_STACK] = {.name = "master-stack",
+										 .arrange = master_stack_arrange},
+	[COMP_TILING_LAYOUT_COLUMNS] = {.name = "columns",
+									.arrange = columns_arrange},
+	[COMP_TILING_LAYOUT_GRID] = {.name = "grid", .arrange = grid_arrange},
+};
+
+const struct comp_tiling_layout_impl *
+comp_tiling_layout_get_impl(enum comp_tiling_layout_type type) {
+	return &layouts[type];
+}
+
+bool comp_tiling_layout_from_name(const char *name,
+								  enum comp_tiling_layout_type *type) {
+	for (int i = 0; i < COMP_TILING_LAYOUT_COUNT; i++) {
+		if (strcmp(layouts[i].name, name) == 0) {
+			*type = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void comp_tiling_params_init(struct comp_tiling_params *params) {
+	*params = (struct comp_tiling_params){
+		.master_ratio = TILING_SPLIT_RATIO,
+		.gaps_inner = TILING_GAPS_INNER,
+		.gaps_outer = TILING_GAPS_OUTER,
+	};
+}
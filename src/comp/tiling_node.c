@@ -1,5 +1,5 @@
-#include <assert.h>
 #include <pixman.h>
+#include <scenefx/types/wlr_scene.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,56 +11,51 @@
 #include "comp/animation_mgr.h"
 #include "comp/output.h"
 #include "comp/server.h"
+#include "comp/tiling_layout.h"
 #include "comp/tiling_node.h"
 #include "comp/transaction.h"
 #include "comp/workspace.h"
 #include "constants.h"
 #include "desktop/toplevel.h"
 #include "seat/seat.h"
+#include "util.h"
 
 static void tiling_node_destroy(struct tiling_node *node) {
 	if (node->toplevel) {
 		node->toplevel->tiling_node = NULL;
 	}
+	if (node->ws->tiling_root == node) {
+		node->ws->tiling_root = NULL;
+	}
 
 	wl_list_remove(&node->parent_link);
 
 	free(node);
 }
 
-static inline struct tiling_node *get_root_node(struct comp_workspace *ws) {
-	struct tiling_node *node;
-	wl_list_for_each(node, &ws->tiling_nodes, parent_link) {
-		if (!node->parent) {
-			return node;
-		}
-	}
-
-	return NULL;
-}
-
 static struct wlr_box get_final_tiling_toplevel_size(struct tiling_node *node) {
 	struct comp_toplevel *toplevel = node->toplevel;
 	struct tiling_node *container = toplevel->tiling_node;
 
+	const int GAPS = container->ws->tiling_params.gaps_inner;
 	const int WIDTH_OFFSET = BORDER_WIDTH * 2;
 	const int HEIGHT_OFFSET =
 		BORDER_WIDTH * 2 + toplevel->decorated_size.top_border_height;
 
 	return (struct wlr_box){
-		.width = container->box.width - WIDTH_OFFSET - TILING_GAPS_INNER * 2,
-		.height = container->box.height - HEIGHT_OFFSET - TILING_GAPS_INNER * 2,
-		.x = container->box.x + BORDER_WIDTH + TILING_GAPS_INNER,
+		.width = container->box.width - WIDTH_OFFSET - GAPS * 2,
+		.height = container->box.height - HEIGHT_OFFSET - GAPS * 2,
+		.x = container->box.x + BORDER_WIDTH + GAPS,
 		.y = container->box.y + toplevel->decorated_size.top_border_height +
-			 TILING_GAPS_INNER,
+			 GAPS,
 	};
 }
 
 static void apply_node_data_to_toplevel(struct tiling_node *node) {
-	if (node->is_node) {
+	if (node->is_node || !node->toplevel) {
+		// Nodes and the slots of dragged toplevels
 		return;
 	}
-	assert(node->toplevel);
 
 	struct comp_toplevel *toplevel = node->toplevel;
 	struct wlr_box box = get_final_tiling_toplevel_size(node);
@@ -96,44 +91,134 @@ static void apply_node_data_to_toplevel(struct tiling_node *node) {
 	}
 }
 
-static void calc_size_pos_recursive(struct tiling_node *node, bool update) {
-	if (node->children[0]) {
-		if (!node->split_vertical) {
-			const float split_width = node->box.width * node->split_ratio;
-			node->children[0]->box = (struct wlr_box){
-				.width = split_width,
-				.height = node->box.height,
-				.x = node->box.x,
-				.y = node->box.y,
-			};
-			node->children[1]->box = (struct wlr_box){
-				.width = node->box.width - split_width,
-				.height = node->box.height,
-				.x = node->box.x + split_width,
-				.y = node->box.y,
-			};
-		} else {
-			const float split_height = node->box.height * node->split_ratio;
-			node->children[0]->box = (struct wlr_box){
-				.width = node->box.width,
-				.height = split_height,
-				.x = node->box.x,
-				.y = node->box.y,
-			};
-			node->children[1]->box = (struct wlr_box){
-				.width = node->box.width,
-				.height = node->box.height - split_height,
-				.x = node->box.x,
-				.y = node->box.y + split_height,
-			};
-		}
+/** The gapless area of the workspace available for tiling */
+static struct wlr_box get_tiling_area(struct comp_workspace *ws) {
+	struct comp_output *output = ws->output;
+	const int GAPS = ws->tiling_params.gaps_outer;
+	return (struct wlr_box){
+		.width = output->usable_area.width - GAPS * 2,
+		.height = output->usable_area.height - GAPS * 2,
+		.x = output->usable_area.x + GAPS,
+		.y = output->usable_area.y + GAPS,
+	};
+}
+
+static void set_node_box(struct tiling_node *node, const struct wlr_box *box);
 
-		calc_size_pos_recursive(node->children[0], update);
-		calc_size_pos_recursive(node->children[1], update);
-	} else if (update) {
+/** Lays out the children of the node, skipping the unchanged subtrees */
+static void layout_node(struct tiling_node *node) {
+	node->dirty = false;
+	if (!node->is_node) {
 		// Toplevel
 		apply_node_data_to_toplevel(node);
+		return;
+	}
+
+	struct wlr_box boxes[2];
+	if (!node->split_vertical) {
+		const float split_width = node->box.width * node->split_ratio;
+		boxes[0] = (struct wlr_box){
+			.width = split_width,
+			.height = node->box.height,
+			.x = node->box.x,
+			.y = node->box.y,
+		};
+		boxes[1] = (struct wlr_box){
+			.width = node->box.width - split_width,
+			.height = node->box.height,
+			.x = node->box.x + split_width,
+			.y = node->box.y,
+		};
+	} else {
+		const float split_height = node->box.height * node->split_ratio;
+		boxes[0] = (struct wlr_box){
+			.width = node->box.width,
+			.height = split_height,
+			.x = node->box.x,
+			.y = node->box.y,
+		};
+		boxes[1] = (struct wlr_box){
+			.width = node->box.width,
+			.height = node->box.height - split_height,
+			.x = node->box.x,
+			.y = node->box.y + split_height,
+		};
 	}
+
+	set_node_box(node->children[0], &boxes[0]);
+	set_node_box(node->children[1], &boxes[1]);
+}
+
+static void set_node_box(struct tiling_node *node, const struct wlr_box *box) {
+	if (!node->dirty && wlr_box_equal(&node->box, box)) {
+		// Nothing in this subtree has changed
+		return;
+	}
+	node->box = *box;
+	layout_node(node);
+}
+
+void tiling_node_mark_dirty(struct tiling_node *node) {
+	// New nodes start out dirty without their ancestors, so always walk up
+	for (; node; node = node->parent) {
+		node->dirty = true;
+	}
+}
+
+static bool collect_leaves(struct tiling_node *node, struct wl_array *leaves) {
+	if (node->is_node) {
+		node->dirty = false;
+		return collect_leaves(node->children[0], leaves) &&
+			   collect_leaves(node->children[1], leaves);
+	}
+
+	struct tiling_node **leaf = wl_array_add(leaves, sizeof(*leaf));
+	if (!leaf) {
+		wlr_log(WLR_ERROR, "Could not allocate tiling leaf");
+		return false;
+	}
+	*leaf = node;
+	return true;
+}
+
+/**
+ * Computes all leaf boxes with the layout engine, then only configures the
+ * toplevels whose box has changed
+ */
+static void arrange_leaves(struct comp_workspace *ws,
+						   const struct comp_tiling_layout_impl *impl,
+						   const struct wlr_box *area) {
+	struct wl_array leaves;
+	wl_array_init(&leaves);
+	if (!collect_leaves(ws->tiling_root, &leaves)) {
+		wl_array_release(&leaves);
+		return;
+	}
+
+	size_t count = leaves.size / sizeof(struct tiling_node *);
+	struct wlr_box *boxes = calloc(count, sizeof(*boxes));
+	if (!boxes) {
+		wlr_log(WLR_ERROR, "Could not allocate tiling boxes");
+		wl_array_release(&leaves);
+		return;
+	}
+	impl->arrange(area, &ws->tiling_params, count, boxes);
+
+	size_t i = 0;
+	struct tiling_node **leaf;
+	wl_array_for_each(leaf, &leaves) {
+		struct tiling_node *node = *leaf;
+		// Dirty leaves are applied even if their box stays the same
+		if (node->dirty || !wlr_box_equal(&node->box, &boxes[i])) {
+			node->box = boxes[i];
+			apply_node_data_to_toplevel(node);
+		}
+		node->dirty = false;
+		i++;
+	}
+
+	free(boxes);
+	wl_array_release(&leaves);
 }
 
 void tiling_node_mark_workspace_dirty(struct comp_workspace *workspace) {
@@ -145,16 +230,18 @@ void tiling_node_mark_workspace_dirty(struct comp_workspace *workspace) {
 		return;
 	}
 
-	struct tiling_node *root = get_root_node(workspace);
-	if (root) {
-		struct comp_output *output = workspace->output;
-		root->box = (struct wlr_box){
-			.width = output->usable_area.width - TILING_GAPS_OUTER * 2,
-			.height = output->usable_area.height - TILING_GAPS_OUTER * 2,
-			.x = output->usable_area.x + TILING_GAPS_OUTER,
-			.y = output->usable_area.y + TILING_GAPS_OUTER,
-		};
-		calc_size_pos_recursive(root, true);
+	struct tiling_node *root = workspace->tiling_root;
+	if (!root) {
+		return;
+	}
+
+	struct wlr_box area = get_tiling_area(workspace);
+	const struct comp_tiling_layout_impl *impl =
+		comp_tiling_layout_get_impl(workspace->tiling_layout);
+	if (impl->arrange) {
+		arrange_leaves(workspace, impl, &area);
+	} else {
+		set_node_box(root, &area);
 	}
 }
 
@@ -199,13 +286,16 @@ too_small:
 	return false;
 }
 
-void tiling_node_add_toplevel(struct comp_toplevel *toplevel,
-							  const bool insert_floating) {
-	toplevel->tiling_node = tiling_node_init(toplevel->workspace, false);
-	struct tiling_node *container = toplevel->tiling_node;
-	container->toplevel = toplevel;
-
-	bool split_first = false;
+/**
+ * Gets the leaf which the toplevel would be split from. Prefers the leaf
+ * beneath the center point if `insert_floating` is set.
+ */
+static struct tiling_node *get_insert_parent(struct comp_toplevel *toplevel,
+											 const bool insert_floating,
+											 const int center_x,
+											 const int center_y,
+											 bool *split_first) {
+	*split_first = false;
 
 	// Try to get parent node
 	struct comp_workspace *ws = toplevel->workspace;
@@ -213,11 +303,6 @@ void tiling_node_add_toplevel(struct comp_toplevel *toplevel,
 	if (insert_floating) {
 		// Get the tiling node beneath the floating toplevel.
 		// Check if any toplevel intersects the center point of the toplevel.
-		const int center_x =
-			toplevel->state.x + (toplevel->decorated_size.width * 0.5);
-		const int center_y =
-			toplevel->state.y + (toplevel->decorated_size.height * 0.5);
-
 		pixman_region32_t region1; // Top/left region
 		pixman_region32_init(&region1);
 		pixman_region32_t region2; // Bottom/right region
@@ -252,13 +337,13 @@ void tiling_node_add_toplevel(struct comp_toplevel *toplevel,
 											   NULL)) {
 				// Insert as parent to node
 				parent_node = n;
-				split_first = true;
+				*split_first = true;
 				break;
 			} else if (pixman_region32_contains_point(&region2, center_x,
 													  center_y, NULL)) {
 				// Insert as child to node
 				parent_node = n;
-				split_first = false;
+				*split_first = false;
 				break;
 			}
 		}
@@ -285,20 +370,33 @@ void tiling_node_add_toplevel(struct comp_toplevel *toplevel,
 		}
 	}
 
+	return parent_node;
+}
+
+void tiling_node_add_toplevel(struct comp_toplevel *toplevel,
+							  const bool insert_floating) {
+	toplevel->tiling_node = tiling_node_init(toplevel->workspace, false);
+	struct tiling_node *container = toplevel->tiling_node;
+	container->toplevel = toplevel;
+
+	struct comp_workspace *ws = toplevel->workspace;
+	bool split_first = false;
+	struct tiling_node *parent_node = get_insert_parent(
+		toplevel, insert_floating,
+		toplevel->state.x + (toplevel->decorated_size.width * 0.5),
+		toplevel->state.y + (toplevel->decorated_size.height * 0.5),
+		&split_first);
+
 	if (!parent_node) {
 		// No tiled nodes, don't split first node
-		struct comp_output *output = toplevel->workspace->output;
-		container->box = (struct wlr_box){
-			.width = output->usable_area.width - TILING_GAPS_OUTER * 2,
-			.height = output->usable_area.height - TILING_GAPS_OUTER * 2,
-			.x = output->usable_area.x + TILING_GAPS_OUTER,
-			.y = output->usable_area.y + TILING_GAPS_OUTER,
-		};
+		container->box = get_tiling_area(toplevel->workspace);
+
+		ws->tiling_root = container;
 
 		// Don't tile if the tiling container size exceeds the min/max toplevel
 		// size
 		if (is_size_compatible(toplevel, container)) {
-			apply_node_data_to_toplevel(container);
+			layout_node(container);
 		} else {
 			comp_toplevel_set_tiled(toplevel, false, true);
 		}
@@ -326,6 +424,8 @@ void tiling_node_add_toplevel(struct comp_toplevel *toplevel,
 		} else {
 			parent_node->parent->children[1] = new_parent;
 		}
+	} else {
+		ws->tiling_root = new_parent;
 	}
 
 	// Update
@@ -368,23 +468,21 @@ void tiling_node_add_toplevel(struct comp_toplevel *toplevel,
 		return;
 	}
 
-	calc_size_pos_recursive(new_parent, true);
-
+	// The boxes above are only estimates for the size check, lay out both
+	// halves of the split
+	tiling_node_mark_dirty(parent_node);
+	tiling_node_mark_dirty(container);
 	tiling_node_mark_workspace_dirty(toplevel->workspace);
 }
 
-void tiling_node_remove_toplevel(struct comp_toplevel *toplevel) {
-	struct tiling_node *node = toplevel->tiling_node;
-	if (!node) {
-		return;
-	}
-
+static void remove_node(struct tiling_node *node) {
 	struct tiling_node *parent = node->parent;
 	if (!parent) {
 		tiling_node_destroy(node);
 		return;
 	}
 
+	struct comp_workspace *ws = node->ws;
 	struct tiling_node *sibling =
 		parent->children[0] == node ? parent->children[1] : parent->children[0];
 	sibling->box = parent->box;
@@ -398,48 +496,42 @@ void tiling_node_remove_toplevel(struct comp_toplevel *toplevel) {
 		}
 	}
 
-	if (sibling->parent) {
-		calc_size_pos_recursive(sibling->parent, true);
-	} else {
-		calc_size_pos_recursive(sibling, true);
-	}
-
 	tiling_node_destroy(node->parent);
 	tiling_node_destroy(node);
-}
 
-void tiling_node_resize_start(struct comp_toplevel *toplevel) {
-	struct tiling_node *node = toplevel->tiling_node;
-	clock_gettime(CLOCK_MONOTONIC, &node->time);
-}
-
-void tiling_node_resize_fini(struct comp_toplevel *toplevel) {
+	if (!sibling->parent) {
+		ws->tiling_root = sibling;
+	}
+	// Expand the sibling into the freed space
+	tiling_node_mark_dirty(sibling);
+	tiling_node_mark_workspace_dirty(ws);
 }
 
-/** Only render each 16.667ms */
-static bool can_update(struct comp_toplevel *toplevel) {
+void tiling_node_remove_toplevel(struct comp_toplevel *toplevel) {
 	struct tiling_node *node = toplevel->tiling_node;
-
-	float ms = 16.667;
-	struct comp_workspace *ws = toplevel->workspace;
-	if (ws && ws->output && ws->output != server.fallback_output) {
-		ms = ws->output->refresh_sec * 1000;
+	if (!node) {
+		return;
 	}
 
-	struct timespec now;
-	clock_gettime(CLOCK_MONOTONIC, &now);
-
-	struct timespec *start = &node->time;
-	const float DELTA = (now.tv_sec - start->tv_sec) * 1000 +
-						(now.tv_nsec - start->tv_nsec) / 1000000.0;
-
-	if (DELTA < ms) {
-		return false;
+	if (toplevel->dragging_tiled && !toplevel->tiling_drag_node) {
+		// Keep the slot until the toplevel is dropped, so that the other
+		// tiled toplevels aren't re-laid out during the drag
+		node->toplevel = NULL;
+		toplevel->tiling_node = NULL;
+		toplevel->tiling_drag_node = node;
+		return;
 	}
 
-	clock_gettime(CLOCK_MONOTONIC, &node->time);
+	remove_node(node);
+}
 
-	return true;
+void tiling_node_resize_start(struct comp_toplevel *toplevel) {
+	struct comp_seat *seat = server.seat;
+	seat->resize_cursor_x = seat->cursor->wlr_cursor->x;
+	seat->resize_cursor_y = seat->cursor->wlr_cursor->y;
+}
+
+void tiling_node_resize_fini(struct comp_toplevel *toplevel) {
 }
 
 void tiling_node_resize(struct comp_toplevel *toplevel) {
@@ -451,14 +543,37 @@ void tiling_node_resize(struct comp_toplevel *toplevel) {
 	struct wlr_box box = node->box;
 	struct wlr_box usable_area = toplevel->workspace->output->usable_area;
 
+	// The motion is coalesced per frame, so use the distance since the last
+	// step instead of the last pointer event
 	const double delta_x =
-		(seat->cursor->wlr_cursor->x - seat->cursor->previous.x);
+		seat->cursor->wlr_cursor->x - seat->resize_cursor_x;
 	const double delta_y =
-		(seat->cursor->wlr_cursor->y - seat->cursor->previous.y);
+		seat->cursor->wlr_cursor->y - seat->resize_cursor_y;
 
 	if ((ABS(delta_x) < 0.5 && ABS(delta_y) < 0.5)) {
 		return;
 	}
+	seat->resize_cursor_x = seat->cursor->wlr_cursor->x;
+	seat->resize_cursor_y = seat->cursor->wlr_cursor->y;
+
+	struct comp_workspace *ws = toplevel->workspace;
+	switch (ws->tiling_layout) {
+	case COMP_TILING_LAYOUT_BSP:
+		break;
+	case COMP_TILING_LAYOUT_MASTER_STACK:;
+		// The only split is between the master and the stack
+		struct wlr_box area = get_tiling_area(ws);
+		ws->tiling_params.master_ratio =
+			CLAMP(ws->tiling_params.master_ratio + delta_x / area.width, 0.1,
+				  0.9);
+		tiling_node_mark_workspace_dirty(ws);
+		return;
+	case COMP_TILING_LAYOUT_COLUMNS:
+	case COMP_TILING_LAYOUT_GRID:
+	case COMP_TILING_LAYOUT_COUNT:
+		// Nothing to resize
+		return;
+	}
 
 	// Thanks Hyprland :)
 
@@ -501,15 +616,14 @@ void tiling_node_resize(struct comp_toplevel *toplevel) {
 		}
 	}
 
-	bool update = can_update(toplevel);
-
 	if (h_outer) {
 		h_outer->parent->split_ratio =
 			CLAMP(h_outer->parent->split_ratio +
 					  allow_x_movement / h_outer->parent->box.width,
 				  0.1, 1.9);
 
-		calc_size_pos_recursive(h_outer->parent, update);
+		// Only the two halves of the split can change
+		layout_node(h_outer->parent);
 	}
 
 	if (v_outer) {
@@ -518,7 +632,42 @@ void tiling_node_resize(struct comp_toplevel *toplevel) {
 					  allow_y_movement / v_outer->parent->box.height,
 				  0.1, 1.9);
 
-		calc_size_pos_recursive(v_outer->parent, update);
+		layout_node(v_outer->parent);
+	}
+}
+
+/** Estimates the box of a toplevel split from the leaf */
+static struct wlr_box get_insert_box(const struct wlr_box *box,
+									 const bool split_first) {
+	struct wlr_box half = *box;
+	if (box->width > box->height) {
+		half.width = box->width * TILING_SPLIT_RATIO;
+		if (!split_first) {
+			half.x += half.width;
+			half.width = box->width - half.width;
+		}
+	} else {
+		half.height = box->height * TILING_SPLIT_RATIO;
+		if (!split_first) {
+			half.y += half.height;
+			half.height = box->height - half.height;
+		}
+	}
+	return half;
+}
+
+static bool is_over_drag_node(struct comp_toplevel *toplevel, int center_x,
+							  int center_y) {
+	struct tiling_node *node = toplevel->tiling_drag_node;
+	return node && node->ws == toplevel->workspace &&
+		   wlr_box_contains_point(&node->box, center_x, center_y);
+}
+
+static void destroy_drag_preview(void) {
+	struct comp_seat *seat = server.seat;
+	if (seat->tiling_preview) {
+		wlr_scene_node_destroy(&seat->tiling_preview->node);
+		seat->tiling_preview = NULL;
 	}
 }
 
@@ -530,12 +679,101 @@ void tiling_node_move_start(struct comp_toplevel *toplevel) {
 	toplevel->dragging_tiled = true;
 	comp_toplevel_refresh_titlebar_effects(toplevel);
 	comp_toplevel_set_tiled(toplevel, false, false);
+
+	// Shows where the toplevel would be tiled if dropped
+	struct comp_seat *seat = server.seat;
+	destroy_drag_preview();
+	struct wlr_render_color color = wlr_render_color_from_color(
+		&(const uint32_t){TILING_DRAG_PREVIEW_COLOR});
+	// The scene expects premultiplied colors
+	seat->tiling_preview = wlr_scene_rect_create(
+		toplevel->workspace->layers.lower, 0, 0,
+		(float[4]){color.r * color.a, color.g * color.a, color.b * color.a,
+				   color.a});
+	if (!seat->tiling_preview) {
+		wlr_log(WLR_ERROR, "Could not allocate tiling drag preview");
+		return;
+	}
+	tiling_node_move_update(toplevel);
 }
 
-void tiling_node_move_fini(struct comp_toplevel *toplevel) {
+void tiling_node_move_update(struct comp_toplevel *toplevel) {
+	struct wlr_scene_rect *preview = server.seat->tiling_preview;
+	if (!toplevel->dragging_tiled || !preview) {
+		return;
+	}
+
+	struct comp_workspace *ws = toplevel->workspace;
+	if (ws->type != COMP_WORKSPACE_TYPE_REGULAR) {
+		wlr_scene_node_set_enabled(&preview->node, false);
+		return;
+	}
+
+	const int center_x = toplevel->pending_state.x +
+						 (toplevel->decorated_size.width * 0.5);
+	const int center_y = toplevel->pending_state.y +
+						 (toplevel->decorated_size.height * 0.5);
+
+	// Only computes the would-be layout, the tiled toplevels are left as is
+	// until the drop
+	struct wlr_box box;
+	bool split_first = false;
+	struct tiling_node *parent_node = NULL;
+	if (is_over_drag_node(toplevel, center_x, center_y)) {
+		box = toplevel->tiling_drag_node->box;
+	} else if ((parent_node = get_insert_parent(toplevel, true, center_x,
+												 center_y, &split_first))) {
+		box = get_insert_box(&parent_node->box, split_first);
+	} else {
+		box = get_tiling_area(ws);
+	}
+
+	const int GAPS = ws->tiling_params.gaps_inner;
+	wlr_scene_node_reparent(&preview->node, ws->layers.lower);
+	wlr_scene_node_raise_to_top(&preview->node);
+	wlr_scene_node_set_position(&preview->node, box.x + GAPS, box.y + GAPS);
+	wlr_scene_rect_set_size(preview, MAX(box.width - GAPS * 2, 0),
+							MAX(box.height - GAPS * 2, 0));
+	wlr_scene_node_set_enabled(&preview->node, true);
+}
+
+void tiling_node_move_cancel(struct comp_toplevel *toplevel) {
+	if (!toplevel->dragging_tiled) {
+		return;
+	}
+
 	toplevel->dragging_tiled = false;
+	destroy_drag_preview();
+
+	struct tiling_node *node = toplevel->tiling_drag_node;
+	toplevel->tiling_drag_node = NULL;
+	if (node) {
+		remove_node(node);
+	}
+}
+
+void tiling_node_move_fini(struct comp_toplevel *toplevel) {
+	const int center_x = toplevel->pending_state.x +
+						 (toplevel->decorated_size.width * 0.5);
+	const int center_y = toplevel->pending_state.y +
+						 (toplevel->decorated_size.height * 0.5);
+	struct tiling_node *node = toplevel->tiling_drag_node;
+	if (node && !toplevel->tiling_node && !toplevel->fullscreen &&
+		is_over_drag_node(toplevel, center_x, center_y)) {
+		// Dropped back into its own slot, nothing else needs to move
+		toplevel->tiling_drag_node = NULL;
+		node->toplevel = toplevel;
+		toplevel->tiling_node = node;
+		tiling_node_mark_dirty(node);
+		tiling_node_mark_workspace_dirty(node->ws);
+	}
+	tiling_node_move_cancel(toplevel);
+
 	comp_toplevel_refresh_titlebar_effects(toplevel);
 	comp_toplevel_set_tiled(toplevel, true, false);
+
+	// Send all of the configures of the drop at once
+	comp_transaction_commit_dirty(true);
 }
 
 struct tiling_node *tiling_node_init(struct comp_workspace *ws, bool is_node) {
@@ -551,6 +789,8 @@ struct tiling_node *tiling_node_init(struct comp_workspace *ws, bool is_node) {
 	node->split_ratio = CLAMP(TILING_SPLIT_RATIO, 0.1, 1.9);
 	node->split_vertical = false;
 	node->box = ws->output->usable_area;
+	// Not laid out yet
+	node->dirty = true;
 
 	wl_list_insert(&ws->tiling_nodes, &node->parent_link);
 
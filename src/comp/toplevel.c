@@ -5,6 +5,7 @@
 #include <scenefx/types/wlr_scene.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <time.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_cursor.h>
@@ -15,10 +16,14 @@
 #include <wlr/util/log.h>
 
 #include "comp/animation_mgr.h"
+#include "comp/ipc.h"
 #include "comp/object.h"
 #include "comp/output.h"
+#include "comp/overview.h"
 #include "comp/saved_object.h"
 #include "comp/server.h"
+#include "comp/spawn.h"
+#include "comp/startup_trace.h"
 #include "comp/tiling_node.h"
 #include "comp/transaction.h"
 #include "comp/widget.h"
@@ -214,6 +219,9 @@ static void restore_state(struct comp_toplevel *toplevel) {
 	struct comp_output *output = toplevel->workspace->output;
 	struct comp_workspace *fs_ws = toplevel->workspace;
 
+	// Move, re-arrange, and resize everything in a single transaction
+	comp_transaction_batch_begin();
+
 	if (fs_ws->type == COMP_WORKSPACE_TYPE_FULLSCREEN) {
 		struct comp_workspace *prev_ws = toplevel->saved_workspace;
 		// Make sure that the workspace still exists...
@@ -237,8 +245,7 @@ static void restore_state(struct comp_toplevel *toplevel) {
 			comp_workspace_move_toplevel_to(ws, toplevel_pos);
 			// Mark as dirty later
 			if (toplevel_pos != toplevel) {
-				comp_object_mark_dirty(&toplevel->object);
-				comp_transaction_commit_dirty(true);
+				comp_object_mark_dirty(&toplevel_pos->object);
 			}
 		}
 		comp_output_remove_workspace(output, fs_ws);
@@ -252,6 +259,7 @@ static void restore_state(struct comp_toplevel *toplevel) {
 						   toplevel->saved_state.height);
 	comp_object_mark_dirty(&toplevel->object);
 	comp_transaction_commit_dirty(true);
+	comp_transaction_batch_end();
 
 	toplevel->saved_state.x = 0;
 	toplevel->saved_state.y = 0;
@@ -261,12 +269,11 @@ static void restore_state(struct comp_toplevel *toplevel) {
 }
 
 /**
- * Returns the output where the majority size of the toplevel resides
+ * Returns the output where the majority size of the toplevel resides when
+ * placed at the layout coordinates
  */
-static struct comp_output *find_output(struct comp_toplevel *toplevel) {
-	int x, y;
-	wlr_scene_node_coords(&toplevel->object.scene_tree->node, &x, &y);
-
+static struct comp_output *find_output(struct comp_toplevel *toplevel,
+									   double x, double y) {
 	double center_x = x + (double)toplevel->decorated_size.width / 2;
 	double center_y = y + (double)toplevel->decorated_size.height / 2;
 	struct comp_output *closest_output = NULL;
@@ -309,6 +316,23 @@ void comp_toplevel_process_cursor_move(struct comp_server *server,
 			ly = server->seat->cursor->wlr_cursor->y -
 				 toplevel->decorated_size.height * 0.5;
 		}
+
+		// Update floating toplevels current monitor and workspace before
+		// positioning, so that only one transaction is needed.
+		// Also raise the output node to the top so that it's floating toplevels
+		// remain on top on other outputs (if they intersect)
+		struct comp_output *new_output = find_output(toplevel, lx, ly);
+		struct comp_workspace *ws;
+		if (new_output && new_output != toplevel->workspace->output &&
+			(ws = comp_output_get_active_ws(new_output, toplevel->fullscreen))) {
+			comp_workspace_move_toplevel_to(ws, toplevel);
+			wlr_scene_node_raise_to_top(&new_output->object.scene_tree->node);
+		}
+		if (new_output) {
+			// Update the active output
+			server->active_output = new_output;
+		}
+
 		wlr_output_layout_output_coords(server->output_layout,
 										toplevel->workspace->output->wlr_output,
 										&lx, &ly);
@@ -320,23 +344,56 @@ void comp_toplevel_process_cursor_move(struct comp_server *server,
 			toplevel->anim.resize.to.y = ly;
 		}
 		comp_object_mark_dirty(&toplevel->object);
+		tiling_node_move_update(toplevel);
 		comp_transaction_commit_dirty(true);
+	}
+}
 
-		// Update floating toplevels current monitor and workspace.
-		// Also raise the output node to the top so that it's floating toplevels
-		// remain on top on other outputs (if they intersect)
-		struct comp_output *new_output = find_output(toplevel);
-		struct comp_workspace *ws;
-		if (new_output && (ws = comp_output_get_active_ws(
-							   new_output, toplevel->fullscreen))) {
-			comp_workspace_move_toplevel_to(ws, toplevel);
-			comp_object_mark_dirty(&toplevel->object);
-			comp_transaction_commit_dirty(true);
-			// Update the active output
-			server->active_output = new_output;
-			wlr_scene_node_raise_to_top(&new_output->object.scene_tree->node);
-		}
+/**
+ * Draws the decorations at the pending size without touching the current
+ * state or position, which are applied by the transaction. Used as a preview
+ * while the client catches up with an interactive resize.
+ */
+static void refresh_resize_preview(struct comp_toplevel *toplevel) {
+	struct comp_titlebar *titlebar = toplevel->titlebar;
+	if (toplevel->fullscreen || toplevel->unmapped ||
+		toplevel->object.destroying || !titlebar ||
+		toplevel->anim.resize.client->state != ANIMATION_STATE_NONE) {
+		return;
+	}
+
+	// Same as comp_toplevel_refresh_titlebar, but for the pending size
+	int top_border_height = BORDER_WIDTH;
+	if (comp_titlebar_should_be_shown(toplevel)) {
+		top_border_height += titlebar->bar_height;
+	}
+	int decorated_width = toplevel->pending_state.width + 2 * BORDER_WIDTH;
+	int decorated_height =
+		toplevel->pending_state.height + BORDER_WIDTH + top_border_height;
+	// Skip the toplevels which already show their pending size
+	if (titlebar->widget.width == decorated_width &&
+		titlebar->widget.height == decorated_height) {
+		return;
+	}
+
+	comp_widget_draw_resize(&titlebar->widget, decorated_width,
+							decorated_height);
+	// The edges follow the titlebar size
+	comp_input_index_invalidate(&server.input_index);
+	wlr_scene_node_set_position(&titlebar->widget.object.scene_tree->node,
+								-BORDER_WIDTH, -top_border_height);
+
+	for (size_t i = 0; i < NUMBER_OF_RESIZE_TARGETS; i++) {
+		struct comp_resize_edge *edge = toplevel->edges[i];
+		int width, height, x, y;
+		comp_resize_edge_get_geometry(edge, &width, &height, &x, &y);
+
+		comp_widget_draw_resize(&edge->widget, width, height);
+		wlr_scene_node_set_position(&edge->widget.object.scene_tree->node, x,
+									y);
 	}
+
+	comp_toplevel_refresh_titlebar_effects(toplevel);
 }
 
 void comp_toplevel_process_cursor_resize(struct comp_server *server,
@@ -361,8 +418,7 @@ void comp_toplevel_process_cursor_resize(struct comp_server *server,
 	switch (toplevel->tiling_mode) {
 	case COMP_TILING_MODE_TILED:
 		tiling_node_resize(toplevel);
-		comp_transaction_commit_dirty(true);
-		return;
+		goto commit;
 	case COMP_TILING_MODE_FLOATING:
 		break;
 	}
@@ -439,7 +495,25 @@ void comp_toplevel_process_cursor_resize(struct comp_server *server,
 
 done:
 	comp_object_mark_dirty(&toplevel->object);
-	comp_transaction_commit_dirty(true);
+
+commit:
+	// Only send a new size when the client has acked and committed the
+	// previous one. The dirty toplevels get committed on a later frame.
+	if (toplevel->object.num_txn_refs == 0) {
+		comp_transaction_commit_dirty(true);
+	} else {
+		// Any other commit before that has to configure them as well
+		struct comp_object *object;
+		wl_list_for_each(object, &server->dirty_objects, dirty_link) {
+			object->dirty_server_request = true;
+		}
+	}
+
+	// Let the decorations follow the pointer in the meantime
+	struct comp_toplevel *iter;
+	wl_list_for_each(iter, &toplevel->workspace->toplevels, workspace_link) {
+		refresh_resize_preview(iter);
+	}
 }
 
 uint32_t
@@ -685,6 +759,28 @@ void comp_toplevel_remove_buffer(struct comp_toplevel *toplevel) {
 	wlr_scene_node_set_enabled(&toplevel->toplevel_scene_tree->node, true);
 }
 
+void comp_toplevel_release_buffers(struct comp_toplevel *toplevel) {
+	if (toplevel->titlebar) {
+		comp_widget_release_buffer(&toplevel->titlebar->widget);
+	}
+	for (size_t i = 0; i < NUMBER_OF_RESIZE_TARGETS; i++) {
+		if (toplevel->edges[i]) {
+			comp_widget_release_buffer(&toplevel->edges[i]->widget);
+		}
+	}
+}
+
+void comp_toplevel_restore_buffers(struct comp_toplevel *toplevel) {
+	if (toplevel->titlebar) {
+		comp_widget_restore_buffer(&toplevel->titlebar->widget);
+	}
+	for (size_t i = 0; i < NUMBER_OF_RESIZE_TARGETS; i++) {
+		if (toplevel->edges[i]) {
+			comp_widget_restore_buffer(&toplevel->edges[i]->widget);
+		}
+	}
+}
+
 void comp_toplevel_set_minimized(struct comp_toplevel *toplevel, bool state) {
 	if (toplevel->minimized == state) {
 		return;
@@ -693,6 +789,7 @@ void comp_toplevel_set_minimized(struct comp_toplevel *toplevel, bool state) {
 	// HACK: Come up with a way of restoring to tiled state
 	if (state) {
 		comp_toplevel_set_tiled(toplevel, false, true);
+		comp_overview_toplevel_remove(toplevel);
 	}
 	toplevel->minimized = state;
 
@@ -724,10 +821,12 @@ void comp_toplevel_set_minimized(struct comp_toplevel *toplevel, bool state) {
 		} else {
 			restore_state(toplevel);
 		}
+		comp_overview_toplevel_add(toplevel);
 	}
 
 	// TODO: Minimize animation
 	wlr_scene_node_set_enabled(&toplevel->object.scene_tree->node, !state);
+	toplevel->workspace->snapshot_dirty = true;
 
 	if (!toplevel->fullscreen) {
 		comp_object_mark_dirty(&toplevel->object);
@@ -738,6 +837,7 @@ void comp_toplevel_set_minimized(struct comp_toplevel *toplevel, bool state) {
 		wlr_foreign_toplevel_handle_v1_set_minimized(
 			toplevel->wlr_foreign_toplevel, state);
 	}
+	comp_ipc_toplevel_state(toplevel);
 }
 
 void comp_toplevel_set_fullscreen(struct comp_toplevel *toplevel, bool state,
@@ -784,6 +884,10 @@ void comp_toplevel_set_fullscreen(struct comp_toplevel *toplevel, bool state,
 		wlr_foreign_toplevel_handle_v1_set_fullscreen(
 			toplevel->wlr_foreign_toplevel, state);
 	}
+	// Minimizing leaves fullscreen only temporarily, reported once minimized
+	if (!toplevel->minimized) {
+		comp_ipc_toplevel_state(toplevel);
+	}
 }
 
 void comp_toplevel_set_tiled(struct comp_toplevel *toplevel, bool state,
@@ -803,6 +907,7 @@ void comp_toplevel_set_tiled(struct comp_toplevel *toplevel, bool state,
 							   toplevel->natural_height);
 		comp_toplevel_center(toplevel, toplevel->pending_state.width,
 							 toplevel->pending_state.height, false);
+		comp_ipc_toplevel_state(toplevel);
 		return;
 	}
 
@@ -844,6 +949,7 @@ void comp_toplevel_set_tiled(struct comp_toplevel *toplevel, bool state,
 	if (toplevel->impl && toplevel->impl->set_tiled) {
 		toplevel->impl->set_tiled(toplevel, state);
 	}
+	comp_ipc_toplevel_state(toplevel);
 }
 
 void comp_toplevel_refresh_titlebar(struct comp_toplevel *toplevel) {
@@ -912,11 +1018,16 @@ void comp_toplevel_transaction_timed_out(struct comp_toplevel *toplevel) {
 
 void comp_toplevel_refresh(struct comp_toplevel *toplevel,
 						   bool is_instruction) {
+	toplevel->workspace->snapshot_dirty = true;
+	// Moved, resized or animated
+	comp_input_index_invalidate(&server.input_index);
+
 	// Assume that there's a pending state. Update the decorations with said
 	// pending state
 	if (!is_instruction) {
 		toplevel->state = toplevel->pending_state;
 	}
+	comp_ipc_toplevel_state(toplevel);
 
 	if (toplevel->impl && toplevel->impl->marked_dirty_cb) {
 		toplevel->impl->marked_dirty_cb(toplevel);
@@ -1060,11 +1171,14 @@ void comp_toplevel_destroy(struct comp_toplevel *toplevel) {
 	comp_animation_client_destroy(toplevel->anim.open_close.client);
 	comp_animation_client_destroy(toplevel->anim.resize.client);
 
+	// The client might have destroyed the role but not the surface
+	comp_overview_toplevel_remove(toplevel);
+
 	comp_saved_object_destroy(toplevel->saved_scene_tree->node.data);
 
 	wlr_scene_node_destroy(&toplevel->object.scene_tree->node);
 
-	free(toplevel);
+	comp_slab_free(&server.slabs.toplevels, toplevel);
 }
 
 struct comp_toplevel *
@@ -1072,11 +1186,14 @@ comp_toplevel_init(struct comp_output *output, struct comp_workspace *workspace,
 				   enum comp_toplevel_type type,
 				   enum comp_tiling_mode tiling_mode,
 				   const struct comp_toplevel_impl *impl) {
-	struct comp_toplevel *toplevel = calloc(1, sizeof(*toplevel));
+	static uint32_t next_id = 1;
+
+	struct comp_toplevel *toplevel = comp_slab_alloc(&server.slabs.toplevels);
 	if (!toplevel) {
 		wlr_log(WLR_ERROR, "Could not allocate comp_toplevel");
 		return NULL;
 	}
+	toplevel->id = next_id++;
 	toplevel->server = &server;
 	toplevel->type = type;
 	toplevel->using_csd = false;
@@ -1090,6 +1207,7 @@ comp_toplevel_init(struct comp_output *output, struct comp_workspace *workspace,
 	toplevel->corner_radius = EFFECTS_CORNER_RADII;
 
 	toplevel->dragging_tiled = false;
+	toplevel->tiling_drag_node = NULL;
 	toplevel->tiling_mode = tiling_mode;
 	toplevel->workspace = workspace;
 	struct wlr_scene_tree *tree = comp_toplevel_get_layer(toplevel);
@@ -1152,6 +1270,9 @@ comp_toplevel_init(struct comp_output *output, struct comp_workspace *workspace,
 
 void comp_toplevel_generic_map(struct comp_toplevel *toplevel) {
 	struct comp_workspace *ws = toplevel->workspace;
+	comp_input_index_invalidate(&server.input_index);
+
+	comp_startup_trace_toplevel_map(toplevel);
 
 	// EXT Foreign protocol
 	struct wlr_ext_foreign_toplevel_handle_v1_state foreign_toplevel_state = {
@@ -1187,6 +1308,7 @@ void comp_toplevel_generic_map(struct comp_toplevel *toplevel) {
 		toplevel->wlr_foreign_toplevel, comp_toplevel_get_foreign_id(toplevel));
 
 	comp_toplevel_set_pid(toplevel);
+	comp_spawn_toplevel_map(toplevel);
 
 	bool fullscreen = comp_toplevel_get_is_fullscreen(toplevel);
 	// Always tile toplevels
@@ -1211,7 +1333,10 @@ void comp_toplevel_generic_map(struct comp_toplevel *toplevel) {
 	save_state(toplevel, &toplevel->pending_state);
 
 	wl_list_insert(&ws->toplevels, &toplevel->workspace_link);
+	toplevel->focus_rank = ++ws->focus_serial;
 	wl_list_insert(server.seat->focus_order.prev, &toplevel->focus_link);
+	comp_ipc_toplevel_map(toplevel);
+	comp_overview_toplevel_add(toplevel);
 
 	comp_seat_surface_focus(&toplevel->object,
 							comp_toplevel_get_wlr_surface(toplevel));
@@ -1256,7 +1381,12 @@ void comp_toplevel_generic_map(struct comp_toplevel *toplevel) {
 }
 
 void comp_toplevel_generic_unmap(struct comp_toplevel *toplevel) {
+	toplevel->workspace->snapshot_dirty = true;
+	comp_input_index_invalidate(&server.input_index);
+
 	toplevel->unmapped = true;
+	comp_ipc_toplevel_unmap(toplevel);
+	comp_overview_toplevel_remove(toplevel);
 
 	if (toplevel->ext_foreign_toplevel) {
 		wlr_ext_foreign_toplevel_handle_v1_destroy(
@@ -1294,6 +1424,12 @@ void comp_toplevel_generic_unmap(struct comp_toplevel *toplevel) {
 		comp_cursor_reset_cursor_mode(toplevel->server->seat);
 	}
 
+	if (toplevel->dragging_tiled) {
+		// Give the held tiled slot back to the other toplevels
+		tiling_node_move_cancel(toplevel);
+		comp_transaction_commit_dirty(true);
+	}
+
 	if (toplevel->tiling_mode == COMP_TILING_MODE_TILED) {
 		tiling_node_remove_toplevel(toplevel);
 		comp_object_mark_dirty(&toplevel->object);
@@ -1336,6 +1472,8 @@ void comp_toplevel_generic_unmap(struct comp_toplevel *toplevel) {
 }
 
 void comp_toplevel_generic_commit(struct comp_toplevel *toplevel) {
+	toplevel->workspace->snapshot_dirty = true;
+
 	struct wlr_box new_geo = comp_toplevel_get_geometry(toplevel);
 
 	bool new_size = new_geo.width != toplevel->geometry.width ||
@@ -1396,6 +1534,13 @@ void comp_toplevel_generic_commit(struct comp_toplevel *toplevel) {
 			struct comp_transaction_instruction *instruction =
 				toplevel->object.instruction;
 			comp_transaction_instruction_mark_ready(instruction);
+
+			// Send the next size of an ongoing interactive resize
+			struct comp_cursor *cursor = server.seat->cursor;
+			if (server.seat->grabbed_toplevel &&
+				cursor->cursor_mode == COMP_CURSOR_RESIZE) {
+				comp_cursor_queue_grab_motion(cursor, cursor->grab_motion.time);
+			}
 		} else if (!wl_list_empty(&toplevel->saved_scene_tree->children)) {
 			comp_toplevel_send_frame_done(toplevel);
 		}
@@ -0,0 +1,180 @@
+#define _GNU_SOURCE // for gettid
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+
+#include "comp/trace.h"
+#include "constants.h"
+
+atomic_bool comp_trace_enabled = false;
+
+// Every thread that has traced, new rings are pushed to the front
+static _Atomic(struct comp_trace_ring *) rings = NULL;
+static _Thread_local struct comp_trace_ring *thread_ring = NULL;
+
+static struct comp_trace_ring *ring_create(void) {
+	struct comp_trace_ring *ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_trace_ring");
+		return NULL;
+	}
+	ring->tid = gettid();
+	atomic_init(&ring->head, 0);
+
+	struct comp_trace_ring *first = atomic_load(&rings);
+	do {
+		ring->next = first;
+	} while (!atomic_compare_exchange_weak(&rings, &first, ring));
+	return ring;
+}
+
+uint64_t comp_trace_now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void comp_trace_init(void) {
+	atomic_store(&comp_trace_enabled, true);
+	wlr_log(WLR_INFO, "Tracing enabled, keeping the last %d events per thread",
+			TRACE_RING_SIZE);
+}
+
+void comp_trace_finish(void) {
+	if (!atomic_load(&comp_trace_enabled)) {
+		return;
+	}
+	atomic_store(&comp_trace_enabled, false);
+
+	// Only the main thread is left at this point
+	struct comp_trace_ring *ring = atomic_exchange(&rings, NULL);
+	while (ring) {
+		struct comp_trace_ring *next = ring->next;
+		free(ring);
+		ring = next;
+	}
+	thread_ring = NULL;
+}
+
+void comp_trace_record(const char *name, uint64_t start_ns) {
+	const uint64_t end_ns = comp_trace_now_ns();
+
+	struct comp_trace_ring *ring = thread_ring;
+	if (!ring && !(ring = thread_ring = ring_create())) {
+		atomic_store(&comp_trace_enabled, false);
+		return;
+	}
+
+	const uint64_t head =
+		atomic_load_explicit(&ring->head, memory_order_relaxed);
+	struct comp_trace_event *event =
+		&ring->events[head & (TRACE_RING_SIZE - 1)];
+	event->name = name;
+	event->start_ns = start_ns;
+	event->duration_ns = end_ns - start_ns;
+	// Publishes the event to the exporter
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * Copies the events that are still in the ring, oldest first. The owning
+ * thread might overwrite the oldest slots while copying, so those are
+ * dropped afterwards. Returns the number of events copied.
+ */
+static size_t ring_copy(struct comp_trace_ring *ring,
+						struct comp_trace_event *events) {
+	const uint64_t head =
+		atomic_load_explicit(&ring->head, memory_order_acquire);
+	uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+	for (uint64_t i = first; i < head; i++) {
+		events[i - first] = ring->events[i & (TRACE_RING_SIZE - 1)];
+	}
+
+	// The slot of the event that is currently being written
+	const uint64_t new_head =
+		atomic_load_explicit(&ring->head, memory_order_acquire);
+	uint64_t skip = 0;
+	if (new_head >= first + TRACE_RING_SIZE) {
+		skip = MIN(new_head + 1 - TRACE_RING_SIZE - first, head - first);
+	}
+	memmove(events, events + skip, (head - first - skip) * sizeof(*events));
+	return head - first - skip;
+}
+
+static void write_metadata(FILE *file, const char *type, pid_t pid,
+						   pid_t tid, const char *name) {
+	fprintf(file,
+			"{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+			"\"args\":{\"name\":\"%s\"}},\n",
+			type, pid, tid, name);
+}
+
+char *comp_trace_export(void) {
+	if (!atomic_load(&comp_trace_enabled)) {
+		wlr_log(WLR_ERROR, "Tracing isn't enabled, start with `-D trace`");
+		return NULL;
+	}
+
+	const pid_t pid = getpid();
+	char name[64];
+	snprintf(name, sizeof(name), TRACE_JSON_NAME, pid);
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	char *path = g_build_filename(dir ? dir : "/tmp", name, NULL);
+
+	struct comp_trace_event *events =
+		malloc(TRACE_RING_SIZE * sizeof(*events));
+	if (!events) {
+		wlr_log(WLR_ERROR, "Could not allocate the trace export buffer");
+		g_free(path);
+		return NULL;
+	}
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		wlr_log_errno(WLR_ERROR, "Could not open %s", path);
+		free(events);
+		g_free(path);
+		return NULL;
+	}
+
+	// Chrome trace format, the timestamps are in microseconds
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	write_metadata(file, "process_name", pid, pid, "fx-comp");
+	size_t num_events = 0;
+	struct comp_trace_ring *ring = atomic_load(&rings);
+	for (; ring; ring = ring->next) {
+		write_metadata(file, "thread_name", pid, ring->tid,
+					   ring->tid == pid ? "main" : "worker");
+
+		size_t len = ring_copy(ring, events);
+		for (size_t i = 0; i < len; i++) {
+			// Trace point names are identifiers, no escaping needed
+			fprintf(file,
+					"{\"name\":\"%s\",\"cat\":\"fx-comp\",\"ph\":\"X\","
+					"\"ts\":%" PRIu64 ".%03" PRIu64 ",\"dur\":%" PRIu64
+					".%03" PRIu64 ",\"pid\":%d,\"tid\":%d},\n",
+					events[i].name, events[i].start_ns / 1000,
+					events[i].start_ns % 1000, events[i].duration_ns / 1000,
+					events[i].duration_ns % 1000, pid, ring->tid);
+		}
+		num_events += len;
+	}
+	// Trailing commas aren't allowed, end with an empty metadata event
+	fprintf(file, "{\"name\":\"trace_end\",\"ph\":\"M\",\"pid\":%d}\n]}\n",
+			pid);
+	free(events);
+
+	if (fclose(file) != 0) {
+		wlr_log_errno(WLR_ERROR, "Could not write %s", path);
+		g_free(path);
+		return NULL;
+	}
+	wlr_log(WLR_INFO, "Wrote %zu trace events to %s", num_events, path);
+	return path;
+}
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <glib.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +9,7 @@
 #include "comp/object.h"
 #include "comp/saved_object.h"
 #include "comp/server.h"
+#include "comp/trace.h"
 #include "comp/transaction.h"
 #include "constants.h"
 #include "desktop/toplevel.h"
@@ -128,6 +130,7 @@ static void transaction_add_node(struct comp_transaction *transaction,
 }
 
 static void transaction_apply(struct comp_transaction *transaction) {
+	const uint64_t trace_start = comp_trace_begin();
 	wlr_log(WLR_DEBUG, "Applying transaction %p", transaction);
 
 	if (server.debug.log_txn_timings) {
@@ -190,6 +193,7 @@ static void transaction_apply(struct comp_transaction *transaction) {
 
 		object->instruction = NULL;
 	}
+	comp_trace_end("transaction_apply", trace_start);
 }
 
 static void transaction_commit_pending(void);
@@ -273,6 +277,7 @@ static bool should_configure(struct comp_toplevel *toplevel,
 }
 
 static void transaction_commit(struct comp_transaction *transaction) {
+	const uint64_t trace_start = comp_trace_begin();
 	wlr_log(WLR_DEBUG, "Transaction %p committing with %i instructions",
 			transaction, wl_list_length(&transaction->instructions));
 	transaction->num_waiting = 0;
@@ -325,6 +330,7 @@ static void transaction_commit(struct comp_transaction *transaction) {
 			transaction->num_waiting = 0;
 		}
 	}
+	comp_trace_end("transaction_commit", trace_start);
 }
 
 static void transaction_commit_pending(void) {
@@ -343,6 +349,14 @@ void comp_transaction_commit_dirty(bool server_request) {
 		return;
 	}
 
+	if (server.transaction_batch.depth > 0) {
+		// Same as transaction_add_node, one server request is enough to
+		// make the instructions wait for their clients
+		server.transaction_batch.server_request |= server_request;
+		server.transaction_batch.pending = true;
+		return;
+	}
+
 	if (!server.pending_transaction) {
 		server.pending_transaction = transaction_create();
 		if (!server.pending_transaction) {
@@ -358,13 +372,36 @@ void comp_transaction_commit_dirty(bool server_request) {
 		}
 		wl_list_remove(&object->dirty_link);
 		transaction_add_node(server.pending_transaction, object,
-							 server_request);
+							 server_request || object->dirty_server_request);
 		object->dirty = false;
+		object->dirty_server_request = false;
 	}
 
 	transaction_commit_pending();
 }
 
+void comp_transaction_batch_begin(void) {
+	if (server.transaction_batch.depth++ == 0) {
+		server.transaction_batch.pending = false;
+		server.transaction_batch.server_request = false;
+	}
+}
+
+void comp_transaction_batch_end(void) {
+	assert(server.transaction_batch.depth > 0);
+	if (--server.transaction_batch.depth > 0) {
+		return;
+	}
+	// Also commit the objects marked dirty without an explicit commit
+	if (!server.transaction_batch.pending &&
+		wl_list_empty(&server.dirty_objects)) {
+		return;
+	}
+
+	server.transaction_batch.pending = false;
+	comp_transaction_commit_dirty(server.transaction_batch.server_request);
+}
+
 void comp_transaction_instruction_mark_ready(
 	struct comp_transaction_instruction *instruction) {
 	struct comp_transaction *transaction = instruction->transaction;
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <math.h>
 #include <pixman.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -8,6 +9,7 @@
 #include "comp/cairo_buffer.h"
 #include "comp/object.h"
 #include "comp/output.h"
+#include "comp/trace.h"
 #include "comp/widget.h"
 #include "seat/seat.h"
 #include "util.h"
@@ -174,6 +176,7 @@ static void comp_widget_draw(struct comp_widget *widget, int width,
 	if (widget->impl->draw == NULL || width <= 0 || height <= 0) {
 		return;
 	}
+	const uint64_t trace_start = comp_trace_begin();
 
 	// TODO: Get scale from wlr_output
 	float scale = 1.0f;
@@ -187,6 +190,7 @@ static void comp_widget_draw(struct comp_widget *widget, int width,
 		wlr_buffer_drop(&widget->buffer->base);
 
 		widget->buffer = cairo_buffer_init(scaled_width, scaled_height);
+		widget->buffer_released = false;
 	} else {
 		// Clear the previous buffer
 		cairo_save(widget->buffer->cairo);
@@ -206,6 +210,7 @@ static void comp_widget_draw(struct comp_widget *widget, int width,
 		widget->scene_buffer, &widget->buffer->base, &widget->damage);
 
 	pixman_region32_clear(&widget->damage);
+	comp_trace_end("comp_widget_draw", trace_start);
 }
 
 void comp_widget_draw_damaged(struct comp_widget *widget) {
@@ -219,6 +224,23 @@ void comp_widget_draw_full(struct comp_widget *widget) {
 	comp_widget_draw(widget, widget->width, widget->height);
 }
 
+void comp_widget_release_buffer(struct comp_widget *widget) {
+	if (!widget->buffer) {
+		return;
+	}
+
+	wlr_scene_buffer_set_buffer(widget->scene_buffer, NULL);
+	wlr_buffer_drop(&widget->buffer->base);
+	widget->buffer = NULL;
+	widget->buffer_released = true;
+}
+
+void comp_widget_restore_buffer(struct comp_widget *widget) {
+	if (widget->buffer_released) {
+		comp_widget_draw_full(widget);
+	}
+}
+
 void comp_widget_draw_resize(struct comp_widget *widget, int width,
 							 int height) {
 	if (widget->width != width || widget->height != height) {
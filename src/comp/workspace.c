@@ -1,3 +1,4 @@
+#include <math.h>
 #include <scenefx/types/wlr_scene.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -5,7 +6,11 @@
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/util/log.h>
 
+#include "comp/ipc.h"
 #include "comp/output.h"
+#include "comp/overview.h"
+#include "comp/tiling_layout.h"
+#include "comp/transaction.h"
 #include "comp/workspace.h"
 #include "desktop/toplevel.h"
 #include "util.h"
@@ -18,9 +23,14 @@ void comp_workspace_move_toplevel_to(struct comp_workspace *dest_workspace,
 	wlr_log(WLR_DEBUG, "Changing toplevel output from: '%s' to '%s'\n",
 			toplevel->workspace->output->wlr_output->name,
 			dest_workspace->output->wlr_output->name);
+	comp_overview_toplevel_remove(toplevel);
 	wl_list_remove(&toplevel->workspace_link);
+	toplevel->workspace->snapshot_dirty = true;
 	toplevel->workspace = dest_workspace;
 	wl_list_insert(&dest_workspace->toplevels, &toplevel->workspace_link);
+	toplevel->focus_rank = ++dest_workspace->focus_serial;
+	toplevel->workspace->snapshot_dirty = true;
+	comp_toplevel_restore_buffers(toplevel);
 
 	int x, y;
 	wlr_scene_node_coords(&toplevel->object.scene_tree->node, &x, &y);
@@ -28,6 +38,7 @@ void comp_workspace_move_toplevel_to(struct comp_workspace *dest_workspace,
 	// Reparent node onto the new workspace
 	struct wlr_scene_tree *new_layer = comp_toplevel_get_layer(toplevel);
 	wlr_scene_node_reparent(&toplevel->object.scene_tree->node, new_layer);
+	comp_input_index_invalidate(&server.input_index);
 
 	// Adjust the node coordinates to be output-relative
 	double lx = x;
@@ -36,6 +47,11 @@ void comp_workspace_move_toplevel_to(struct comp_workspace *dest_workspace,
 									toplevel->workspace->output->wlr_output,
 									&lx, &ly);
 	comp_toplevel_set_position(toplevel, lx, ly);
+
+	if (!toplevel->unmapped) {
+		comp_overview_toplevel_add(toplevel);
+	}
+	comp_ipc_toplevel_move(toplevel);
 }
 
 struct comp_toplevel *
@@ -67,86 +83,243 @@ comp_workspace_get_prev_focused(struct comp_workspace *ws) {
 	return toplevel;
 }
 
-struct comp_toplevel *
-comp_workspace_get_toplevel_direction(struct comp_workspace *ws,
-									  enum wlr_direction direction) {
-	// Get latest focused toplevel on other monitor if fullscreen
-	if (ws->fullscreen_toplevel || wl_list_empty(&ws->toplevels)) {
-		goto focus_adjacent_monitor;
+/** Length of the overlap of the boxes perpendicular to the direction */
+static int get_edge_overlap(const struct wlr_box *a, const struct wlr_box *b,
+							enum wlr_direction direction) {
+	switch (direction) {
+	case WLR_DIRECTION_LEFT:
+	case WLR_DIRECTION_RIGHT:
+		return MIN(a->y + a->height, b->y + b->height) - MAX(a->y, b->y);
+	case WLR_DIRECTION_UP:
+	case WLR_DIRECTION_DOWN:
+		return MIN(a->x + a->width, b->x + b->width) - MAX(a->x, b->x);
 	}
+	return 0;
+}
 
-	struct comp_toplevel *focused_toplevel =
-		comp_workspace_get_latest_focused(ws);
-	if (focused_toplevel->tiling_mode == COMP_TILING_MODE_FLOATING) {
-		// TODO: Floating direction switching?
-		wlr_log(WLR_DEBUG, "Floating direction switching not supported");
-		return NULL;
+/**
+ * Finds the most recently focused leaf in the subtree which touches the box
+ * from the given direction. Only descends into the children on the touching
+ * side of the split, or the ones overlapping the box.
+ */
+static void find_adjacent_leaf(struct tiling_node *node,
+							   const struct wlr_box *box,
+							   enum wlr_direction direction,
+							   struct comp_toplevel **leader) {
+	if (get_edge_overlap(box, &node->box, direction) <= 0) {
+		return;
 	}
 
-	struct comp_toplevel *toplevel = NULL;
-	int leader_value = -1;
-	struct wlr_box box = focused_toplevel->tiling_node->box;
+	if (!node->is_node) {
+		struct comp_toplevel *toplevel = node->toplevel;
+		if (toplevel &&
+			(!*leader || toplevel->focus_rank > (*leader)->focus_rank)) {
+			*leader = toplevel;
+		}
+		return;
+	}
+
+	// If the split is along the direction, only the closest child can touch
+	switch (direction) {
+	case WLR_DIRECTION_LEFT:
+		if (!node->split_vertical) {
+			find_adjacent_leaf(node->children[1], box, direction, leader);
+			return;
+		}
+		break;
+	case WLR_DIRECTION_RIGHT:
+		if (!node->split_vertical) {
+			find_adjacent_leaf(node->children[0], box, direction, leader);
+			return;
+		}
+		break;
+	case WLR_DIRECTION_UP:
+		if (node->split_vertical) {
+			find_adjacent_leaf(node->children[1], box, direction, leader);
+			return;
+		}
+		break;
+	case WLR_DIRECTION_DOWN:
+		if (node->split_vertical) {
+			find_adjacent_leaf(node->children[0], box, direction, leader);
+			return;
+		}
+		break;
+	}
+
+	find_adjacent_leaf(node->children[0], box, direction, leader);
+	find_adjacent_leaf(node->children[1], box, direction, leader);
+}
+
+static struct comp_toplevel *
+get_tiled_toplevel_direction(struct comp_toplevel *focused_toplevel,
+							 enum wlr_direction direction) {
+	struct tiling_node *leaf = focused_toplevel->tiling_node;
+
+	// The leaves sharing the edge are on the other side of the closest split
+	// which has the focused toplevel on the far side of the direction
+	for (struct tiling_node *current = leaf; current->parent;
+		 current = current->parent) {
+		struct tiling_node *parent = current->parent;
+		bool is_first = parent->children[0] == current;
+		struct tiling_node *sibling = parent->children[is_first ? 1 : 0];
+
+		bool found = false;
+		switch (direction) {
+		case WLR_DIRECTION_LEFT:
+			found = !parent->split_vertical && !is_first;
+			break;
+		case WLR_DIRECTION_RIGHT:
+			found = !parent->split_vertical && is_first;
+			break;
+		case WLR_DIRECTION_UP:
+			found = parent->split_vertical && !is_first;
+			break;
+		case WLR_DIRECTION_DOWN:
+			found = parent->split_vertical && is_first;
+			break;
+		}
+		if (found) {
+			struct comp_toplevel *toplevel = NULL;
+			find_adjacent_leaf(sibling, &leaf->box, direction, &toplevel);
+			return toplevel;
+		}
+	}
 
-	const int MAX_DISTANCE = 2;
+	return NULL;
+}
+
+/**
+ * The layout engines don't follow the tiling tree, so find the closest leaf
+ * sharing the edge by its box instead
+ */
+static struct comp_toplevel *
+get_arranged_toplevel_direction(struct comp_workspace *ws,
+								struct comp_toplevel *focused_toplevel,
+								enum wlr_direction direction) {
+	const struct wlr_box *box = &focused_toplevel->tiling_node->box;
+
+	struct comp_toplevel *toplevel = NULL;
+	int leader_distance = -1;
 	struct tiling_node *node;
 	wl_list_for_each(node, &ws->tiling_nodes, parent_link) {
-		if (node->is_node) {
+		struct comp_toplevel *t = node->toplevel;
+		if (node->is_node || !t || t == focused_toplevel ||
+			get_edge_overlap(box, &node->box, direction) <= 0) {
+			continue;
+		}
+
+		int distance;
+		switch (direction) {
+		case WLR_DIRECTION_LEFT:
+			distance = box->x - (node->box.x + node->box.width);
+			break;
+		case WLR_DIRECTION_RIGHT:
+			distance = node->box.x - (box->x + box->width);
+			break;
+		case WLR_DIRECTION_UP:
+			distance = box->y - (node->box.y + node->box.height);
+			break;
+		case WLR_DIRECTION_DOWN:
+			distance = node->box.y - (box->y + box->height);
+			break;
+		default:
 			continue;
 		}
-		if (!node->toplevel || node->toplevel == focused_toplevel) {
+		if (distance < 0) {
 			continue;
 		}
 
-		struct wlr_box iter_box = node->box;
-		int intersect_length = -1;
+		if (leader_distance < 0 || distance < leader_distance ||
+			(distance == leader_distance &&
+			 t->focus_rank > toplevel->focus_rank)) {
+			leader_distance = distance;
+			toplevel = t;
+		}
+	}
+
+	return toplevel;
+}
+
+static struct comp_toplevel *
+get_floating_toplevel_direction(struct comp_workspace *ws,
+								struct comp_toplevel *focused_toplevel,
+								enum wlr_direction direction) {
+	const double x = focused_toplevel->state.x +
+					 focused_toplevel->decorated_size.width * 0.5;
+	const double y = focused_toplevel->state.y +
+					 focused_toplevel->decorated_size.height * 0.5;
+
+	// Nearest center in the direction, with the sideways offset weighted
+	// higher so that toplevels in line are preferred
+	struct comp_toplevel *toplevel = NULL;
+	double leader_value = -1;
+	struct comp_toplevel *t;
+	wl_list_for_each(t, &ws->toplevels, workspace_link) {
+		if (t == focused_toplevel || t->minimized || t->unmapped ||
+			t->tiling_mode != COMP_TILING_MODE_FLOATING) {
+			continue;
+		}
+
+		const double dx = t->state.x + t->decorated_size.width * 0.5 - x;
+		const double dy = t->state.y + t->decorated_size.height * 0.5 - y;
+		double distance, offset;
 		switch (direction) {
 		case WLR_DIRECTION_LEFT:
-			if (abs(box.x - (iter_box.x + iter_box.width)) < MAX_DISTANCE) {
-				intersect_length = MAX(
-					0.0, MIN(box.y + box.height, iter_box.y + iter_box.height) -
-							 MAX(box.y, iter_box.y));
-			}
+			distance = -dx;
+			offset = dy;
 			break;
 		case WLR_DIRECTION_RIGHT:
-			if (abs((box.x + box.width) - iter_box.x) < MAX_DISTANCE) {
-				intersect_length = MAX(
-					0.0, MIN(box.y + box.height, iter_box.y + iter_box.height) -
-							 MAX(box.y, iter_box.y));
-			}
+			distance = dx;
+			offset = dy;
 			break;
 		case WLR_DIRECTION_UP:
-			if (abs(box.y - (iter_box.y + iter_box.height)) < MAX_DISTANCE) {
-				intersect_length = MAX(
-					0.0, MIN(box.x + box.width, iter_box.x + iter_box.width) -
-							 MAX(box.x, iter_box.x));
-			}
+			distance = -dy;
+			offset = dx;
 			break;
 		case WLR_DIRECTION_DOWN:
-			if (abs((box.y + box.height) - iter_box.y) < MAX_DISTANCE) {
-				intersect_length = MAX(
-					0.0, MIN(box.x + box.width, iter_box.x + iter_box.width) -
-							 MAX(box.x, iter_box.x));
-			}
+			distance = dy;
+			offset = dx;
 			break;
+		default:
+			continue;
+		}
+		if (distance <= 0) {
+			continue;
 		}
-		if (intersect_length > 0) {
-			// Find the closest toplevel which was focused most recently
-			int index = 0;
-			struct comp_toplevel *t;
-			wl_list_for_each_reverse(t, &ws->toplevels, workspace_link) {
-				if (t == node->toplevel) {
-					break;
-				}
-				index++;
-			}
 
-			if (index > leader_value) {
-				leader_value = index;
-				toplevel = node->toplevel;
-			}
+		const double value = distance + fabs(offset) * 2;
+		if (leader_value < 0 || value < leader_value) {
+			leader_value = value;
+			toplevel = t;
 		}
 	}
 
+	return toplevel;
+}
+
+struct comp_toplevel *
+comp_workspace_get_toplevel_direction(struct comp_workspace *ws,
+									  enum wlr_direction direction) {
+	// Get latest focused toplevel on other monitor if fullscreen
+	if (ws->fullscreen_toplevel || wl_list_empty(&ws->toplevels)) {
+		goto focus_adjacent_monitor;
+	}
+
+	struct comp_toplevel *focused_toplevel =
+		comp_workspace_get_latest_focused(ws);
+	struct comp_toplevel *toplevel = NULL;
+	if (focused_toplevel->tiling_mode == COMP_TILING_MODE_FLOATING ||
+		!focused_toplevel->tiling_node) {
+		toplevel =
+			get_floating_toplevel_direction(ws, focused_toplevel, direction);
+	} else if (ws->tiling_layout != COMP_TILING_LAYOUT_BSP) {
+		toplevel =
+			get_arranged_toplevel_direction(ws, focused_toplevel, direction);
+	} else {
+		toplevel = get_tiled_toplevel_direction(focused_toplevel, direction);
+	}
+
 	if (toplevel) {
 		return toplevel;
 	}
@@ -168,14 +341,91 @@ focus_adjacent_monitor:;
 	return NULL;
 }
 
+struct wlr_scene_tree *comp_workspace_get_snapshot(struct comp_workspace *ws) {
+	if (ws->snapshot && !ws->snapshot_dirty) {
+		return ws->snapshot;
+	}
+	comp_workspace_destroy_snapshot(ws);
+	comp_workspace_restore_buffers(ws);
+
+	struct wlr_scene_tree *snapshot =
+		alloc_tree(ws->output->layers.workspace_switch);
+	if (!snapshot) {
+		return NULL;
+	}
+	wlr_scene_node_set_enabled(&snapshot->node, false);
+
+	// Only references the current buffers, so the clients don't need to
+	// redraw
+	struct wlr_scene_tree *layers[] = {ws->layers.lower, ws->layers.floating};
+	for (size_t i = 0; i < sizeof(layers) / sizeof(*layers); i++) {
+		struct wlr_scene_node *node;
+		wl_list_for_each(node, &layers[i]->children, link) {
+			if (node->enabled && !wlr_scene_tree_snapshot(node, snapshot)) {
+				wlr_log(WLR_ERROR, "Could not snapshot workspace");
+				wlr_scene_node_destroy(&snapshot->node);
+				return NULL;
+			}
+		}
+	}
+
+	ws->snapshot = snapshot;
+	ws->snapshot_dirty = false;
+	return snapshot;
+}
+
+void comp_workspace_destroy_snapshot(struct comp_workspace *ws) {
+	if (ws->snapshot) {
+		wlr_scene_node_destroy(&ws->snapshot->node);
+		ws->snapshot = NULL;
+	}
+}
+
+void comp_workspace_release_buffers(struct comp_workspace *ws) {
+	comp_workspace_destroy_snapshot(ws);
+
+	struct comp_toplevel *toplevel;
+	wl_list_for_each(toplevel, &ws->toplevels, workspace_link) {
+		comp_toplevel_release_buffers(toplevel);
+	}
+}
+
+void comp_workspace_restore_buffers(struct comp_workspace *ws) {
+	struct comp_toplevel *toplevel;
+	wl_list_for_each(toplevel, &ws->toplevels, workspace_link) {
+		comp_toplevel_restore_buffers(toplevel);
+	}
+}
+
+void comp_workspace_set_tiling_layout(struct comp_workspace *ws,
+									  enum comp_tiling_layout_type type) {
+	if (ws->tiling_layout == type) {
+		return;
+	}
+	ws->tiling_layout = type;
+
+	// The node boxes don't match the tree after a layout engine, so lay out
+	// the whole tree again
+	struct tiling_node *node;
+	wl_list_for_each(node, &ws->tiling_nodes, parent_link) {
+		node->dirty = true;
+	}
+
+	tiling_node_mark_workspace_dirty(ws);
+	comp_transaction_commit_dirty(true);
+}
+
 struct comp_workspace *comp_workspace_new(struct comp_output *output,
 										  enum comp_workspace_type type) {
+	static uint32_t next_id = 1;
+
 	struct comp_workspace *ws = calloc(1, sizeof(*ws));
 	if (ws == NULL) {
 		wlr_log(WLR_ERROR, "Could not allocate comp_workspace");
 		return NULL;
 	}
 
+	ws->id = next_id++;
 	ws->type = type;
 	ws->output = output;
 
@@ -203,7 +453,13 @@ struct comp_workspace *comp_workspace_new(struct comp_output *output,
 	}
 	ws->layers.floating->node.data = &ws->object;
 
+	ws->snapshot = NULL;
+	ws->snapshot_dirty = true;
+
 	wl_list_init(&ws->tiling_nodes);
+	ws->tiling_root = NULL;
+	ws->tiling_layout = COMP_TILING_LAYOUT_BSP;
+	comp_tiling_params_init(&ws->tiling_params);
 	wl_list_init(&ws->toplevels);
 
 	// Insert next to active workspace
@@ -212,12 +468,15 @@ struct comp_workspace *comp_workspace_new(struct comp_output *output,
 							  : &output->workspaces;
 	wl_list_insert(pos, &ws->output_link);
 
-	comp_output_focus_workspace(output, ws);
-
 	return ws;
 }
 
 void comp_workspace_destroy(struct comp_workspace *ws) {
+	comp_output_cancel_workspace_switch(ws->output);
+	if (ws->output->overview && ws->output->overview->workspace == ws) {
+		comp_overview_exit(ws->output);
+	}
+	comp_workspace_destroy_snapshot(ws);
 	wl_list_remove(&ws->output_link);
 
 	wlr_scene_node_destroy(&ws->object.scene_tree->node);
@@ -23,11 +23,46 @@ static const char *atom_map[ATOM_LAST] = {
 	[NET_WM_STATE_MODAL] = "_NET_WM_STATE_MODAL",
 };
 
-void xwayland_ready_cb(struct wl_listener *listener, void *data) {
-	struct comp_server *server =
-		wl_container_of(listener, server, xwayland_ready);
-	struct comp_xwayland_mgr *xwayland = &server->xwayland_mgr;
+struct wlr_xwayland *comp_xwayland_mgr_create(struct comp_xwayland_mgr *mgr,
+											  struct wl_display *display,
+											  struct wlr_compositor *compositor,
+											  bool lazy, int idle_timeout_s) {
+	mgr->atoms_resolved = false;
+	if (!lazy) {
+		mgr->wlr_xwayland = wlr_xwayland_create(display, compositor, false);
+		return mgr->wlr_xwayland;
+	}
+
+	// wlr_xwayland_create always uses its own idle timeout for lazy servers
+	struct wlr_xwayland_server_options options = {
+		.lazy = true,
+		.enable_wm = true,
+		.terminate_delay = idle_timeout_s,
+	};
+	mgr->wlr_xwayland_server = wlr_xwayland_server_create(display, &options);
+	if (!mgr->wlr_xwayland_server) {
+		return NULL;
+	}
+
+	mgr->wlr_xwayland = wlr_xwayland_create_with_server(
+		display, compositor, mgr->wlr_xwayland_server);
+	if (!mgr->wlr_xwayland) {
+		wlr_xwayland_server_destroy(mgr->wlr_xwayland_server);
+		mgr->wlr_xwayland_server = NULL;
+	}
+	return mgr->wlr_xwayland;
+}
+
+void comp_xwayland_mgr_destroy(struct comp_xwayland_mgr *mgr) {
+	wlr_xwayland_destroy(mgr->wlr_xwayland);
+	mgr->wlr_xwayland = NULL;
+	if (mgr->wlr_xwayland_server) {
+		wlr_xwayland_server_destroy(mgr->wlr_xwayland_server);
+		mgr->wlr_xwayland_server = NULL;
+	}
+}
 
+static void resolve_atoms(struct comp_xwayland_mgr *xwayland) {
 	xcb_connection_t *xcb_conn = xcb_connect(NULL, NULL);
 	int err = xcb_connection_has_error(xcb_conn);
 	if (err) {
@@ -58,11 +93,30 @@ void xwayland_ready_cb(struct wl_listener *listener, void *data) {
 	}
 
 	xcb_disconnect(xcb_conn);
+	xwayland->atoms_resolved = true;
+}
+
+void xwayland_start_cb(struct wl_listener *listener, void *data) {
+	struct comp_server *server =
+		wl_container_of(listener, server, xwayland_start);
+	// The atoms might differ between the X server instances
+	server->xwayland_mgr.atoms_resolved = false;
+}
+
+void xwayland_ready_cb(struct wl_listener *listener, void *data) {
+	struct comp_server *server =
+		wl_container_of(listener, server, xwayland_ready);
+	resolve_atoms(&server->xwayland_mgr);
 }
 
 void xwayland_new_surface(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = data;
 
+	// Make sure that the window types can be checked
+	if (!server.xwayland_mgr.atoms_resolved) {
+		resolve_atoms(&server.xwayland_mgr);
+	}
+
 	if (xsurface->override_redirect) {
 		wlr_log(WLR_DEBUG, "New xwayland unmanaged surface");
 		xway_create_unmanaged(xsurface);
@@ -47,14 +47,13 @@ static void set_xcursor_theme(enum xdg_toplevel_resize_edge edge) {
 		cursor = "bottom_right_corner";
 		break;
 	}
-	wlr_cursor_set_xcursor(server.seat->cursor->wlr_cursor,
-						   server.seat->cursor->cursor_mgr, cursor);
+	comp_cursor_set_image(server.seat->cursor, cursor);
 }
 
 static void edge_destroy(struct comp_widget *widget) {
 	struct comp_resize_edge *edge = wl_container_of(widget, edge, widget);
 
-	free(edge);
+	comp_slab_free(&server.slabs.resize_edges, edge);
 }
 
 static bool edge_handle_accepts_input(struct comp_widget *widget,
@@ -121,7 +120,8 @@ struct comp_resize_edge *
 comp_resize_edge_init(struct comp_server *server,
 					  struct comp_toplevel *toplevel,
 					  enum xdg_toplevel_resize_edge resize_edge) {
-	struct comp_resize_edge *edge = calloc(1, sizeof(struct comp_resize_edge));
+	struct comp_resize_edge *edge =
+		comp_slab_alloc(&server->slabs.resize_edges);
 	if (edge == NULL) {
 		wlr_log(WLR_ERROR, "Failed to allocate comp_titlebar");
 		return NULL;
@@ -131,7 +131,7 @@ comp_resize_edge_init(struct comp_server *server,
 						  toplevel->decoration_scene_tree,
 						  shadow_data_get_default(),
 						  &comp_resize_edge_widget_impl)) {
-		free(edge);
+		comp_slab_free(&server->slabs.resize_edges, edge);
 		return NULL;
 	}
 
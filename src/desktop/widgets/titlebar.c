@@ -227,8 +227,9 @@ static void titlebar_draw(struct comp_widget *widget, cairo_t *cr,
 	const int toplevel_radius = toplevel->corner_radius;
 	const double toplevel_x = BORDER_WIDTH;
 	const int toplevel_y = TITLEBAR_HEIGHT;
-	const int toplevel_width = toplevel->state.width;
-	const int toplevel_height = toplevel->state.height;
+	// Derived from the surface size, which might be a resize preview
+	const int toplevel_width = surface_width - BORDER_WIDTH * 2;
+	const int toplevel_height = surface_height - TITLEBAR_HEIGHT - BORDER_WIDTH;
 
 	const int titlebar_radii = titlebar->widget.corner_radius;
 	const int button_margin = titlebar_radii;
@@ -373,8 +374,7 @@ static void titlebar_draw(struct comp_widget *widget, cairo_t *cr,
 					 (TITLEBAR_BUTTON_SIZE + TITLEBAR_BUTTON_SPACING) * i,
 				.y = BORDER_WIDTH + TITLEBAR_BUTTON_MARGIN,
 			};
-			enum comp_titlebar_button_type type =
-				*((enum comp_titlebar_button_type *)button->data);
+			enum comp_titlebar_button_type type = button->data;
 
 			// Colors
 			uint32_t focus_color;
@@ -463,15 +463,11 @@ static void titlebar_destroy(struct comp_widget *widget) {
 	struct comp_titlebar *titlebar = wl_container_of(widget, titlebar, widget);
 	titlebar->toplevel->titlebar = NULL;
 
-	free(titlebar->buttons.close.data);
-	free(titlebar->buttons.fullscreen.data);
-	free(titlebar->buttons.minimize.data);
-
 	listener_remove(&titlebar->output_enter);
 	listener_remove(&titlebar->output_leave);
 
 	pango_font_description_free(titlebar->font);
-	free(titlebar);
+	comp_slab_free(&server.slabs.titlebars, titlebar);
 }
 
 static const struct comp_widget_impl comp_titlebar_widget_impl = {
@@ -534,7 +530,7 @@ static void handle_output_leave(struct wl_listener *listener, void *data) {
 
 struct comp_titlebar *comp_titlebar_init(struct comp_server *server,
 										 struct comp_toplevel *toplevel) {
-	struct comp_titlebar *titlebar = calloc(1, sizeof(struct comp_titlebar));
+	struct comp_titlebar *titlebar = comp_slab_alloc(&server->slabs.titlebars);
 	if (!titlebar) {
 		wlr_log(WLR_ERROR, "Failed to allocate comp_titlebar");
 		return NULL;
@@ -551,7 +547,7 @@ struct comp_titlebar *comp_titlebar_init(struct comp_server *server,
 	if (!comp_widget_init(&titlebar->widget, server, &toplevel->object,
 						  toplevel->decoration_scene_tree, shadow_data,
 						  &comp_titlebar_widget_impl)) {
-		free(titlebar);
+		comp_slab_free(&server->slabs.titlebars, titlebar);
 		return NULL;
 	}
 
@@ -604,37 +600,10 @@ struct comp_titlebar *comp_titlebar_init(struct comp_server *server,
 	titlebar->buttons.fullscreen.handle_click = handle_fullscreen_click;
 	titlebar->buttons.minimize.handle_click = handle_minimize_click;
 
-	// Close
-	titlebar->buttons.close.data = malloc(sizeof(int));
-	if (!titlebar->buttons.close.data) {
-		wlr_log(WLR_ERROR, "Could not allocate titlebar close button data");
-		goto malloc_close_button_err;
-	}
-	*((int *)titlebar->buttons.close.data) = COMP_TITLEBAR_BUTTON_CLOSE;
-	// Fullscreen
-	titlebar->buttons.fullscreen.data = malloc(sizeof(int));
-	if (!titlebar->buttons.fullscreen.data) {
-		wlr_log(WLR_ERROR,
-				"Could not allocate titlebar fullscreen button data");
-		goto malloc_fullscreen_button_err;
-	}
-	*((int *)titlebar->buttons.fullscreen.data) =
-		COMP_TITLEBAR_BUTTON_FULLSCREEN;
-	// Minimize
-	titlebar->buttons.minimize.data = malloc(sizeof(int));
-	if (!titlebar->buttons.minimize.data) {
-		wlr_log(WLR_ERROR, "Could not allocate titlebar minimize button data");
-		goto malloc_minimize_button_err;
-	}
-	*((int *)titlebar->buttons.minimize.data) = COMP_TITLEBAR_BUTTON_MINIMIZE;
+	// Button types
+	titlebar->buttons.close.data = COMP_TITLEBAR_BUTTON_CLOSE;
+	titlebar->buttons.fullscreen.data = COMP_TITLEBAR_BUTTON_FULLSCREEN;
+	titlebar->buttons.minimize.data = COMP_TITLEBAR_BUTTON_MINIMIZE;
 
 	return titlebar;
-
-malloc_minimize_button_err:
-	free(titlebar->buttons.fullscreen.data);
-malloc_fullscreen_button_err:
-	free(titlebar->buttons.close.data);
-malloc_close_button_err:
-	free(titlebar);
-	return NULL;
 }
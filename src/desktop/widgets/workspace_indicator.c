@@ -1,5 +1,8 @@
 #include <cairo.h>
+#include <pango/pango-layout.h>
+#include <pango/pangocairo.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <wlr/util/log.h>
 
@@ -11,6 +11,7 @@
 #include <wlr/util/log.h>
 #include <xdg-shell-protocol.h>
 
+#include "comp/ipc.h"
 #include "comp/object.h"
 #include "comp/output.h"
 #include "comp/server.h"
@@ -332,6 +333,7 @@ static void xdg_toplevel_set_title(struct wl_listener *listener, void *data) {
 	}
 
 	comp_titlebar_change_title(toplevel->titlebar);
+	comp_ipc_toplevel_title(toplevel);
 }
 
 static void xdg_toplevel_set_app_id(struct wl_listener *listener, void *data) {
@@ -33,6 +33,8 @@ void set_xdg_decoration_mode(struct comp_xdg_decoration *deco) {
 
 	if (toplevel->tiling_mode == COMP_TILING_MODE_TILED &&
 		toplevel->tiling_node) {
+		// The decoration size changes the toplevel size within the node
+		tiling_node_mark_dirty(toplevel->tiling_node);
 		tiling_node_mark_workspace_dirty(toplevel->workspace);
 	}
 
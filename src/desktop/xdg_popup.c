@@ -86,6 +86,7 @@ static void xdg_popup_map(struct wl_listener *listener, void *data) {
 	struct comp_xdg_popup *popup = wl_container_of(listener, popup, map);
 
 	xdg_popup_apply_effects(popup->xdg_scene_tree, popup);
+	comp_input_index_invalidate(&server.input_index);
 }
 
 static void xdg_popup_destroy(struct wl_listener *listener, void *data) {
@@ -161,6 +162,8 @@ static void xdg_popup_commit(struct wl_listener *listener, void *data) {
 	if (popup->wlr_popup->base->initial_commit) {
 		popup_unconstrain(popup);
 	}
+	// The scene applies the new popup geometry on commit
+	comp_input_index_invalidate(&server.input_index);
 }
 
 static void xdg_popup_reposition(struct wl_listener *listener, void *data) {
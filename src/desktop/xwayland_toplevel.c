@@ -6,6 +6,7 @@
 #include <wlr/types/wlr_xdg_activation_v1.h>
 #include <wlr/util/log.h>
 
+#include "comp/ipc.h"
 #include "comp/output.h"
 #include "comp/tiling_node.h"
 #include "comp/transaction.h"
@@ -362,6 +363,7 @@ static void xway_toplevel_set_title(struct wl_listener *listener, void *data) {
 	}
 
 	comp_titlebar_change_title(toplevel->titlebar);
+	comp_ipc_toplevel_title(toplevel);
 }
 
 static void xway_toplevel_set_startup_id(struct wl_listener *listener,
@@ -399,6 +401,8 @@ static void xway_toplevel_set_decorations(struct wl_listener *listener,
 	comp_transaction_commit_dirty(true);
 	if (toplevel->tiling_mode == COMP_TILING_MODE_TILED &&
 		toplevel->tiling_node) {
+		// The decoration size changes the toplevel size within the node
+		tiling_node_mark_dirty(toplevel->tiling_node);
 		tiling_node_mark_workspace_dirty(toplevel->workspace);
 	}
 }
@@ -29,6 +29,7 @@ static void unmanaged_set_position(struct comp_xwayland_unmanaged *unmanaged,
 
 	wlr_scene_node_set_position(&unmanaged->surface_scene->buffer->node, x - lx,
 								y - ly);
+	comp_input_index_invalidate(&server.input_index);
 }
 
 /*
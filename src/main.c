@@ -1,7 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <getopt.h>
-#include <pthread.h>
+#include <glib.h>
 #include <scenefx/render/fx_renderer/fx_renderer.h>
 #include <scenefx/types/wlr_scene.h>
 #include <stdbool.h>
@@ -20,6 +20,7 @@
 #include <wlr/render/allocator.h>
 #include <wlr/types/wlr_alpha_modifier_v1.h>
 #include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_cursor_shape_v1.h>
 #include <wlr/types/wlr_data_control_v1.h>
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/types/wlr_export_dmabuf_v1.h>
@@ -50,14 +51,24 @@
 #include <wlr/xwayland.h>
 
 #include "comp/animation_mgr.h"
+#include "comp/ipc.h"
 #include "comp/lock.h"
+#include "comp/memory.h"
+#include "comp/memory_pressure.h"
 #include "comp/output.h"
 #include "comp/server.h"
+#include "comp/slab.h"
+#include "comp/spawn.h"
+#include "comp/startup_trace.h"
+#include "comp/trace.h"
 #include "constants.h"
 #include "desktop/layer_shell.h"
 #include "desktop/xdg.h"
 #include "desktop/xdg_decoration.h"
 #include "seat/cursor.h"
+#include "seat/input.h"
+#include "seat/keybindings.h"
+#include "seat/latency.h"
 #include "seat/seat.h"
 #include "util.h"
 
@@ -67,8 +78,12 @@ static void print_help(void) {
 	printf("Usage:\n");
 	printf("\t-s <cmd>\tStartup command\n");
 	printf("\t-l <DEBUG|INFO>\tLog level\n");
-	printf("\t-D <log-txn-timings>\tLog level\n");
+	printf("\t-D <log-txn-timings|input-latency|input-latency-bench|"
+		   "startup-trace|startup-trace-exit|slab-stats|memory-log|trace>\t"
+		   "Debug options\n");
 	printf("\t-o <int>\tNumber of additional testing outputs\n");
+	printf("\t-X <int>\tStart Xwayland on the first X client and stop it "
+		   "after <int> idle seconds (0 keeps it running)\n");
 }
 
 static void create_output(struct wlr_backend *backend, void *data) {
@@ -103,23 +118,15 @@ void comp_create_extra_output(void) {
 	}
 }
 
-/** Initialize GTK */
-static void *init_gtk(void *attr) {
-	wlr_log(WLR_INFO, "Initializing GTK");
-	if (!gtk_init_check(NULL, NULL)) {
-		wlr_log(WLR_ERROR, "Failed to initialize GTK");
-	}
-
-	return NULL;
-}
-
 int main(int argc, char *argv[]) {
 	char *startup_cmd = NULL;
 	enum wlr_log_importance log_importance = WLR_ERROR;
 	int num_test_outputs = 1;
+	bool xwayland_lazy = false;
+	int xwayland_idle_timeout_s = 0;
 
 	int c;
-	while ((c = getopt(argc, argv, "s:o:l:D:h")) != -1) {
+	while ((c = getopt(argc, argv, "s:o:l:D:X:h")) != -1) {
 		switch (c) {
 		case 's':
 			startup_cmd = optarg;
@@ -134,6 +141,22 @@ int main(int argc, char *argv[]) {
 		case 'D':
 			if (strcmp(optarg, "log-txn-timings") == 0) {
 				server.debug.log_txn_timings = true;
+			} else if (strcmp(optarg, "input-latency") == 0) {
+				server.debug.input_latency = true;
+			} else if (strcmp(optarg, "input-latency-bench") == 0) {
+				server.debug.input_latency = true;
+				server.debug.input_latency_bench = true;
+			} else if (strcmp(optarg, "startup-trace") == 0) {
+				server.debug.startup_trace = true;
+			} else if (strcmp(optarg, "startup-trace-exit") == 0) {
+				server.debug.startup_trace = true;
+				server.debug.startup_trace_exit = true;
+			} else if (strcmp(optarg, "slab-stats") == 0) {
+				server.debug.slab_stats = true;
+			} else if (strcmp(optarg, "memory-log") == 0) {
+				server.debug.memory_log = true;
+			} else if (strcmp(optarg, "trace") == 0) {
+				server.debug.trace = true;
 			}
 			break;
 		case 'o':;
@@ -149,6 +172,15 @@ int main(int argc, char *argv[]) {
 			}
 			num_test_outputs += extra_outputs;
 			break;
+		case 'X':;
+			long idle_timeout = strtol(optarg, &endptr, 10);
+			if (endptr == optarg || idle_timeout < 0) {
+				fprintf(stderr, "Could not parse Xwayland idle timeout\n");
+				return 1;
+			}
+			xwayland_lazy = true;
+			xwayland_idle_timeout_s = idle_timeout;
+			break;
 		default:
 			print_help();
 			return 0;
@@ -161,16 +193,35 @@ int main(int argc, char *argv[]) {
 
 	wlr_log_init(log_importance, NULL);
 
+	if (server.debug.trace) {
+		comp_trace_init();
+	}
+
+	if (server.debug.startup_trace) {
+		server.startup_trace = comp_startup_trace_create(
+			startup_cmd != NULL, server.debug.startup_trace_exit);
+		if (!server.startup_trace) {
+			return 1;
+		}
+	}
+
 	/* The Wayland display is managed by libwayland. It handles accepting
 	 * clients from the Unix socket, manging Wayland globals, and so on. */
 	server.wl_display = wl_display_create();
 
 	server.wl_event_loop = wl_display_get_event_loop(server.wl_display);
+	comp_slabs_init();
+	// Before any output is created. Not fatal, everything else works without
+	// the IPC.
+	comp_ipc_init();
 	// Initialize animation manager
 	server.animation_mgr = comp_animation_mgr_init();
 
 	// Transactions
 	wl_list_init(&server.dirty_objects);
+	comp_input_index_init(&server.input_index);
+	comp_spawn_init();
+	comp_startup_trace_phase("display");
 
 	/* The backend is a wlroots feature which abstracts the underlying input and
 	 * output hardware. The autocreate option will choose the most suitable
@@ -193,6 +244,7 @@ int main(int argc, char *argv[]) {
 	} else {
 		wlr_multi_backend_add(server.backend, server.headless_backend);
 	}
+	comp_startup_trace_phase("backend");
 
 	/* Autocreates a renderer, either Pixman, GLES2 or Vulkan for us. The user
 	 * can also specify a renderer using the WLR_RENDERER env var.
@@ -205,6 +257,7 @@ int main(int argc, char *argv[]) {
 	}
 
 	wlr_renderer_init_wl_display(server.renderer, server.wl_display);
+	comp_startup_trace_phase("renderer");
 
 	/* Autocreates an allocator for us.
 	 * The allocator is the bridge between the renderer and the backend. It
@@ -216,6 +269,7 @@ int main(int argc, char *argv[]) {
 		wlr_log(WLR_ERROR, "failed to create wlr_allocator");
 		return 1;
 	}
+	comp_startup_trace_phase("allocator");
 
 	/* This creates some hands-off wlroots interfaces. The compositor is
 	 * necessary for clients to allocate surfaces, the subcompositor allows to
@@ -227,7 +281,9 @@ int main(int argc, char *argv[]) {
 	server.compositor = wlr_compositor_create(
 		server.wl_display, WL_COMPOSITOR_VERSION, server.renderer);
 	wlr_subcompositor_create(server.wl_display);
+	comp_input_index_track_surfaces(&server.input_index, server.compositor);
 	wlr_data_device_manager_create(server.wl_display);
+	comp_startup_trace_phase("compositor");
 
 	/*
 	 * Output
@@ -269,6 +325,7 @@ int main(int argc, char *argv[]) {
 		comp_output_power_manager_set_mode;
 	wl_signal_add(&server.output_power_manager_v1->events.set_mode,
 				  &server.output_power_manager_set_mode);
+	comp_startup_trace_phase("output-management");
 
 	/*
 	 * Scene
@@ -315,6 +372,7 @@ int main(int argc, char *argv[]) {
 		HEADLESS_FALLBACK_OUTPUT_HEIGHT);
 	wlr_output_set_name(wlr_output, "FALLBACK");
 	server.fallback_output = comp_output_create(&server, wlr_output);
+	comp_startup_trace_phase("scene");
 
 	/*
 	 * XDG Toplevels
@@ -353,14 +411,15 @@ int main(int argc, char *argv[]) {
 	server.new_layer_surface.notify = layer_shell_new_surface;
 	wl_signal_add(&server.layer_shell->events.new_surface,
 				  &server.new_layer_surface);
+	comp_startup_trace_phase("shells");
 
 	/*
 	 * XWayland
 	 */
 
-	server.xwayland_mgr.wlr_xwayland =
-		wlr_xwayland_create(server.wl_display, server.compositor, false);
-	if (!server.xwayland_mgr.wlr_xwayland) {
+	if (!comp_xwayland_mgr_create(&server.xwayland_mgr, server.wl_display,
+								  server.compositor, xwayland_lazy,
+								  xwayland_idle_timeout_s)) {
 		wlr_log(WLR_ERROR, "Failed to start Xwayland");
 		unsetenv("DISPLAY");
 	} else {
@@ -368,12 +427,18 @@ int main(int argc, char *argv[]) {
 		listener_connect(&server.xwayland_mgr.wlr_xwayland->events.new_surface,
 						 &server.new_xwayland_surface, xwayland_new_surface);
 
+		listener_init(&server.xwayland_start);
+		listener_connect(
+			&server.xwayland_mgr.wlr_xwayland->server->events.start,
+			&server.xwayland_start, xwayland_start_cb);
+
 		listener_init(&server.xwayland_ready);
 		listener_connect(&server.xwayland_mgr.wlr_xwayland->events.ready,
 						 &server.xwayland_ready, xwayland_ready_cb);
 
 		setenv("DISPLAY", server.xwayland_mgr.wlr_xwayland->display_name, true);
 	}
+	comp_startup_trace_phase("xwayland");
 
 	server.relative_pointer_manager =
 		wlr_relative_pointer_manager_v1_create(server.wl_display);
@@ -389,6 +454,22 @@ int main(int argc, char *argv[]) {
 	 */
 
 	server.seat = comp_seat_create(&server);
+	if (!comp_input_keymap_cache_init()) {
+		return 1;
+	}
+	comp_icon_loader_init();
+	comp_memory_pressure_init();
+	server.keybindings = comp_keybindings_create();
+	if (!server.keybindings) {
+		return 1;
+	}
+	if (server.debug.input_latency) {
+		server.latency = comp_latency_create();
+		if (!server.latency) {
+			return 1;
+		}
+	}
+	comp_startup_trace_phase("seat");
 
 	/*
 	 * Init protocols
@@ -402,6 +483,13 @@ int main(int argc, char *argv[]) {
 	wlr_fractional_scale_manager_v1_create(server.wl_display, 1);
 	wlr_data_control_manager_v1_create(server.wl_display);
 
+	server.cursor_shape_manager = wlr_cursor_shape_manager_v1_create(
+		server.wl_display, CURSOR_SHAPE_VERSION);
+	server.request_set_cursor_shape.notify =
+		comp_cursor_handle_request_set_shape;
+	wl_signal_add(&server.cursor_shape_manager->events.request_set_shape,
+				  &server.request_set_cursor_shape);
+
 	/*
 	 * Server side decorations
 	 */
@@ -428,6 +516,7 @@ int main(int argc, char *argv[]) {
 				  &server.new_xdg_decoration);
 
 	comp_session_lock_create();
+	comp_startup_trace_phase("protocols");
 
 	/*
 	 * Wayland socket
@@ -447,14 +536,13 @@ int main(int argc, char *argv[]) {
 		wl_display_destroy(server.wl_display);
 		return 1;
 	}
+	comp_startup_trace_phase("backend-start");
 
 	/* Set the WAYLAND_DISPLAY environment variable to our socket and run the
 	 * startup command if requested. */
 	setenv("WAYLAND_DISPLAY", socket, true);
 	if (startup_cmd) {
-		if (fork() == 0) {
-			execl("/bin/sh", "/bin/sh", "-c", startup_cmd, (void *)NULL);
-		}
+		comp_spawn(startup_cmd);
 	}
 
 	// Create additional outputs
@@ -464,8 +552,15 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	pthread_t init_gtk_thread;
-	pthread_create(&init_gtk_thread, NULL, init_gtk, NULL);
+	if (server.debug.input_latency_bench &&
+		!comp_latency_bench_start(server.latency)) {
+		return 1;
+	}
+	if (server.debug.memory_log && !comp_memory_log_start()) {
+		return 1;
+	}
+	comp_startup_trace_phase("startup-command");
+	comp_startup_trace_run();
 
 	/* Run the Wayland event loop. This does not return until you exit the
 	 * compositor. Starting the backend rigged up all of the necessary event
@@ -477,14 +572,40 @@ int main(int argc, char *argv[]) {
 	// Once wl_display_run returns, we destroy all clients then shut down the
 	// server.
 
-	pthread_cancel(init_gtk_thread);
-	wlr_xwayland_destroy(server.xwayland_mgr.wlr_xwayland);
+	if (server.latency) {
+		comp_latency_report(server.latency);
+		comp_latency_destroy(server.latency);
+		server.latency = NULL;
+	}
+	if (server.debug.slab_stats) {
+		comp_slabs_report();
+	}
+	comp_memory_log_stop();
+	if (server.startup_trace) {
+		// No-op if it has already been reported
+		comp_startup_trace_report(server.startup_trace);
+		comp_startup_trace_destroy(server.startup_trace);
+		server.startup_trace = NULL;
+	}
+	if (server.debug.trace) {
+		g_free(comp_trace_export());
+		comp_trace_finish();
+	}
+	comp_ipc_finish();
+	comp_xwayland_mgr_destroy(&server.xwayland_mgr);
 	wl_display_destroy_clients(server.wl_display);
 	comp_cursor_destroy(server.seat->cursor);
 	wlr_output_layout_destroy(server.output_layout);
 	comp_animation_mgr_destroy(server.animation_mgr);
+	comp_input_index_finish(&server.input_index);
+	comp_input_keymap_cache_finish();
+	comp_memory_pressure_finish();
+	comp_icon_loader_finish();
+	comp_spawn_finish();
+	comp_keybindings_destroy(server.keybindings);
 	wl_display_destroy(server.wl_display);
 	wlr_scene_node_destroy(&server.root_scene->tree.node);
+	comp_slabs_finish();
 
 	return 0;
 }
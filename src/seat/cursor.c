@@ -1,9 +1,14 @@
 #include <assert.h>
 #include <libevdev/libevdev.h>
+#include <math.h>
 #include <scenefx/types/wlr_scene.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_cursor_shape_v1.h>
 #include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_pointer_constraints_v1.h>
 #include <wlr/types/wlr_relative_pointer_v1.h>
 #include <wlr/types/wlr_seat.h>
@@ -14,12 +19,16 @@
 
 #include "comp/object.h"
 #include "comp/output.h"
+#include "comp/overview.h"
 #include "comp/saved_object.h"
 #include "comp/server.h"
+#include "comp/trace.h"
+#include "comp/transaction.h"
 #include "comp/widget.h"
 #include "constants.h"
 #include "desktop/toplevel.h"
 #include "seat/cursor.h"
+#include "seat/latency.h"
 #include "seat/seat.h"
 
 static void set_active_output_from_cursor_pos(struct comp_cursor *cursor) {
@@ -38,24 +47,93 @@ static void set_active_output_from_cursor_pos(struct comp_cursor *cursor) {
 void comp_cursor_reset_cursor_mode(struct comp_seat *seat) {
 	if (seat->cursor->cursor_mode == COMP_CURSOR_RESIZE) {
 		comp_toplevel_set_resizing(seat->grabbed_toplevel, false);
+		// Commit the final size that might've been held back by the pacing
+		comp_transaction_commit_dirty(true);
 	}
 
 	/* Reset the cursor mode to passthrough. */
 	seat->cursor->cursor_mode = COMP_CURSOR_PASSTHROUGH;
+	seat->cursor->grab_motion.pending = false;
 	seat->grabbed_toplevel = NULL;
 
 	// Set the active output
 	set_active_output_from_cursor_pos(seat->cursor);
 }
 
-static void process_cursor_motion(struct comp_cursor *cursor, uint32_t time) {
+void comp_cursor_set_image(struct comp_cursor *cursor, const char *image) {
+	// Avoid looking up and uploading the same xcursor on every motion event
+	if (cursor->image && strcmp(cursor->image, image) == 0) {
+		return;
+	}
+	cursor->image = image;
+	cursor->image_client = NULL;
+	wlr_cursor_set_xcursor(cursor->wlr_cursor, cursor->cursor_mgr, image);
+}
+
+void comp_cursor_set_client_image(struct comp_cursor *cursor,
+								  struct wl_client *client,
+								  struct wlr_surface *surface, int hotspot_x,
+								  int hotspot_y) {
+	cursor->image = NULL;
+	cursor->image_client = client;
+	wlr_cursor_set_surface(cursor->wlr_cursor, surface, hotspot_x, hotspot_y);
+}
+
+void comp_cursor_load_scale(struct comp_cursor *cursor, float scale) {
+	if (!wlr_xcursor_manager_load(cursor->cursor_mgr, scale)) {
+		wlr_log(WLR_ERROR, "Could not load the cursor theme at scale %.2f",
+				scale);
+	}
+}
+
+void comp_cursor_flush_grab_motion(struct comp_cursor *cursor) {
+	if (!cursor->grab_motion.pending) {
+		return;
+	}
+	cursor->grab_motion.pending = false;
+
 	struct comp_server *server = cursor->server;
-	// If the mode is non-passthrough, delegate to those functions.
-	if (cursor->cursor_mode == COMP_CURSOR_MOVE) {
-		comp_toplevel_process_cursor_move(server, time);
+	if (!server->seat->grabbed_toplevel) {
 		return;
-	} else if (cursor->cursor_mode == COMP_CURSOR_RESIZE) {
-		comp_toplevel_process_cursor_resize(server, time);
+	}
+
+	switch (cursor->cursor_mode) {
+	case COMP_CURSOR_PASSTHROUGH:
+		break;
+	case COMP_CURSOR_MOVE:
+		comp_toplevel_process_cursor_move(server, cursor->grab_motion.time);
+		break;
+	case COMP_CURSOR_RESIZE:
+		comp_toplevel_process_cursor_resize(server, cursor->grab_motion.time);
+		break;
+	}
+}
+
+void comp_cursor_queue_grab_motion(struct comp_cursor *cursor, uint32_t time) {
+	cursor->grab_motion.time = time;
+	if (cursor->grab_motion.pending) {
+		return;
+	}
+	cursor->grab_motion.pending = true;
+
+	// Make sure that a frame is rendered even if nothing else is damaged
+	struct wlr_output *wlr_output = wlr_output_layout_output_at(
+		server.output_layout, cursor->wlr_cursor->x, cursor->wlr_cursor->y);
+	if (wlr_output) {
+		wlr_output_schedule_frame(wlr_output);
+	} else {
+		comp_cursor_flush_grab_motion(cursor);
+	}
+}
+
+static void process_cursor_motion(struct comp_cursor *cursor, uint32_t time,
+								  const struct timespec *arrival) {
+	struct comp_server *server = cursor->server;
+	// If the mode is non-passthrough, accumulate the motion until the next
+	// output frame.
+	if (cursor->cursor_mode == COMP_CURSOR_MOVE ||
+		cursor->cursor_mode == COMP_CURSOR_RESIZE) {
+		comp_cursor_queue_grab_motion(cursor, time);
 		return;
 	}
 
@@ -76,8 +154,7 @@ static void process_cursor_motion(struct comp_cursor *cursor, uint32_t time) {
 		/* If there's no toplevel under the cursor, set the cursor image to a
 		 * default. This is what makes the cursor image appear when you move it
 		 * around the screen, not over any toplevels. */
-		wlr_cursor_set_xcursor(cursor->wlr_cursor, cursor->cursor_mgr,
-							   "default");
+		comp_cursor_set_image(cursor, "default");
 		wlr_seat_pointer_notify_clear_focus(seat);
 
 		if (server->seat->hovered_widget) {
@@ -123,6 +200,8 @@ static void process_cursor_motion(struct comp_cursor *cursor, uint32_t time) {
 						wlr_seat_pointer_notify_enter(seat, surface, sx, sy);
 					}
 					wlr_seat_pointer_notify_motion(seat, time, sx, sy);
+					comp_latency_input_delivered(COMP_LATENCY_INPUT_POINTER,
+												 arrival, surface);
 				}
 			} else {
 				wlr_seat_pointer_notify_clear_focus(seat);
@@ -146,8 +225,7 @@ static void process_cursor_motion(struct comp_cursor *cursor, uint32_t time) {
 			comp_widget_pointer_motion(widget, sx, sy);
 			wlr_seat_pointer_clear_focus(server->seat->wlr_seat);
 			if (!widget->sets_cursor) {
-				wlr_cursor_set_xcursor(cursor->wlr_cursor, cursor->cursor_mgr,
-									   "left_ptr");
+				comp_cursor_set_image(cursor, "left_ptr");
 			}
 			break;
 		case COMP_OBJECT_TYPE_OUTPUT:
@@ -160,6 +238,9 @@ static void process_cursor_motion(struct comp_cursor *cursor, uint32_t time) {
 static void pointer_motion(struct comp_cursor *cursor, uint32_t time,
 						   struct wlr_input_device *device, double dx,
 						   double dy, double dx_unaccel, double dy_unaccel) {
+	struct timespec arrival;
+	comp_latency_stamp(&arrival);
+
 	wlr_relative_pointer_manager_v1_send_relative_motion(
 		cursor->server->relative_pointer_manager,
 		cursor->server->seat->wlr_seat, (uint64_t)time * 1000, dx, dy,
@@ -192,7 +273,7 @@ static void pointer_motion(struct comp_cursor *cursor, uint32_t time,
 
 	wlr_cursor_move(cursor->wlr_cursor, device, dx, dy);
 
-	process_cursor_motion(cursor, time);
+	process_cursor_motion(cursor, time, &arrival);
 }
 
 static void comp_server_cursor_motion(struct wl_listener *listener,
@@ -207,9 +288,11 @@ static void comp_server_cursor_motion(struct wl_listener *listener,
 	 * special configuration applied for the specific input device which
 	 * generated the event. You can pass NULL for the device if you want to move
 	 * the cursor around without any input. */
+	const uint64_t trace_start = comp_trace_begin();
 	pointer_motion(cursor, event->time_msec, &event->pointer->base,
 				   event->delta_x, event->delta_y, event->unaccel_dx,
 				   event->unaccel_dy);
+	comp_trace_end("cursor_motion", trace_start);
 }
 
 static void comp_server_cursor_motion_absolute(struct wl_listener *listener,
@@ -223,6 +306,7 @@ static void comp_server_cursor_motion_absolute(struct wl_listener *listener,
 	struct comp_cursor *cursor =
 		wl_container_of(listener, cursor, cursor_motion_absolute);
 	struct wlr_pointer_motion_absolute_event *event = data;
+	const uint64_t trace_start = comp_trace_begin();
 	// wlr_cursor_warp_absolute(server->cursor, &event->pointer->base, event->x,
 	// 						 event->y);
 
@@ -236,6 +320,7 @@ static void comp_server_cursor_motion_absolute(struct wl_listener *listener,
 
 	pointer_motion(cursor, event->time_msec, &event->pointer->base, dx, dy, dx,
 				   dy);
+	comp_trace_end("cursor_motion_absolute", trace_start);
 }
 
 static bool try_resize_or_move_toplevel(struct comp_object *object,
@@ -290,19 +375,29 @@ static bool try_resize_or_move_toplevel(struct comp_object *object,
 	return false;
 }
 
-static void comp_server_cursor_button(struct wl_listener *listener,
-									  void *data) {
-	/* This event is forwarded by the cursor when a pointer emits a button
-	 * event. */
-	struct comp_cursor *cursor =
-		wl_container_of(listener, cursor, cursor_button);
-	struct wlr_pointer_button_event *event = data;
+static void process_cursor_button(struct comp_cursor *cursor,
+								  struct wlr_pointer_button_event *event) {
 	struct comp_server *server = cursor->server;
 
 	if (server->comp_session_lock.locked) {
 		goto notify;
 	}
 
+	if (event->state == WL_POINTER_BUTTON_STATE_PRESSED) {
+		// Clicks only pick a thumbnail while the overview is shown
+		double x = cursor->wlr_cursor->x;
+		double y = cursor->wlr_cursor->y;
+		struct wlr_output *wlr_output =
+			wlr_output_layout_output_at(server->output_layout, x, y);
+		if (wlr_output && wlr_output->data) {
+			wlr_output_layout_output_coords(server->output_layout, wlr_output,
+											&x, &y);
+			if (comp_overview_click(wlr_output->data, x, y)) {
+				return;
+			}
+		}
+	}
+
 	double sx, sy;
 	struct wlr_scene_buffer *scene_buffer = NULL;
 	struct wlr_surface *surface = NULL;
@@ -310,6 +405,9 @@ static void comp_server_cursor_button(struct wl_listener *listener,
 		comp_object_at(server, cursor->wlr_cursor->x, cursor->wlr_cursor->y,
 					   &sx, &sy, &scene_buffer, &surface);
 	if (event->state == WL_POINTER_BUTTON_STATE_RELEASED) {
+		// Apply the final grab position before finishing
+		comp_cursor_flush_grab_motion(cursor);
+
 		// Finish moving tiled window
 		if (cursor->cursor_mode == COMP_CURSOR_MOVE &&
 			server->seat->grabbed_toplevel &&
@@ -410,17 +508,30 @@ notify:
 								   event->button, event->state);
 }
 
+static void comp_server_cursor_button(struct wl_listener *listener,
+									  void *data) {
+	/* This event is forwarded by the cursor when a pointer emits a button
+	 * event. */
+	struct comp_cursor *cursor =
+		wl_container_of(listener, cursor, cursor_button);
+	const uint64_t trace_start = comp_trace_begin();
+	process_cursor_button(cursor, data);
+	comp_trace_end("cursor_button", trace_start);
+}
+
 static void comp_server_cursor_axis(struct wl_listener *listener, void *data) {
 	/* This event is forwarded by the cursor when a pointer emits an axis event,
 	 * for example when you move the scroll wheel. */
 	struct comp_cursor *cursor = wl_container_of(listener, cursor, cursor_axis);
 	struct comp_server *server = cursor->server;
 	struct wlr_pointer_axis_event *event = data;
+	const uint64_t trace_start = comp_trace_begin();
 	/* Notify the client with pointer focus of the axis event. */
 	wlr_seat_pointer_notify_axis(server->seat->wlr_seat, event->time_msec,
 								 event->orientation, event->delta,
 								 event->delta_discrete, event->source,
 								 event->relative_direction);
+	comp_trace_end("cursor_axis", trace_start);
 }
 
 static void comp_server_cursor_frame(struct wl_listener *listener, void *data) {
@@ -430,8 +541,10 @@ static void comp_server_cursor_frame(struct wl_listener *listener, void *data) {
 	 * same time, in which case a frame event won't be sent in between. */
 	struct comp_cursor *cursor =
 		wl_container_of(listener, cursor, cursor_frame);
+	const uint64_t trace_start = comp_trace_begin();
 	/* Notify the client with pointer focus of the frame event. */
 	wlr_seat_pointer_notify_frame(server.seat->wlr_seat);
+	comp_trace_end("cursor_frame", trace_start);
 }
 
 void comp_cursor_destroy(struct comp_cursor *cursor) {
@@ -545,11 +658,36 @@ struct comp_cursor *comp_cursor_create(struct comp_seat *seat) {
 
 	cursor->wlr_cursor = wlr_cursor;
 
-	wlr_cursor_set_xcursor(cursor->wlr_cursor, cursor->cursor_mgr, "left_ptr");
+	comp_cursor_set_image(cursor, "left_ptr");
 
 	return cursor;
 }
 
+/*
+ * Cursor shape
+ */
+
+void comp_cursor_handle_request_set_shape(struct wl_listener *listener,
+										  void *data) {
+	struct wlr_cursor_shape_manager_v1_request_set_shape_event *event = data;
+	struct comp_seat *seat = server.seat;
+
+	// Tablet tools aren't supported
+	if (event->device_type !=
+		WLR_CURSOR_SHAPE_MANAGER_V1_DEVICE_TYPE_POINTER) {
+		return;
+	}
+
+	/* Same as with cursor surfaces, only the client with pointer focus can
+	 * change the shape. */
+	if (seat->wlr_seat->pointer_state.focused_client != event->seat_client) {
+		return;
+	}
+
+	// Uses the themed xcursor, the client doesn't upload anything
+	comp_cursor_set_image(seat->cursor, wlr_cursor_shape_v1_name(event->shape));
+}
+
 /*
  * Pointer constraint
  *
@@ -1,25 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <libinput.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
 #include <wlr/backend/libinput.h>
 #include <wlr/config.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <wlr/types/wlr_seat.h>
 
+#include "comp/server.h"
 #include "constants.h"
 #include "seat/input.h"
 #include "seat/seat.h"
 #include "wlr/util/log.h"
 
-static struct xkb_keymap *get_keymap(struct wlr_keyboard *kb) {
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_SECURE_GETENV);
-	if (!context) {
-		wlr_log(WLR_ERROR, "Could not create new XKB Context");
+/*
+ * Keymap cache
+ */
+
+static bool rule_name_equals(const char *a, const char *b) {
+	if (!a || !b) {
+		return a == b;
+	}
+	return strcmp(a, b) == 0;
+}
+
+static char *rule_name_dup(const char *name, bool *ok) {
+	if (!name) {
+		return NULL;
+	}
+	char *dup = strdup(name);
+	if (!dup) {
+		*ok = false;
+	}
+	return dup;
+}
+
+static void keymap_cache_entry_destroy(struct comp_keymap_cache_entry *entry) {
+	wl_list_remove(&entry->link);
+	xkb_keymap_unref(entry->keymap);
+	free(entry->rules);
+	free(entry->model);
+	free(entry->layout);
+	free(entry->variant);
+	free(entry->options);
+	free(entry);
+}
+
+struct xkb_keymap *comp_input_get_keymap(const struct xkb_rule_names *names) {
+	if (!server.keymap_cache.context) {
+		wlr_log(WLR_ERROR, "The XKB keymap cache hasn't been initialized");
+		return NULL;
+	}
+
+	struct comp_keymap_cache_entry *entry;
+	wl_list_for_each(entry, &server.keymap_cache.keymaps, link) {
+		if (rule_name_equals(entry->rules, names->rules) &&
+			rule_name_equals(entry->model, names->model) &&
+			rule_name_equals(entry->layout, names->layout) &&
+			rule_name_equals(entry->variant, names->variant) &&
+			rule_name_equals(entry->options, names->options)) {
+			return entry->keymap;
+		}
+	}
+
+	struct xkb_keymap *keymap = xkb_keymap_new_from_names(
+		server.keymap_cache.context, names, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (!keymap) {
+		wlr_log(WLR_ERROR, "Could not compile XKB Layout");
+		return NULL;
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_keymap_cache_entry");
+		xkb_keymap_unref(keymap);
+		return NULL;
+	}
+	entry->keymap = keymap;
+	wl_list_insert(&server.keymap_cache.keymaps, &entry->link);
+
+	bool ok = true;
+	entry->rules = rule_name_dup(names->rules, &ok);
+	entry->model = rule_name_dup(names->model, &ok);
+	entry->layout = rule_name_dup(names->layout, &ok);
+	entry->variant = rule_name_dup(names->variant, &ok);
+	entry->options = rule_name_dup(names->options, &ok);
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_keymap_cache_entry");
+		keymap_cache_entry_destroy(entry);
 		return NULL;
 	}
 
+	wlr_log(WLR_DEBUG, "Compiled XKB keymap (layout: %s)",
+			names->layout ? names->layout : "default");
+	return keymap;
+}
+
+struct xkb_keymap *comp_input_get_configured_keymap(void) {
 	struct xkb_rule_names rules = {
 		.layout = INPUT_KB_XKB_LAYOUT,
 		.rules = INPUT_KB_XKB_RULES,
@@ -27,23 +109,39 @@ static struct xkb_keymap *get_keymap(struct wlr_keyboard *kb) {
 		.options = INPUT_KB_XKB_OPTIONS,
 		.variant = INPUT_KB_XKB_VARIANT,
 	};
-	struct xkb_keymap *keymap =
-		xkb_keymap_new_from_names(context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	return comp_input_get_keymap(&rules);
+}
 
-	xkb_context_unref(context);
-	return keymap;
+bool comp_input_keymap_cache_init(void) {
+	wl_list_init(&server.keymap_cache.keymaps);
+	server.keymap_cache.context = xkb_context_new(XKB_CONTEXT_NO_SECURE_GETENV);
+	if (!server.keymap_cache.context) {
+		wlr_log(WLR_ERROR, "Could not create new XKB Context");
+		return false;
+	}
+
+	// Compile the keymap before any keyboards get added
+	comp_input_get_configured_keymap();
+	return true;
+}
+
+void comp_input_keymap_cache_finish(void) {
+	struct comp_keymap_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &server.keymap_cache.keymaps, link) {
+		keymap_cache_entry_destroy(entry);
+	}
+	xkb_context_unref(server.keymap_cache.context);
+	server.keymap_cache.context = NULL;
 }
 
 static void set_keyboard_layout(struct wlr_keyboard *kb) {
-	struct xkb_keymap *keymap = get_keymap(kb);
-	if (!keymap) {
-		wlr_log(WLR_ERROR, "Could not compile XKB Layout");
+	struct xkb_keymap *keymap = comp_input_get_configured_keymap();
+	// Avoid serializing the same keymap again
+	if (!keymap || kb->keymap == keymap) {
 		return;
 	}
 
 	wlr_keyboard_set_keymap(kb, keymap);
-
-	xkb_keymap_unref(keymap);
 }
 
 static void libinput_configure(struct wlr_input_device *wlr_device) {
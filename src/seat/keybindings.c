@@ -0,0 +1,569 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/log.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include "comp/memory.h"
+#include "comp/memory_pressure.h"
+#include "comp/output.h"
+#include "comp/overview.h"
+#include "comp/server.h"
+#include "comp/slab.h"
+#include "comp/spawn.h"
+#include "comp/tiling_layout.h"
+#include "comp/trace.h"
+#include "comp/workspace.h"
+#include "constants.h"
+#include "desktop/toplevel.h"
+#include "seat/keybindings.h"
+#include "seat/seat.h"
+#include "util.h"
+
+// Lock modifiers
+#define IGNORED_MODIFIERS (WLR_MODIFIER_CAPS | WLR_MODIFIER_MOD2)
+
+/*
+ * Actions
+ */
+
+static void action_exit(struct comp_server *server, const char *arg) {
+	wl_display_terminate(server->wl_display);
+}
+
+static void action_reload(struct comp_server *server, const char *arg) {
+	comp_keybindings_reload(server->keybindings);
+}
+
+static void action_exec(struct comp_server *server, const char *arg) {
+	comp_spawn(arg);
+}
+
+static void action_close(struct comp_server *server, const char *arg) {
+	struct comp_toplevel *focused_toplevel = server->seat->focused_toplevel;
+	if (focused_toplevel) {
+		comp_toplevel_close(focused_toplevel);
+	}
+}
+
+static void action_focus_next(struct comp_server *server, const char *arg) {
+	struct comp_output *output = get_active_output(server);
+	struct comp_workspace *workspace = output->active_workspace;
+	/* Cycle to the next view */
+	if (wl_list_length(&workspace->toplevels) < 2) {
+		return;
+	}
+	struct comp_toplevel *next_toplevel =
+		comp_workspace_get_next_focused(workspace);
+	comp_seat_surface_focus(&next_toplevel->object,
+							comp_toplevel_get_wlr_surface(next_toplevel));
+}
+
+static void action_focus(struct comp_server *server, const char *arg) {
+	enum wlr_direction direction;
+	if (strcasecmp(arg, "left") == 0) {
+		direction = WLR_DIRECTION_LEFT;
+	} else if (strcasecmp(arg, "right") == 0) {
+		direction = WLR_DIRECTION_RIGHT;
+	} else if (strcasecmp(arg, "up") == 0) {
+		direction = WLR_DIRECTION_UP;
+	} else if (strcasecmp(arg, "down") == 0) {
+		direction = WLR_DIRECTION_DOWN;
+	} else {
+		wlr_log(WLR_ERROR, "Invalid focus direction: '%s'", arg);
+		return;
+	}
+
+	struct comp_output *output = get_active_output(server);
+	struct comp_toplevel *toplevel = comp_workspace_get_toplevel_direction(
+		output->active_workspace, direction);
+	if (toplevel) {
+		comp_seat_surface_focus(&toplevel->object,
+								comp_toplevel_get_wlr_surface(toplevel));
+	}
+}
+
+static void action_toggle_tiling(struct comp_server *server, const char *arg) {
+	// Toggle between tiling and floating
+	struct comp_toplevel *focused_toplevel = server->seat->focused_toplevel;
+	if (focused_toplevel) {
+		comp_toplevel_toggle_tiled(focused_toplevel);
+	}
+}
+
+static void action_toggle_fullscreen(struct comp_server *server,
+									 const char *arg) {
+	struct comp_toplevel *focused_toplevel = server->seat->focused_toplevel;
+	if (focused_toplevel) {
+		comp_toplevel_toggle_fullscreen(focused_toplevel);
+	}
+}
+
+static void action_minimize(struct comp_server *server, const char *arg) {
+	struct comp_toplevel *focused_toplevel = server->seat->focused_toplevel;
+	if (focused_toplevel) {
+		comp_toplevel_set_minimized(focused_toplevel, true);
+	}
+}
+
+static void action_new_output(struct comp_server *server, const char *arg) {
+	comp_create_extra_output();
+}
+
+static void action_workspace_new(struct comp_server *server, const char *arg) {
+	struct comp_output *output = get_active_output(server);
+	comp_output_new_workspace(output, COMP_WORKSPACE_TYPE_REGULAR);
+}
+
+static void action_workspace_remove(struct comp_server *server,
+									const char *arg) {
+	struct comp_output *output = get_active_output(server);
+	comp_output_remove_workspace(output, output->active_workspace);
+}
+
+static void action_workspace_next(struct comp_server *server,
+								  const char *arg) {
+	struct comp_output *output = get_active_output(server);
+	struct comp_workspace *ws = comp_output_next_workspace(output, true);
+	comp_output_switch_workspace(output, ws);
+}
+
+static void action_layout(struct comp_server *server, const char *arg) {
+	enum comp_tiling_layout_type type;
+	if (!comp_tiling_layout_from_name(arg, &type)) {
+		wlr_log(WLR_ERROR, "Invalid tiling layout: '%s'", arg);
+		return;
+	}
+
+	struct comp_output *output = get_active_output(server);
+	comp_workspace_set_tiling_layout(output->active_workspace, type);
+}
+
+static void action_layout_next(struct comp_server *server, const char *arg) {
+	struct comp_output *output = get_active_output(server);
+	struct comp_workspace *ws = output->active_workspace;
+	comp_workspace_set_tiling_layout(
+		ws, (ws->tiling_layout + 1) % COMP_TILING_LAYOUT_COUNT);
+}
+
+static void action_overview(struct comp_server *server, const char *arg) {
+	comp_overview_toggle(get_active_output(server));
+}
+
+static void action_slab_stats(struct comp_server *server, const char *arg) {
+	comp_slabs_report();
+}
+
+static void action_memory_report(struct comp_server *server,
+								 const char *arg) {
+	comp_memory_report();
+}
+
+static void action_memory_release(struct comp_server *server,
+								  const char *arg) {
+	comp_memory_pressure_release();
+}
+
+static void action_trace_export(struct comp_server *server, const char *arg) {
+	g_free(comp_trace_export());
+}
+
+static const struct {
+	const char *name;
+	comp_keybinding_action_func_t func;
+	bool needs_arg;
+} actions[] = {
+	{"exit", action_exit, false},
+	{"reload", action_reload, false},
+	{"exec", action_exec, true},
+	{"close", action_close, false},
+	{"focus-next", action_focus_next, false},
+	{"focus", action_focus, true},
+	{"toggle-tiling", action_toggle_tiling, false},
+	{"toggle-fullscreen", action_toggle_fullscreen, false},
+	{"minimize", action_minimize, false},
+	{"new-output", action_new_output, false},
+	{"workspace-new", action_workspace_new, false},
+	{"workspace-remove", action_workspace_remove, false},
+	{"workspace-next", action_workspace_next, false},
+	{"layout", action_layout, true},
+	{"layout-next", action_layout_next, false},
+	{"overview", action_overview, false},
+	{"slab-stats", action_slab_stats, false},
+	{"memory-report", action_memory_report, false},
+	{"memory-release", action_memory_release, false},
+	{"trace-export", action_trace_export, false},
+};
+
+bool comp_keybindings_run_action(const char *name, const char *arg) {
+	for (size_t i = 0; i < sizeof(actions) / sizeof(actions[0]); i++) {
+		if (strcmp(actions[i].name, name) != 0) {
+			continue;
+		}
+		if (actions[i].needs_arg && (!arg || !*arg)) {
+			wlr_log(WLR_ERROR, "Action '%s' needs an argument", name);
+			return false;
+		}
+		actions[i].func(&server, arg ? arg : "");
+		return true;
+	}
+	wlr_log(WLR_ERROR, "Unknown action '%s'", name);
+	return false;
+}
+
+/*
+ * Default bindings, same syntax as the bindings file
+ */
+
+static const char *default_bindings[] = {
+	"bind Alt+Escape exit",
+	"bind Alt+F1 focus-next",
+	"bind Alt+Q close",
+	"bind Alt+R reload",
+	"bind Alt+Return exec " TERM,
+	"bind Alt+O new-output",
+	"bind Alt+f toggle-tiling",
+	"bind Alt+h minimize",
+	"bind Alt+F toggle-fullscreen",
+	"bind Alt+Left focus left",
+	"bind Alt+Right focus right",
+	"bind Alt+Up focus up",
+	"bind Alt+Down focus down",
+	"bind Alt+n workspace-new",
+	"bind Alt+N workspace-new",
+	"bind Alt+m workspace-remove",
+	"bind Alt+M workspace-remove",
+	"bind Logo+Tab workspace-next",
+	"bind Alt+l layout-next",
+	"bind Logo+F1 overview",
+};
+
+/*
+ * Parsing
+ */
+
+static gint64 binding_key(uint32_t modifiers, xkb_keysym_t keysym) {
+	return ((gint64)(modifiers & ~IGNORED_MODIFIERS) << 32) | keysym;
+}
+
+static void binding_destroy(gpointer data) {
+	struct comp_keybinding *binding = data;
+	free(binding->arg);
+	free(binding);
+}
+
+/** Returns the next whitespace separated token and advances the string */
+static char *next_token(char **str) {
+	char *start = *str;
+	while (*start && isspace((unsigned char)*start)) {
+		start++;
+	}
+	if (!*start) {
+		*str = start;
+		return NULL;
+	}
+
+	char *end = start;
+	while (*end && !isspace((unsigned char)*end)) {
+		end++;
+	}
+	if (*end) {
+		*end++ = '\0';
+	}
+	*str = end;
+	return start;
+}
+
+static bool parse_modifier(const char *name, uint32_t *modifier) {
+	if (strcasecmp(name, "Shift") == 0) {
+		*modifier = WLR_MODIFIER_SHIFT;
+	} else if (strcasecmp(name, "Ctrl") == 0 ||
+			   strcasecmp(name, "Control") == 0) {
+		*modifier = WLR_MODIFIER_CTRL;
+	} else if (strcasecmp(name, "Alt") == 0 ||
+			   strcasecmp(name, "Mod1") == 0) {
+		*modifier = WLR_MODIFIER_ALT;
+	} else if (strcasecmp(name, "Mod3") == 0) {
+		*modifier = WLR_MODIFIER_MOD3;
+	} else if (strcasecmp(name, "Logo") == 0 ||
+			   strcasecmp(name, "Super") == 0 ||
+			   strcasecmp(name, "Mod4") == 0) {
+		*modifier = WLR_MODIFIER_LOGO;
+	} else if (strcasecmp(name, "Mod5") == 0) {
+		*modifier = WLR_MODIFIER_MOD5;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/** Parses "Mod+Mod+Keysym" */
+static bool parse_combo(char *combo, uint32_t *modifiers,
+						xkb_keysym_t *keysym) {
+	*modifiers = 0;
+	*keysym = XKB_KEY_NoSymbol;
+
+	char *saveptr = NULL;
+	char *part = strtok_r(combo, "+", &saveptr);
+	while (part) {
+		char *next = strtok_r(NULL, "+", &saveptr);
+		if (!next) {
+			break;
+		}
+		uint32_t modifier;
+		if (!parse_modifier(part, &modifier)) {
+			wlr_log(WLR_ERROR, "Keybinding: unknown modifier '%s'", part);
+			return false;
+		}
+		*modifiers |= modifier;
+		part = next;
+	}
+	if (!part) {
+		return false;
+	}
+
+	*keysym = xkb_keysym_from_name(part, XKB_KEYSYM_NO_FLAGS);
+	if (*keysym == XKB_KEY_NoSymbol) {
+		*keysym = xkb_keysym_from_name(part, XKB_KEYSYM_CASE_INSENSITIVE);
+	}
+	if (*keysym == XKB_KEY_NoSymbol) {
+		wlr_log(WLR_ERROR, "Keybinding: unknown keysym '%s'", part);
+		return false;
+	}
+
+	// Matched against the keysym without Shift applied, so that Alt+R,
+	// Alt+Shift+R and Alt+Shift+r are the same binding
+	xkb_keysym_t lower = xkb_keysym_to_lower(*keysym);
+	if (lower != *keysym) {
+		*modifiers |= WLR_MODIFIER_SHIFT;
+		*keysym = lower;
+	}
+	return true;
+}
+
+/**
+ * Parses one line:
+ * bind [--release] [--passthrough] <combo> <action> [arg...]
+ * unbind <combo>
+ */
+static bool parse_line(GHashTable *table, const char *line) {
+	bool ok = false;
+	char *copy = strdup(line);
+	if (!copy) {
+		wlr_log(WLR_ERROR, "Could not allocate keybinding line");
+		return false;
+	}
+
+	char *str = copy;
+	char *command = next_token(&str);
+	if (!command || command[0] == '#') {
+		// Empty line or comment
+		ok = true;
+		goto done;
+	}
+
+	bool bind = strcmp(command, "bind") == 0;
+	if (!bind && strcmp(command, "unbind") != 0) {
+		wlr_log(WLR_ERROR, "Keybinding: unknown command '%s'", command);
+		goto done;
+	}
+
+	bool release = false;
+	bool passthrough = false;
+	char *token;
+	while ((token = next_token(&str)) && strncmp(token, "--", 2) == 0) {
+		if (strcmp(token, "--release") == 0) {
+			release = true;
+		} else if (strcmp(token, "--passthrough") == 0) {
+			passthrough = true;
+		} else {
+			wlr_log(WLR_ERROR, "Keybinding: unknown flag '%s'", token);
+			goto done;
+		}
+	}
+
+	uint32_t modifiers;
+	xkb_keysym_t keysym;
+	if (!token || !parse_combo(token, &modifiers, &keysym)) {
+		wlr_log(WLR_ERROR, "Keybinding: invalid key combination in '%s'",
+				line);
+		goto done;
+	}
+	gint64 key = binding_key(modifiers, keysym);
+
+	if (!bind) {
+		g_hash_table_remove(table, &key);
+		ok = true;
+		goto done;
+	}
+
+	char *action_name = next_token(&str);
+	if (!action_name) {
+		wlr_log(WLR_ERROR, "Keybinding: missing action in '%s'", line);
+		goto done;
+	}
+	// The rest of the line is the argument
+	while (*str && isspace((unsigned char)*str)) {
+		str++;
+	}
+
+	for (size_t i = 0; i < sizeof(actions) / sizeof(actions[0]); i++) {
+		if (strcmp(actions[i].name, action_name) != 0) {
+			continue;
+		}
+		if (actions[i].needs_arg && !*str) {
+			wlr_log(WLR_ERROR, "Keybinding: action '%s' needs an argument",
+					action_name);
+			goto done;
+		}
+
+		struct comp_keybinding *binding = calloc(1, sizeof(*binding));
+		if (!binding) {
+			wlr_log(WLR_ERROR, "Could not allocate comp_keybinding");
+			goto done;
+		}
+		binding->arg = strdup(str);
+		if (!binding->arg) {
+			wlr_log(WLR_ERROR, "Could not allocate comp_keybinding");
+			free(binding);
+			goto done;
+		}
+		binding->key = key;
+		binding->modifiers = modifiers;
+		binding->keysym = keysym;
+		binding->release = release;
+		binding->passthrough = passthrough;
+		binding->action = actions[i].func;
+
+		// Replace, the key is stored in the binding itself
+		g_hash_table_replace(table, &binding->key, binding);
+		ok = true;
+		goto done;
+	}
+	wlr_log(WLR_ERROR, "Keybinding: unknown action '%s'", action_name);
+
+done:
+	free(copy);
+	return ok;
+}
+
+static char *get_bindings_path(void) {
+	const char *config_home = getenv("XDG_CONFIG_HOME");
+	if (config_home && *config_home) {
+		return g_build_filename(config_home, "fx-comp", "keybindings", NULL);
+	}
+	const char *home = getenv("HOME");
+	if (!home) {
+		return NULL;
+	}
+	return g_build_filename(home, ".config", "fx-comp", "keybindings", NULL);
+}
+
+static GHashTable *load_bindings(void) {
+	GHashTable *table = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+											  NULL, binding_destroy);
+
+	for (size_t i = 0; i < sizeof(default_bindings) / sizeof(char *); i++) {
+		parse_line(table, default_bindings[i]);
+	}
+
+	char *path = get_bindings_path();
+	if (!path) {
+		return table;
+	}
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		if (errno != ENOENT) {
+			wlr_log_errno(WLR_ERROR, "Could not open keybindings '%s'", path);
+		}
+		g_free(path);
+		return table;
+	}
+
+	bool ok = true;
+	char *line = NULL;
+	size_t line_size = 0;
+	size_t line_number = 0;
+	while (getline(&line, &line_size, file) != -1) {
+		line_number++;
+		if (!parse_line(table, line)) {
+			wlr_log(WLR_ERROR, "%s:%zu: invalid keybinding", path,
+					line_number);
+			ok = false;
+		}
+	}
+	free(line);
+	fclose(file);
+
+	if (!ok) {
+		g_hash_table_destroy(table);
+		table = NULL;
+	} else {
+		wlr_log(WLR_INFO, "Loaded keybindings from '%s'", path);
+	}
+	g_free(path);
+	return table;
+}
+
+/*
+ * Main
+ */
+
+struct comp_keybinding *
+comp_keybindings_lookup(struct comp_keybindings *keybindings,
+						uint32_t modifiers, xkb_keysym_t keysym) {
+	gint64 key = binding_key(modifiers, keysym);
+	return g_hash_table_lookup(keybindings->table, &key);
+}
+
+bool comp_keybindings_reload(struct comp_keybindings *keybindings) {
+	GHashTable *table = load_bindings();
+	if (!table) {
+		wlr_log(WLR_ERROR, "Keeping the current keybindings");
+		return false;
+	}
+
+	if (keybindings->table) {
+		g_hash_table_destroy(keybindings->table);
+	}
+	keybindings->table = table;
+	wlr_log(WLR_DEBUG, "Loaded %u keybindings", g_hash_table_size(table));
+	return true;
+}
+
+struct comp_keybindings *comp_keybindings_create(void) {
+	struct comp_keybindings *keybindings = calloc(1, sizeof(*keybindings));
+	if (!keybindings) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_keybindings");
+		return NULL;
+	}
+
+	if (!comp_keybindings_reload(keybindings)) {
+		// Fall back to only the default bindings
+		wlr_log(WLR_ERROR, "Falling back to the default keybindings");
+		keybindings->table = g_hash_table_new_full(
+			g_int64_hash, g_int64_equal, NULL, binding_destroy);
+		for (size_t i = 0; i < sizeof(default_bindings) / sizeof(char *);
+			 i++) {
+			parse_line(keybindings->table, default_bindings[i]);
+		}
+	}
+
+	return keybindings;
+}
+
+void comp_keybindings_destroy(struct comp_keybindings *keybindings) {
+	if (!keybindings) {
+		return;
+	}
+	g_hash_table_destroy(keybindings->table);
+	free(keybindings);
+}
@@ -5,12 +5,17 @@
 #include <xkbcommon/xkbcommon.h>
 
 #include "comp/output.h"
+#include "comp/overview.h"
 #include "comp/server.h"
+#include "comp/trace.h"
 #include "comp/workspace.h"
 #include "constants.h"
 #include "desktop/toplevel.h"
 #include "seat/cursor.h"
+#include "seat/input.h"
+#include "seat/keybindings.h"
 #include "seat/keyboard.h"
+#include "seat/latency.h"
 #include "seat/seat.h"
 #include "util.h"
 
@@ -18,6 +23,7 @@ static void keyboard_handle_modifiers(struct wl_listener *listener,
 									  void *data) {
 	/* This event is raised when a modifier key, such as shift or alt, is
 	 * pressed. We simply communicate this to the client. */
+	const uint64_t trace_start = comp_trace_begin();
 	struct comp_keyboard *keyboard =
 		wl_container_of(listener, keyboard, modifiers);
 	/*
@@ -30,212 +36,119 @@ static void keyboard_handle_modifiers(struct wl_listener *listener,
 	/* Send modifiers to the client. */
 	wlr_seat_keyboard_notify_modifiers(keyboard->seat->wlr_seat,
 									   &keyboard->wlr_keyboard->modifiers);
+	comp_trace_end("keyboard_handle_modifiers", trace_start);
 }
 
-static bool handle_keybinding(struct comp_server *server, int modifier,
-							  xkb_keysym_t sym) {
-	/*
-	 * Here we handle compositor keybindings. This is when the compositor is
-	 * processing keys, rather than passing them on to the client for its own
-	 * processing.
-	 *
-	 * This function assumes Alt/Super is held down.
-	 */
-	struct comp_output *output = get_active_output(server);
-	struct comp_workspace *workspace = output->active_workspace;
-
-	struct comp_toplevel *focused_toplevel = server->seat->focused_toplevel;
-	switch (modifier) {
-	case WLR_MODIFIER_ALT:
-		switch (sym) {
-		case XKB_KEY_Escape:
-			wl_display_terminate(server->wl_display);
-			break;
-		case XKB_KEY_F1:;
-			/* Cycle to the next view */
-			if (wl_list_length(&workspace->toplevels) < 2) {
-				break;
-			}
-			struct comp_toplevel *next_toplevel =
-				comp_workspace_get_next_focused(workspace);
-			comp_seat_surface_focus(
-				&next_toplevel->object,
-				comp_toplevel_get_wlr_surface(next_toplevel));
-			break;
-
-		case XKB_KEY_Q:;
-			if (focused_toplevel) {
-				comp_toplevel_close(focused_toplevel);
-			}
-			return true;
-
-		case XKB_KEY_Return:
-			exec(TERM);
-			return true;
-
-		case XKB_KEY_O:
-			comp_create_extra_output();
-			return true;
+static struct comp_keybinding *lookup_keysyms(struct comp_server *server,
+											  uint32_t modifiers,
+											  const xkb_keysym_t *syms,
+											  int nsyms) {
+	for (int i = 0; i < nsyms; i++) {
+		struct comp_keybinding *binding =
+			comp_keybindings_lookup(server->keybindings, modifiers, syms[i]);
+		if (binding) {
+			return binding;
+		}
+	}
+	return NULL;
+}
 
-		case XKB_KEY_f:
-			// Toggle between tiling and floating
-			if (focused_toplevel) {
-				comp_toplevel_toggle_tiled(focused_toplevel);
-			}
-			return true;
+/**
+ * Runs the compositor keybinding for the key, if any. Returns true if the key
+ * shouldn't be sent to the client.
+ */
+static bool handle_keybinding(struct comp_keyboard *keyboard, uint32_t keycode,
+							  enum wl_keyboard_key_state state) {
+	struct comp_server *server = keyboard->server;
+	bool locked = server->comp_session_lock.locked;
 
-		case XKB_KEY_h:
-			// Set minimized
-			if (focused_toplevel) {
-				comp_toplevel_set_minimized(focused_toplevel, true);
-			}
-			return true;
+	if (state == WL_KEYBOARD_KEY_STATE_RELEASED) {
+		if (!keyboard->release_binding.active ||
+			keyboard->release_binding.keycode != keycode) {
+			return false;
+		}
+		keyboard->release_binding.active = false;
 
-		case XKB_KEY_F:;
-			// Toggle fullscreen
-			if (focused_toplevel) {
-				comp_toplevel_toggle_fullscreen(focused_toplevel);
-			}
+		// Look up again, the bindings might've been reloaded since the press
+		struct comp_keybinding *binding = comp_keybindings_lookup(
+			server->keybindings, keyboard->release_binding.modifiers,
+			keyboard->release_binding.keysym);
+		if (!binding || !binding->release) {
 			return true;
-
-		case XKB_KEY_Left: {
-			struct comp_toplevel *toplevel =
-				comp_workspace_get_toplevel_direction(workspace,
-													  WLR_DIRECTION_LEFT);
-			if (toplevel) {
-				comp_seat_surface_focus(
-					&toplevel->object, comp_toplevel_get_wlr_surface(toplevel));
-			}
-			// struct comp_workspace *ws =
-			// 	comp_output_prev_workspace(output, true);
-			// comp_output_focus_workspace(output, ws);
-			break;
-		}
-		case XKB_KEY_Right: {
-			struct comp_toplevel *toplevel =
-				comp_workspace_get_toplevel_direction(workspace,
-													  WLR_DIRECTION_RIGHT);
-			if (toplevel) {
-				comp_seat_surface_focus(
-					&toplevel->object, comp_toplevel_get_wlr_surface(toplevel));
-			}
-			// struct comp_workspace *ws =
-			// 	comp_output_next_workspace(output, true);
-			// comp_output_focus_workspace(output, ws);
-			break;
-		}
-		case XKB_KEY_Up: {
-			struct comp_toplevel *toplevel =
-				comp_workspace_get_toplevel_direction(workspace,
-													  WLR_DIRECTION_UP);
-			if (toplevel) {
-				comp_seat_surface_focus(
-					&toplevel->object, comp_toplevel_get_wlr_surface(toplevel));
-			}
-			break;
 		}
-		case XKB_KEY_Down: {
-			struct comp_toplevel *toplevel =
-				comp_workspace_get_toplevel_direction(workspace,
-													  WLR_DIRECTION_DOWN);
-			if (toplevel) {
-				comp_seat_surface_focus(
-					&toplevel->object, comp_toplevel_get_wlr_surface(toplevel));
-			}
-			break;
+		bool passthrough = binding->passthrough;
+		if (!locked) {
+			binding->action(server, binding->arg);
 		}
+		return !passthrough;
+	}
 
-		case XKB_KEY_N:
-		case XKB_KEY_n:
-			comp_output_new_workspace(output, COMP_WORKSPACE_TYPE_REGULAR);
-			return true;
+	if (locked) {
+		return false;
+	}
 
-		case XKB_KEY_M:
-		case XKB_KEY_m:
-			comp_output_remove_workspace(output, output->active_workspace);
-			return true;
+	struct xkb_state *xkb_state = keyboard->wlr_keyboard->xkb_state;
+	struct xkb_keymap *keymap = keyboard->wlr_keyboard->keymap;
+	uint32_t modifiers = wlr_keyboard_get_modifiers(keyboard->wlr_keyboard);
 
-		default:
-			return false;
+	// The keysyms without Shift applied with all modifiers, like the parsed
+	// bindings, e.g. Alt+Shift+r or Logo+Shift+Tab
+	const xkb_keysym_t *syms;
+	xkb_layout_index_t layout = xkb_state_key_get_layout(xkb_state, keycode);
+	int nsyms =
+		xkb_keymap_key_get_syms_by_level(keymap, keycode, layout, 0, &syms);
+	struct comp_keybinding *binding =
+		lookup_keysyms(server, modifiers, syms, nsyms);
+
+	// Symbols on other levels, e.g. Alt+exclam. Shift is part of the keysym
+	// if it changed it, but might also be spelled out: Alt+Shift+exclam.
+	if (!binding) {
+		nsyms = xkb_state_key_get_syms(xkb_state, keycode, &syms);
+		uint32_t translated_modifiers = modifiers;
+		xkb_mod_index_t shift =
+			xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_SHIFT);
+		if (xkb_state_mod_index_is_consumed(xkb_state, keycode, shift) == 1) {
+			translated_modifiers &= ~WLR_MODIFIER_SHIFT;
 		}
-		break;
-	case WLR_MODIFIER_LOGO:
-		switch (sym) {
-		case XKB_KEY_Tab:;
-			struct comp_workspace *ws =
-				comp_output_next_workspace(output, true);
-			comp_output_focus_workspace(output, ws);
-			break;
-
-		default:
-			return false;
+		binding = lookup_keysyms(server, translated_modifiers, syms, nsyms);
+		if (!binding && translated_modifiers != modifiers) {
+			binding = lookup_keysyms(server, modifiers, syms, nsyms);
 		}
-		break;
-	default:
-		break;
+	}
+	if (!binding) {
+		xkb_keysym_t sym = nsyms > 0 ? syms[0] : XKB_KEY_NoSymbol;
+		return comp_overview_handle_key(get_active_output(server), sym);
 	}
 
-	return true;
+	// The binding might get freed by the action (reload)
+	bool passthrough = binding->passthrough;
+	if (binding->release) {
+		// Also swallow the press so that the client doesn't see a lone press
+		keyboard->release_binding.active = true;
+		keyboard->release_binding.keycode = keycode;
+		keyboard->release_binding.modifiers = binding->modifiers;
+		keyboard->release_binding.keysym = binding->keysym;
+	} else {
+		binding->action(server, binding->arg);
+	}
+	return !passthrough;
 }
 
 static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 	/* This event is raised when a key is pressed or released. */
+	const uint64_t trace_start = comp_trace_begin();
 	struct comp_keyboard *keyboard = wl_container_of(listener, keyboard, key);
 	struct comp_server *server = keyboard->server;
 	struct wlr_keyboard_key_event *event = data;
 	struct comp_seat *seat = server->seat;
 	struct wlr_seat *wlr_seat = seat->wlr_seat;
 
+	struct timespec arrival;
+	comp_latency_stamp(&arrival);
+
 	/* Translate libinput keycode -> xkbcommon */
 	uint32_t keycode = event->keycode + 8;
-	/* Get a list of keysyms based on the keymap for this keyboard */
-	const xkb_keysym_t *syms;
-	int nsyms = xkb_state_key_get_syms(keyboard->wlr_keyboard->xkb_state,
-									   keycode, &syms);
-
-	bool handled = false;
-	uint32_t modifiers = wlr_keyboard_get_modifiers(keyboard->wlr_keyboard);
-
-	if (!server->comp_session_lock.locked &&
-		event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-		int bitmask = 1 << (WLR_MODIFIER_COUNT - 1);
-		int mask = 1;
-		while (bitmask) {
-			switch (modifiers & mask) {
-			case WLR_MODIFIER_ALT:
-				/* If alt is held down and this button was _pressed_, we attempt
-				 * to process it as a compositor keybinding. */
-				for (int i = 0; i < nsyms; i++) {
-					handled =
-						handle_keybinding(server, WLR_MODIFIER_ALT, syms[i]);
-				}
-				break;
-			case WLR_MODIFIER_SHIFT:
-				break;
-			case WLR_MODIFIER_CAPS:
-				break;
-			case WLR_MODIFIER_CTRL:
-				break;
-			case WLR_MODIFIER_MOD2:
-				break;
-			case WLR_MODIFIER_MOD3:
-				break;
-			case WLR_MODIFIER_LOGO:
-				/* If the LOGO key (super/win) is held down and this button was
-				 * _pressed_, we attempt to process it as a compositor
-				 * keybinding. */
-				for (int i = 0; i < nsyms; i++) {
-					handled =
-						handle_keybinding(server, WLR_MODIFIER_LOGO, syms[i]);
-				}
-				break;
-			case WLR_MODIFIER_MOD5:
-				break;
-			}
-			bitmask &= ~mask;
-			mask <<= 1;
-		}
-	}
+	bool handled = handle_keybinding(keyboard, keycode, event->state);
 
 	// TODO: Handling for wlr_session_change_vt
 
@@ -244,7 +157,11 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 		wlr_seat_set_keyboard(wlr_seat, keyboard->wlr_keyboard);
 		wlr_seat_keyboard_notify_key(wlr_seat, event->time_msec, event->keycode,
 									 event->state);
+		comp_latency_input_delivered(
+			COMP_LATENCY_INPUT_KEY, &arrival,
+			wlr_seat->keyboard_state.focused_surface);
 	}
+	comp_trace_end("keyboard_handle_key", trace_start);
 }
 
 static void keyboard_handle_destroy(struct wl_listener *listener, void *data) {
@@ -274,15 +191,12 @@ void comp_keyboard_create(struct comp_seat *seat,
 	keyboard->seat = seat;
 	keyboard->wlr_keyboard = wlr_keyboard;
 
-	/* We need to prepare an XKB keymap and assign it to the keyboard. This
-	 * assumes the defaults (e.g. layout = "us"). */
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	struct xkb_keymap *keymap =
-		xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS);
-
-	wlr_keyboard_set_keymap(wlr_keyboard, keymap);
-	xkb_keymap_unref(keymap);
-	xkb_context_unref(context);
+	/* We need to prepare an XKB keymap and assign it to the keyboard. The
+	 * compiled keymap is shared between all keyboards. */
+	struct xkb_keymap *keymap = comp_input_get_configured_keymap();
+	if (keymap) {
+		wlr_keyboard_set_keymap(wlr_keyboard, keymap);
+	}
 
 	/* Here we set up listeners for keyboard events. */
 	keyboard->modifiers.notify = keyboard_handle_modifiers;
@@ -0,0 +1,461 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <linux/input-event-codes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wayland-util.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+
+#include "comp/server.h"
+#include "constants.h"
+#include "seat/latency.h"
+#include "seat/seat.h"
+#include "util.h"
+
+static const char *input_type_names[COMP_LATENCY_INPUT_COUNT] = {
+	[COMP_LATENCY_INPUT_KEY] = "key",
+	[COMP_LATENCY_INPUT_POINTER] = "pointer",
+};
+
+static const char *stage_names[COMP_LATENCY_STAGE_COUNT] = {
+	[COMP_LATENCY_STAGE_DELIVER] = "deliver",
+	[COMP_LATENCY_STAGE_COMMIT] = "commit",
+	[COMP_LATENCY_STAGE_PRESENT] = "present",
+};
+
+static double timespec_diff_ms(const struct timespec *start,
+							   const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 +
+		   (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static uint32_t get_time_msec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * Histogram
+ */
+
+static void histogram_add(struct comp_latency_histogram *histogram,
+						  struct comp_latency_sample *sample,
+						  const struct timespec *presented) {
+	double ms = timespec_diff_ms(&sample->arrival, presented);
+	if (ms < 0) {
+		return;
+	}
+
+	int bucket = 0;
+	double limit = 1;
+	while (ms >= limit && bucket < LATENCY_HISTOGRAM_BUCKETS - 1) {
+		limit *= 2;
+		bucket++;
+	}
+	histogram->buckets[bucket]++;
+
+	if (histogram->count == 0 || ms < histogram->min_ms) {
+		histogram->min_ms = ms;
+	}
+	if (ms > histogram->max_ms) {
+		histogram->max_ms = ms;
+	}
+	histogram->count++;
+	histogram->total_ms += ms;
+
+	histogram->stage_total_ms[COMP_LATENCY_STAGE_DELIVER] +=
+		timespec_diff_ms(&sample->arrival, &sample->delivered);
+	histogram->stage_total_ms[COMP_LATENCY_STAGE_COMMIT] +=
+		timespec_diff_ms(&sample->delivered, &sample->committed);
+	histogram->stage_total_ms[COMP_LATENCY_STAGE_PRESENT] +=
+		timespec_diff_ms(&sample->committed, presented);
+}
+
+/** Upper bound of the bucket containing the percentile */
+static int histogram_percentile(struct comp_latency_histogram *histogram,
+								double percentile) {
+	uint64_t target = histogram->count * percentile;
+	uint64_t seen = 0;
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen > target) {
+			return 1 << i;
+		}
+	}
+	return 1 << (LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+static void histogram_print(struct comp_latency_histogram *histogram,
+							const char *type) {
+	printf("  %s: %" PRIu64 " samples, min %.2fms, avg %.2fms, max %.2fms, "
+		   "p50 <%dms, p99 <%dms\n",
+		   type, histogram->count, histogram->min_ms,
+		   histogram->total_ms / histogram->count, histogram->max_ms,
+		   histogram_percentile(histogram, 0.5),
+		   histogram_percentile(histogram, 0.99));
+
+	printf("    stages:");
+	for (int i = 0; i < COMP_LATENCY_STAGE_COUNT; i++) {
+		printf(" %s %.2fms", stage_names[i],
+			   histogram->stage_total_ms[i] / histogram->count);
+	}
+	printf("\n");
+
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+		if (histogram->buckets[i] == 0) {
+			continue;
+		}
+		int bar = histogram->buckets[i] * 40 / histogram->count;
+		if (i == LATENCY_HISTOGRAM_BUCKETS - 1) {
+			printf("    >=%4dms %8" PRIu64 " ", 1 << (i - 1),
+				   histogram->buckets[i]);
+		} else {
+			printf("    < %4dms %8" PRIu64 " ", 1 << i,
+				   histogram->buckets[i]);
+		}
+		for (int j = 0; j < bar; j++) {
+			putchar('#');
+		}
+		putchar('\n');
+	}
+}
+
+/*
+ * Clients
+ */
+
+static void client_handle_surface_destroy(struct wl_listener *listener,
+										  void *data) {
+	struct comp_latency_client *client =
+		wl_container_of(listener, client, surface_destroy);
+	listener_remove(&client->surface_commit);
+	listener_remove(&client->surface_destroy);
+	client->surface = NULL;
+	client->pending.state = COMP_LATENCY_SAMPLE_NONE;
+	if (client->inflight.state == COMP_LATENCY_SAMPLE_COMMITTED) {
+		client->inflight.state = COMP_LATENCY_SAMPLE_NONE;
+	}
+}
+
+static void client_handle_surface_commit(struct wl_listener *listener,
+										 void *data) {
+	struct comp_latency_client *client =
+		wl_container_of(listener, client, surface_commit);
+	if (client->pending.state != COMP_LATENCY_SAMPLE_DELIVERED ||
+		client->inflight.state != COMP_LATENCY_SAMPLE_NONE) {
+		// Wait for the previous commit to be presented first
+		return;
+	}
+
+	client->inflight = client->pending;
+	client->inflight.state = COMP_LATENCY_SAMPLE_COMMITTED;
+	clock_gettime(CLOCK_MONOTONIC, &client->inflight.committed);
+	client->pending.state = COMP_LATENCY_SAMPLE_NONE;
+}
+
+static void client_handle_client_destroy(struct wl_listener *listener,
+										 void *data) {
+	struct comp_latency_client *client =
+		wl_container_of(listener, client, client_destroy);
+	if (client->surface) {
+		listener_remove(&client->surface_commit);
+		listener_remove(&client->surface_destroy);
+		client->surface = NULL;
+	}
+	listener_remove(&client->client_destroy);
+	client->client = NULL;
+	client->pending.state = COMP_LATENCY_SAMPLE_NONE;
+	client->inflight.state = COMP_LATENCY_SAMPLE_NONE;
+}
+
+static void client_read_name(struct comp_latency_client *client) {
+	snprintf(client->name, sizeof(client->name), "unknown");
+
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/comm", client->pid);
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return;
+	}
+	if (fgets(client->name, sizeof(client->name), file)) {
+		client->name[strcspn(client->name, "\n")] = '\0';
+	}
+	fclose(file);
+}
+
+static struct comp_latency_client *
+client_get_or_create(struct comp_latency *latency,
+					 struct wl_client *wl_client) {
+	struct comp_latency_client *client;
+	wl_list_for_each(client, &latency->clients, link) {
+		if (client->client == wl_client) {
+			return client;
+		}
+	}
+
+	client = calloc(1, sizeof(*client));
+	if (!client) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_latency_client");
+		return NULL;
+	}
+	client->client = wl_client;
+	wl_client_get_credentials(wl_client, &client->pid, NULL, NULL);
+	client_read_name(client);
+
+	listener_init(&client->surface_commit);
+	listener_init(&client->surface_destroy);
+	client->client_destroy.notify = client_handle_client_destroy;
+	wl_client_add_destroy_listener(wl_client, &client->client_destroy);
+
+	wl_list_insert(latency->clients.prev, &client->link);
+	return client;
+}
+
+static void client_destroy(struct comp_latency_client *client) {
+	if (client->client) {
+		client_handle_client_destroy(&client->client_destroy, NULL);
+	}
+	wl_list_remove(&client->link);
+	free(client);
+}
+
+/*
+ * Tracing
+ */
+
+void comp_latency_stamp(struct timespec *arrival) {
+	clock_gettime(CLOCK_MONOTONIC, arrival);
+}
+
+void comp_latency_input_delivered(enum comp_latency_input_type type,
+								  const struct timespec *arrival,
+								  struct wlr_surface *surface) {
+	struct comp_latency *latency = server.latency;
+	if (!latency || !surface) {
+		return;
+	}
+
+	// Subsurfaces are committed through their parent
+	surface = wlr_surface_get_root_surface(surface);
+	struct wl_client *wl_client = wl_resource_get_client(surface->resource);
+	struct comp_latency_client *client =
+		client_get_or_create(latency, wl_client);
+	if (!client) {
+		return;
+	}
+
+	if (client->surface != surface) {
+		if (client->surface) {
+			listener_remove(&client->surface_commit);
+			listener_remove(&client->surface_destroy);
+		}
+		client->surface = surface;
+		listener_connect(&surface->events.commit, &client->surface_commit,
+						 client_handle_surface_commit);
+		listener_connect(&surface->events.destroy, &client->surface_destroy,
+						 client_handle_surface_destroy);
+		client->pending.state = COMP_LATENCY_SAMPLE_NONE;
+	}
+
+	// Keep the oldest input that hasn't been committed yet
+	if (client->pending.state == COMP_LATENCY_SAMPLE_DELIVERED) {
+		return;
+	}
+	client->pending = (struct comp_latency_sample){
+		.state = COMP_LATENCY_SAMPLE_DELIVERED,
+		.type = type,
+		.arrival = *arrival,
+	};
+	clock_gettime(CLOCK_MONOTONIC, &client->pending.delivered);
+}
+
+static bool surface_is_on_output(struct wlr_surface *surface,
+								 struct wlr_output *output) {
+	struct wlr_surface_output *surface_output;
+	wl_list_for_each(surface_output, &surface->current_outputs, link) {
+		if (surface_output->output == output) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void comp_latency_output_rendered(struct wlr_output *output) {
+	struct comp_latency *latency = server.latency;
+	if (!latency) {
+		return;
+	}
+
+	struct comp_latency_client *client;
+	wl_list_for_each(client, &latency->clients, link) {
+		if (client->inflight.state != COMP_LATENCY_SAMPLE_COMMITTED ||
+			!client->surface) {
+			continue;
+		}
+		if (wl_list_empty(&client->surface->current_outputs)) {
+			// Not visible, will never be presented
+			client->inflight.state = COMP_LATENCY_SAMPLE_NONE;
+		} else if (surface_is_on_output(client->surface, output)) {
+			client->inflight.state = COMP_LATENCY_SAMPLE_RENDERED;
+			client->inflight.output = output;
+		}
+	}
+}
+
+void comp_latency_output_presented(struct wlr_output *output,
+								   const struct timespec *when) {
+	struct comp_latency *latency = server.latency;
+	if (!latency) {
+		return;
+	}
+
+	struct comp_latency_client *client;
+	wl_list_for_each(client, &latency->clients, link) {
+		struct comp_latency_sample *sample = &client->inflight;
+		if (sample->state != COMP_LATENCY_SAMPLE_RENDERED ||
+			sample->output != output) {
+			continue;
+		}
+		histogram_add(&client->histograms[sample->type], sample, when);
+		sample->state = COMP_LATENCY_SAMPLE_NONE;
+	}
+}
+
+void comp_latency_report(struct comp_latency *latency) {
+	printf("Input latency (input event to presentation):\n");
+	struct comp_latency_client *client;
+	wl_list_for_each(client, &latency->clients, link) {
+		printf("%s (pid %d)%s:\n", client->name, client->pid,
+			   client->client ? "" : " [disconnected]");
+		for (int i = 0; i < COMP_LATENCY_INPUT_COUNT; i++) {
+			struct comp_latency_histogram *histogram = &client->histograms[i];
+			if (histogram->count == 0) {
+				printf("  %s: no samples\n", input_type_names[i]);
+				continue;
+			}
+			histogram_print(histogram, input_type_names[i]);
+		}
+	}
+	fflush(stdout);
+}
+
+/*
+ * Benchmark
+ */
+
+static const struct wlr_keyboard_impl bench_keyboard_impl = {
+	.name = "fx-comp-bench-keyboard",
+};
+
+static const struct wlr_pointer_impl bench_pointer_impl = {
+	.name = "fx-comp-bench-pointer",
+};
+
+static int bench_handle_timer(void *data) {
+	struct comp_latency *latency = data;
+
+	if (latency->bench.remaining <= 0) {
+		// The last events have had an interval to get presented. The report
+		// is printed on shutdown.
+		wl_display_terminate(server.wl_display);
+		return 0;
+	}
+	latency->bench.remaining--;
+
+	uint32_t time = get_time_msec();
+	if (latency->bench.remaining % 2 == 0) {
+		// Alternate between right and left so that the cursor stays in place
+		latency->bench.direction = latency->bench.direction > 0 ? -1 : 1;
+		struct wlr_pointer_motion_event event = {
+			.pointer = &latency->bench.pointer,
+			.time_msec = time,
+			.delta_x = latency->bench.direction,
+			.unaccel_dx = latency->bench.direction,
+		};
+		wl_signal_emit_mutable(&latency->bench.pointer.events.motion, &event);
+		wl_signal_emit_mutable(&latency->bench.pointer.events.frame,
+							   &latency->bench.pointer);
+	} else {
+		latency->bench.key_pressed = !latency->bench.key_pressed;
+		struct wlr_keyboard_key_event event = {
+			.time_msec = time,
+			.keycode = KEY_A,
+			.update_state = true,
+			.state = latency->bench.key_pressed
+						 ? WL_KEYBOARD_KEY_STATE_PRESSED
+						 : WL_KEYBOARD_KEY_STATE_RELEASED,
+		};
+		wlr_keyboard_notify_key(&latency->bench.keyboard, &event);
+	}
+
+	wl_event_source_timer_update(latency->bench.timer,
+								 LATENCY_BENCH_INTERVAL_MS);
+	return 0;
+}
+
+bool comp_latency_bench_start(struct comp_latency *latency) {
+	latency->bench.timer = wl_event_loop_add_timer(
+		server.wl_event_loop, bench_handle_timer, latency);
+	if (!latency->bench.timer) {
+		wlr_log(WLR_ERROR, "Could not create the latency benchmark timer");
+		return false;
+	}
+
+	wlr_keyboard_init(&latency->bench.keyboard, &bench_keyboard_impl,
+					  bench_keyboard_impl.name);
+	wlr_pointer_init(&latency->bench.pointer, &bench_pointer_impl,
+					 bench_pointer_impl.name);
+	comp_seat_add_input_device(server.seat, &latency->bench.keyboard.base);
+	comp_seat_add_input_device(server.seat, &latency->bench.pointer.base);
+
+	latency->bench.enabled = true;
+	latency->bench.remaining = LATENCY_BENCH_EVENTS;
+	// Give the startup command some time to map its window
+	wl_event_source_timer_update(latency->bench.timer,
+								 LATENCY_BENCH_START_DELAY_MS);
+	wlr_log(WLR_INFO, "Starting the input latency benchmark in %dms",
+			LATENCY_BENCH_START_DELAY_MS);
+	return true;
+}
+
+/*
+ * Main
+ */
+
+struct comp_latency *comp_latency_create(void) {
+	struct comp_latency *latency = calloc(1, sizeof(*latency));
+	if (!latency) {
+		wlr_log(WLR_ERROR, "Could not allocate comp_latency");
+		return NULL;
+	}
+	wl_list_init(&latency->clients);
+	return latency;
+}
+
+void comp_latency_destroy(struct comp_latency *latency) {
+	if (!latency) {
+		return;
+	}
+
+	if (latency->bench.timer) {
+		wl_event_source_remove(latency->bench.timer);
+	}
+	if (latency->bench.enabled) {
+		wlr_keyboard_finish(&latency->bench.keyboard);
+		wlr_pointer_finish(&latency->bench.pointer);
+	}
+
+	struct comp_latency_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &latency->clients, link) {
+		client_destroy(client);
+	}
+	free(latency);
+}
@@ -14,6 +14,7 @@
 #include <xkbcommon/xkbcommon-keysyms.h>
 #include <xkbcommon/xkbcommon.h>
 
+#include "comp/ipc.h"
 #include "comp/lock.h"
 #include "comp/object.h"
 #include "comp/output.h"
@@ -87,12 +88,8 @@ static void server_new_pointer(struct comp_seat *seat,
 	wlr_cursor_attach_input_device(seat->cursor->wlr_cursor, device);
 }
 
-static void seat_new_input(struct wl_listener *listener, void *data) {
-	/* This event is raised by the backend when a new input device becomes
-	 * available. */
-	struct comp_seat *seat = wl_container_of(listener, seat, new_input);
-	struct wlr_input_device *device = data;
-
+void comp_seat_add_input_device(struct comp_seat *seat,
+								struct wlr_input_device *device) {
 	device->data = seat;
 
 	switch (device->type) {
@@ -147,6 +144,14 @@ static void seat_new_input(struct wl_listener *listener, void *data) {
 	comp_input_configure_device(device);
 }
 
+static void seat_new_input(struct wl_listener *listener, void *data) {
+	/* This event is raised by the backend when a new input device becomes
+	 * available. */
+	struct comp_seat *seat = wl_container_of(listener, seat, new_input);
+	struct wlr_input_device *device = data;
+	comp_seat_add_input_device(seat, device);
+}
+
 static void seat_request_cursor(struct wl_listener *listener, void *data) {
 	struct comp_seat *seat = wl_container_of(listener, seat, request_cursor);
 	/* This event is raised by the seat when a client provides a cursor image */
@@ -160,8 +165,9 @@ static void seat_request_cursor(struct wl_listener *listener, void *data) {
 		 * provided surface as the cursor image. It will set the hardware cursor
 		 * on the output that it's currently on and continue to do so as the
 		 * cursor moves between outputs. */
-		wlr_cursor_set_surface(seat->cursor->wlr_cursor, event->surface,
-							   event->hotspot_x, event->hotspot_y);
+		comp_cursor_set_client_image(seat->cursor, focused_client->client,
+									 event->surface, event->hotspot_x,
+									 event->hotspot_y);
 	}
 }
 
@@ -390,6 +396,7 @@ void comp_seat_surface_unfocus(struct wlr_surface *surface,
 
 		if (toplevel == server.seat->focused_toplevel) {
 			server.seat->focused_toplevel = NULL;
+			comp_ipc_focus_changed();
 		}
 
 		if (focus_previous) {
@@ -444,6 +451,17 @@ static void seat_focus_surface(struct wlr_surface *surface) {
 	}
 }
 
+/** Makes the toplevel the most recently focused one */
+static void seat_raise_focus_order(struct comp_toplevel *toplevel) {
+	// Workspace
+	wl_list_remove(&toplevel->workspace_link);
+	wl_list_insert(&toplevel->workspace->toplevels, &toplevel->workspace_link);
+	toplevel->focus_rank = ++toplevel->workspace->focus_serial;
+	// Seat
+	wl_list_remove(&toplevel->focus_link);
+	wl_list_insert(&server.seat->focus_order, &toplevel->focus_link);
+}
+
 void comp_seat_surface_focus(struct comp_object *object,
 							 struct wlr_surface *surface) {
 	/* Note: this function only deals with keyboard focus. */
@@ -477,6 +495,13 @@ void comp_seat_surface_focus(struct comp_object *object,
 									focused_layer->wlr_layer_surface->surface);
 			return;
 		}
+		// The overview holds the keyboard, only remember the focus order so
+		// that the toplevel gets focused when the overview exits
+		if (toplevel->workspace->output &&
+			toplevel->workspace->output->overview) {
+			seat_raise_focus_order(toplevel);
+			return;
+		}
 		break;
 	case COMP_OBJECT_TYPE_LAYER_SURFACE:;
 		if (focused_layer == layer_surface) {
@@ -525,17 +550,12 @@ void comp_seat_surface_focus(struct comp_object *object,
 	switch (object->type) {
 	case COMP_OBJECT_TYPE_TOPLEVEL:;
 		seat->focused_toplevel = toplevel;
+		comp_ipc_focus_changed();
 		/* Activate the new surface */
 		comp_toplevel_set_activated(toplevel, true);
 
 		/* Move the node to the front */
-		// Workspace
-		wl_list_remove(&toplevel->workspace_link);
-		wl_list_insert(&toplevel->workspace->toplevels,
-					   &toplevel->workspace_link);
-		// Seat
-		wl_list_remove(&toplevel->focus_link);
-		wl_list_insert(&server.seat->focus_order, &toplevel->focus_link);
+		seat_raise_focus_order(toplevel);
 
 		// Set XWayland seat
 		if (toplevel->type == COMP_TOPLEVEL_TYPE_XWAYLAND) {
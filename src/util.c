@@ -5,13 +5,11 @@
 #include <math.h>
 #include <scenefx/types/wlr_scene.h>
 #include <stdlib.h>
-#include <sys/resource.h>
-#include <sys/wait.h>
-#include <unistd.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/util/log.h>
 
+#include "comp/icon_loader.h"
 #include "util.h"
 
 /*
@@ -22,50 +20,6 @@ int wrap(int i, int max) {
 	return ((i % max) + max) % max;
 }
 
-void exec(char *cmd) {
-	int fd[2];
-	if (pipe(fd) != 0) {
-		wlr_log(WLR_ERROR, "Unable to create pipe for fork");
-	}
-
-	pid_t child = fork(), grand_child;
-	if (child < 0) {
-		close(fd[0]);
-		close(fd[1]);
-		wlr_log(WLR_ERROR, "fork() failed");
-		return;
-	} else if (child == 0) {
-		// Fork child process again
-		setsid();
-
-		sigset_t set;
-		sigemptyset(&set);
-		sigprocmask(SIG_SETMASK, &set, NULL);
-
-		signal(SIGPIPE, SIG_DFL);
-		close(fd[0]);
-
-		grand_child = fork();
-		if (grand_child == 0) {
-			close(fd[1]);
-			execlp("sh", "sh", "-c", cmd, NULL);
-			wlr_log(WLR_ERROR, "execlp failed");
-			_exit(1);
-		}
-
-		write(fd[1], &grand_child, sizeof(grand_child));
-		close(fd[1]);
-		// Exit the child process
-		_exit(0);
-	}
-
-	close(fd[1]); // close write
-	read(fd[0], &grand_child, sizeof(grand_child));
-	close(fd[0]);
-	// cleanup child process
-	waitpid(child, NULL, 0);
-}
-
 /* Wayland Helpers */
 
 static bool listener_is_connected(struct wl_listener *listener) {
@@ -290,15 +244,6 @@ double hex_alpha(const uint32_t *const col) {
 	return ((const uint8_t *)(col))[0] / (double)(255);
 }
 
-GdkRGBA gdk_rgba_from_color(const uint32_t *const c) {
-	return (GdkRGBA){
-		.red = hex_red(c),
-		.green = hex_green(c),
-		.blue = hex_blue(c),
-		.alpha = hex_alpha(c),
-	};
-}
-
 struct wlr_render_color wlr_render_color_from_color(const uint32_t *const c) {
 	return (struct wlr_render_color){
 		.r = hex_red(c),
@@ -334,15 +279,12 @@ void cairo_draw_rounded_rect(cairo_t *cr, double width, double height, double x,
 void cairo_draw_icon_from_name(cairo_t *cr, const char *icon_name,
 							   const uint32_t *const fg_color, int icon_size,
 							   int x, int y, double scale) {
-	GtkIconInfo *icon_info = gtk_icon_theme_lookup_icon_for_scale(
-		gtk_icon_theme_get_default(), icon_name, icon_size, scale, 0);
-
-	// Icon pixel buffer
-	const GdkRGBA fg = gdk_rgba_from_color(fg_color);
-	GdkPixbuf *icon_pixbuf = gtk_icon_info_load_symbolic(
-		icon_info, &fg, NULL, NULL, NULL, NULL, NULL);
+	// Owned by the icon loader
 	cairo_surface_t *icon_surface =
-		gdk_cairo_surface_create_from_pixbuf(icon_pixbuf, scale, NULL);
+		comp_icon_loader_get(icon_name, icon_size, scale, *fg_color);
+	if (!icon_surface) {
+		return;
+	}
 
 	// Render
 	cairo_save(cr);
@@ -351,9 +293,6 @@ void cairo_draw_icon_from_name(cairo_t *cr, const char *icon_name,
 	cairo_paint(cr);
 
 	cairo_restore(cr);
-
-	cairo_surface_destroy(icon_surface);
-	g_object_unref(icon_pixbuf);
 }
 
 /* Animation Helpers */